@@ -57,6 +57,25 @@ typedef struct iot_data_t iot_data_t;
 /** Alias for iot typecode structure */
 typedef struct iot_typecode_t iot_typecode_t;
 
+/** Alias for iot data arena structure */
+typedef struct iot_data_arena_t iot_data_arena_t;
+
+/**
+ * Data allocation statistics
+ */
+typedef struct iot_data_stats_t
+{
+  uint64_t chunks;                      /**< Number of memory chunks allocated by the data block cache */
+  uint64_t blocks_allocated;            /**< Number of data blocks allocated */
+  uint64_t blocks_in_use;               /**< Number of data blocks in use */
+  uint64_t blocks_cached;               /**< Number of free data blocks held by the data block cache */
+  uint64_t blocks_peak_sampled;         /**< Peak of sampled data blocks in use (see iot_data_stats) */
+  uint64_t live [IOT_DATA_VECTOR + 1];  /**< Number of live data instances, indexed by data type */
+  uint64_t strings_inline;              /**< Number of copied strings stored within the string data instance */
+  uint64_t strings_block;               /**< Number of copied strings stored in a data block */
+  uint64_t strings_heap;                /**< Number of copied strings stored in heap memory */
+} iot_data_stats_t;
+
 /**
  * Alias for data map iterator structure
  */
@@ -87,6 +106,31 @@ typedef struct iot_data_array_iter_t
 /** Alias for data comparison function pointer */
 typedef bool (*iot_data_cmp_fn) (const iot_data_t * data, const void * arg);
 
+/** Alias for serialized data sink function pointer, returns false if the write failed */
+typedef bool (*iot_data_sink_fn) (void * arg, const char * buff, size_t len);
+
+/** Alias for parsed json function pointer, called with each complete value which the function must free */
+typedef void (*iot_data_json_fn) (void * arg, iot_data_t * data);
+
+/**
+ * Json parse options
+ */
+typedef struct iot_data_json_options_t
+{
+  bool arrays;                          /**< Whether json arrays of numbers are decoded as arrays rather than vectors */
+  const iot_typecode_t * array_type;    /**< Array typecode for decoded arrays, NULL for the narrowest type holding each array's numbers */
+  bool string_views;                    /**< Whether unescaped strings reference a shared copy of the json rather than being copied */
+} iot_data_json_options_t;
+
+/** Alias for incremental json parser structure */
+typedef struct iot_data_json_parser_t iot_data_json_parser_t;
+
+/** Alias for schema codec structure */
+typedef struct iot_data_schema_t iot_data_schema_t;
+
+/** Alias for read only data snapshot node structure */
+typedef struct iot_data_snapshot_t iot_data_snapshot_t;
+
 /**
  * @brief Increment the data reference count
  *
@@ -105,6 +149,94 @@ extern void iot_data_add_ref (iot_data_t * data);
  */
 extern void iot_data_free (iot_data_t * data);
 
+/**
+ * @brief Allocate a data arena
+ *
+ * The function to allocate an arena from which data can be allocated in bulk. Data allocated while the
+ * arena is in scope (see iot_data_arena_begin) is bump allocated from large arena memory chunks, is not
+ * reference counted and is released in one step when the arena is reset or freed. Calling iot_data_free
+ * or iot_data_add_ref on arena data has no effect. Arena data can reference data allocated outside the
+ * arena (which is then released with the arena) but not the reverse, nor data from a different arena:
+ * use iot_data_copy outside of any arena scope to create a standalone copy of arena data.
+ *
+ * @return  Pointer to the allocated arena
+ */
+extern iot_data_arena_t * iot_data_arena_alloc (void);
+
+/**
+ * @brief Start allocating data from an arena
+ *
+ * The function to make the arena current for the calling thread, so that subsequent data allocations
+ * are made from the arena until iot_data_arena_end is called. Arena scopes can be nested.
+ *
+ * @param arena  Pointer to the arena
+ */
+extern void iot_data_arena_begin (iot_data_arena_t * arena);
+
+/**
+ * @brief Stop allocating data from an arena
+ *
+ * The function to end the arena scope, restoring any previously current arena for the calling thread
+ *
+ * @param arena  Pointer to the arena, which must be the current arena
+ */
+extern void iot_data_arena_end (iot_data_arena_t * arena);
+
+/**
+ * @brief Reset an arena
+ *
+ * The function to release all data allocated from an arena, retaining the arena memory for reuse.
+ * Any data allocated from the arena must no longer be used.
+ *
+ * @param arena  Pointer to the arena
+ */
+extern void iot_data_arena_reset (iot_data_arena_t * arena);
+
+/**
+ * @brief Free an arena
+ *
+ * The function to release all data allocated from an arena and free the arena
+ *
+ * @param arena  Pointer to the arena (can be NULL), which must not be in scope
+ */
+extern void iot_data_arena_free (iot_data_arena_t * arena);
+
+/**
+ * @brief Get data allocation statistics
+ *
+ * The function to get statistics on data memory usage. Counts of blocks are totals over all data
+ * block size classes. Counts of blocks, chunks and live data exclude data allocated from arenas. String counts are the total number of copied strings
+ * allocated for each storage type. The data block cache is only enabled in release builds, in
+ * debug builds all allocated blocks are in use. The peak number of blocks in use is not tracked on
+ * every allocation, it is the highest number sampled when the block cache grows and when statistics
+ * are read, so usage that rises and falls between samples is not seen (with the block cache disabled,
+ * only reads sample).
+ *
+ * @param stats  Pointer to statistics structure to be updated
+ */
+extern void iot_data_stats (iot_data_stats_t * stats);
+
+/**
+ * @brief Set the data block cache limit
+ *
+ * The function to set the high-water mark for the number of free data blocks retained by the data
+ * block cache when it is trimmed (see iot_data_cache_trim). The default limit is zero.
+ *
+ * @param blocks  Number of free data blocks to retain
+ */
+extern void iot_data_cache_set_limit (uint32_t blocks);
+
+/**
+ * @brief Trim the data block cache
+ *
+ * The function to return memory chunks whose data blocks are all free to the system allocator, while the
+ * number of free data blocks held by the cache exceeds the cache limit. Has no effect in debug builds,
+ * where the data block cache is disabled.
+ *
+ * @return  Number of memory chunks released
+ */
+extern uint32_t iot_data_cache_trim (void);
+
 /**
  * @brief Get core data type
  *
@@ -318,14 +450,38 @@ extern iot_data_t * iot_data_alloc_bool (bool val);
  */
 extern iot_data_t * iot_data_alloc_string (const char * val, iot_data_ownership_t ownership);
 
+/**
+ * @brief Allocate memory for an interned string
+ *
+ * The function to allocate memory for a string whose value is held in a global table of interned
+ * strings. Equal interned strings share the same canonical address and a cached hash, so equality
+ * checks and map lookups with interned keys avoid string comparison and hashing. Interned string
+ * values are retained until the library is finalised, so interning should be used for a bounded
+ * set of strings such as map key names.
+ *
+ * @param val  String
+ * @return     Pointer to the allocated memory
+ */
+extern iot_data_t * iot_data_alloc_string_intern (const char * val);
+
+/**
+ * @brief Check if a string is interned
+ *
+ * The function to return whether a data instance is an interned string
+ *
+ * @param data  Pointer to data (can be NULL)
+ * @return      Whether the data is an interned string. Returns false if data is NULL.
+ */
+extern bool iot_data_string_is_interned (const iot_data_t * data);
+
 /**
  * @brief Allocate memory for an array
  *
  * The function to allocate memory for an array of given size and type. Note that only basic C integer, boolean and floating
  * point types are supported (not string or composed types).
  *
- * @param data       Pointer to C array of data
- * @param length     Number of elements in the array
+ * @param data       Pointer to C array of data (can be NULL if length is zero)
+ * @param length     Number of elements in the array (can be zero)
  * @param type       Type of array element
  * @param ownership  If the ownership is set to IOT_DATA_COPY, a new allocation is made and data is copied to the allocated
  *                   memory, else the ownership of the data is taken.
@@ -643,6 +799,19 @@ extern const iot_data_t * iot_data_map_get (const iot_data_t * map, const iot_da
  */
 extern const iot_data_t * iot_data_string_map_get (const iot_data_t * map, const char * key);
 
+/**
+ * @brief  Get value from the map for a key provided with its hash
+ *
+ * The function to get the value from the map for an input key provided as a string, together with
+ * its precomputed hash (as returned by iot_hash). Avoids rehashing the key on repeated lookups.
+ *
+ * @param map   Map to get the value
+ * @param key   Input key of type String
+ * @param hash  Hash of the key, as returned by iot_hash
+ * @return      Pointer to a value corresponding to the key of type iot_data
+ */
+extern const iot_data_t * iot_data_string_map_get_with_hash (const iot_data_t * map, const char * key, uint32_t hash);
+
 /**
  * @brief Get string value corresponding to key from a map
  *
@@ -1010,16 +1179,354 @@ extern char * iot_data_to_json (const iot_data_t * data);
  */
 extern char * iot_data_to_json_with_size (const iot_data_t * data, uint32_t size);
 
+/**
+ * @brief  Write data as json to a sink
+ *
+ * The function to convert data to json, writing it to a sink function in chunks of at most
+ * a few kilobytes, so the json string is never held in memory in its entirety. This allows
+ * large data to be written directly to a file descriptor, socket or user buffer. Once a sink
+ * write fails no further writes are made.
+ *
+ * @param  data  Input data
+ * @param  sink  Sink function called with each chunk of json (not NUL terminated)
+ * @param  arg   Argument passed to the sink function
+ * @return       Whether all sink writes succeeded
+ */
+extern bool iot_data_to_json_sink (const iot_data_t * data, iot_data_sink_fn sink, void * arg);
+
 /**
  * @brief Convert json to iot_data_t type
  *
- * The function to convert input json string to iot_data
+ * The function to convert input json string to iot_data. Json strings containing a NUL character (\u0000)
+ * are rejected, as string data is NUL terminated.
  *
  * @param  json  Input json string
  * @return       Pointer to data of type iot_data if input string is a json object, NULL otherwise
  */
 extern iot_data_t * iot_data_from_json (const char * json);
 
+/**
+ * @brief Convert json to iot_data_t type, decoding values as typecode types
+ *
+ * The function to convert input json string to iot_data, with values decoded directly as the types given by a
+ * typecode, so that for example map values can be UInt16 and arrays of numbers Float32 arrays. The json is
+ * validated against the typecode as it is parsed. Numbers must be of the typecode type and within its range,
+ * map keys are decoded as the typecode key type and json arrays as vectors or (non empty) arrays. Map or vector
+ * elements with no typecode element type are converted as by iot_data_from_json.
+ *
+ * @param  json      Input json string
+ * @param  typecode  Typecode of the json value
+ * @return           Pointer to data matching the typecode if input string is valid json of that type, NULL otherwise
+ */
+extern iot_data_t * iot_data_from_json_with_typecode (const char * json, const iot_typecode_t * typecode);
+
+/**
+ * @brief Convert json to iot_data_t type with options
+ *
+ * The function to convert input json string to iot_data as iot_data_from_json, with options. If arrays is set,
+ * json arrays of numbers are decoded as arrays. Integers are held in the narrowest integer type holding all the
+ * array's values (unsigned if none are negative) and floating point values as Float32 if all are exactly
+ * representable, otherwise Float64. If an array type is given, arrays (including empty arrays) are of that type.
+ * Json arrays that contain other values or numbers not fitting the given type, or that are empty with no array
+ * type given, are decoded as vectors.
+ * If string_views is set, the json is copied once and unescaped strings (and map keys) too long to be held
+ * within string data reference the copy rather than each being copied. The copy is shared by all such strings
+ * and freed once they are all freed.
+ *
+ * @param  json     Input json string
+ * @param  options  Parse options
+ * @return          Pointer to data of type iot_data if input string is a json object, NULL otherwise
+ */
+extern iot_data_t * iot_data_from_json_with_options (const char * json, const iot_data_json_options_t * options);
+
+/**
+ * @brief Convert json to lazily built iot_data
+ *
+ * The function to convert a json object or array to iot_data that is built on first access. The json is
+ * copied and tokenized, but the contents of each map or vector are only built when first accessed (via
+ * the map and vector getters, iterators, size functions or conversions), with any nested maps and vectors
+ * again left to be built. Converting an unaccessed map or vector to json copies the original json text
+ * (other than null, written as the string "null" as when built), so may retain whitespace and number
+ * formatting. The tokenized json is freed once no unbuilt maps or vectors reference it. As building modifies
+ * the data, a lazy document must not be accessed from several threads at once. Json that is not a single
+ * object or array in strict syntax (including unquoted values other than true, false, null or numbers),
+ * or that has an object with duplicate or escaped keys, is converted as by iot_data_from_json.
+ *
+ * @param  json  Input json string
+ * @return       Pointer to the converted data, NULL if the json is invalid
+ */
+extern iot_data_t * iot_data_from_json_lazy (const char * json);
+
+/**
+ * @brief Allocate an incremental json parser
+ *
+ * The function to allocate a parser that converts json to iot_data as the json is pushed to it in
+ * successive chunks, for example as read from a socket or file. Chunks may be split at any point,
+ * including within strings and numbers. Each top level value is passed to the parser function as soon
+ * as it is complete, so a stream of concatenated or newline delimited json documents can be parsed.
+ * Parsing is as lenient as iot_data_from_json.
+ *
+ * @param  fn   Function called with each complete top level value
+ * @param  arg  Argument passed to the function
+ * @return      Pointer to the allocated parser
+ */
+extern iot_data_json_parser_t * iot_data_json_parser_alloc (iot_data_json_fn fn, void * arg);
+
+/**
+ * @brief Push a chunk of json to an incremental json parser
+ *
+ * The function to parse the next chunk of json, calling the parser function for each top level value
+ * completed by the chunk. Once a syntax error has occurred no further values are parsed until the
+ * parser is finished.
+ *
+ * @param  parser  Pointer to the parser
+ * @param  json    Json chunk (need not be NUL terminated)
+ * @param  len     Length of the json chunk
+ * @return         Whether the json parsed so far is valid
+ */
+extern bool iot_data_json_parser_push (iot_data_json_parser_t * parser, const char * json, size_t len);
+
+/**
+ * @brief Finish incremental json parsing
+ *
+ * The function to signal the end of json input. Any trailing top level number or literal is completed
+ * and passed to the parser function and any incomplete value discarded. The parser is then reset so
+ * can be reused for new input.
+ *
+ * @param  parser  Pointer to the parser
+ * @return         Whether the json input was valid and complete
+ */
+extern bool iot_data_json_parser_finish (iot_data_json_parser_t * parser);
+
+/**
+ * @brief Free an incremental json parser
+ *
+ * The function to free a parser, together with any incomplete value.
+ *
+ * @param  parser  Pointer to the parser
+ */
+extern void iot_data_json_parser_free (iot_data_json_parser_t * parser);
+
+/**
+ * @brief  Convert data to CBOR
+ *
+ * The function to convert data to CBOR (RFC 8949), preserving all data types so that the data is
+ * exactly restored by iot_data_from_cbor. Int64, Float32, Float64, Bool, String, Map and Vector data
+ * are encoded as the equivalent CBOR items and arrays as RFC 8746 typed arrays of the array bytes in
+ * host byte order. Other integer types, Bool arrays, maps not keyed by strings and metadata are
+ * distinguished by private tags.
+ *
+ * @param  data  Input data
+ * @param  size  Set to the size of the returned CBOR
+ * @return       CBOR encoding of the data, which the caller must free
+ */
+extern uint8_t * iot_data_to_cbor (const iot_data_t * data, uint32_t * size);
+
+/**
+ * @brief  Write data as CBOR to a sink
+ *
+ * The function to convert data to CBOR as iot_data_to_cbor, writing it to a sink function in chunks
+ * of at most a few kilobytes. Once a sink write fails no further writes are made.
+ *
+ * @param  data  Input data
+ * @param  sink  Sink function called with each chunk of CBOR
+ * @param  arg   Argument passed to the sink function
+ * @return       Whether all sink writes succeeded
+ */
+extern bool iot_data_to_cbor_sink (const iot_data_t * data, iot_data_sink_fn sink, void * arg);
+
+/**
+ * @brief Convert CBOR to iot_data_t type
+ *
+ * The function to convert a CBOR data item to iot_data. Data encoded by iot_data_to_cbor is restored
+ * exactly. Other CBOR is converted as follows: unsigned and negative integers to Int64 (or UInt64 if
+ * too large), floating point numbers to Float32 (half and single precision) or Float64, byte strings
+ * and RFC 8746 typed arrays (of 8 to 64 bit integers, single or double precision floats) to arrays,
+ * arrays to vectors, maps to maps keyed by the type of their first key, null and undefined to the
+ * string "null". Other tags are ignored. Indefinite length items are supported.
+ *
+ * @param  cbor  Input CBOR
+ * @param  size  Size of the CBOR, which must hold a single data item
+ * @return       Pointer to the data if the CBOR is valid and representable as data, NULL otherwise
+ */
+extern iot_data_t * iot_data_from_cbor (const uint8_t * cbor, uint32_t size);
+
+/**
+ * @brief Allocate a schema codec
+ *
+ * The function to allocate a codec for data of the shape described by a typecode, which is compiled into
+ * an encoding plan once so can be used for any number of values. As the typecode is known to both encoder
+ * and decoder only values are encoded, with no type information: integers as variable length (zigzag if
+ * signed) integers, floats and array elements as little endian bytes and strings, arrays, vectors and maps
+ * preceded by their length. Keys of string keyed maps given in the key list are encoded as their one byte
+ * (for up to 127 keys) list index, other keys as strings. Map and vector elements of any type (no typecode
+ * element type) are encoded as CBOR. Metadata is not encoded.
+ *
+ * @param  typecode  Typecode of the data to be encoded
+ * @param  keys      Vector of known string map keys, can be NULL
+ * @return           Pointer to the allocated codec
+ */
+extern iot_data_schema_t * iot_data_schema_alloc (const iot_typecode_t * typecode, const iot_data_t * keys);
+
+/**
+ * @brief Free a schema codec
+ *
+ * @param  schema  Pointer to the codec
+ */
+extern void iot_data_schema_free (iot_data_schema_t * schema);
+
+/**
+ * @brief  Encode data using a schema codec
+ *
+ * @param  schema  Pointer to the codec
+ * @param  data    Input data, which must match the codec typecode
+ * @param  size    Set to the size of the returned encoding
+ * @return         Encoded data, which the caller must free, or NULL if the data does not match the typecode
+ */
+extern uint8_t * iot_data_schema_encode (const iot_data_schema_t * schema, const iot_data_t * data, uint32_t * size);
+
+/**
+ * @brief  Decode data using a schema codec
+ *
+ * @param  schema  Pointer to the codec, with the same typecode and keys as used to encode
+ * @param  buff    Encoded data
+ * @param  size    Size of the encoded data
+ * @return         Pointer to the decoded data, NULL if the encoding is invalid
+ */
+extern iot_data_t * iot_data_schema_decode (const iot_data_schema_t * schema, const uint8_t * buff, uint32_t size);
+
+/**
+ * @brief  Convert data to a snapshot image
+ *
+ * The function to convert data to a flat, position independent snapshot image, which can be written to a
+ * file and later memory mapped (see iot_file_map) and accessed in place, without conversion back to data.
+ * Map lookups use a hash index held in the image, so are as fast as on map data. Images are specific to
+ * the host byte order and metadata is not included.
+ *
+ * @param  data  Input data
+ * @param  size  Set to the size of the returned image
+ * @return       Snapshot image, which the caller must free
+ */
+extern uint8_t * iot_data_to_snapshot (const iot_data_t * data, uint32_t * size);
+
+/**
+ * @brief  Get the root node of a snapshot image
+ *
+ * The function to check the header of a snapshot image created by iot_data_to_snapshot, returning the
+ * node of the snapshot data. Only the header is checked, so the image must be from a trusted source.
+ * Nodes are valid for as long as the image.
+ *
+ * @param  image  Snapshot image, 8 byte aligned
+ * @param  size   Size of the image
+ * @return        Snapshot data node, NULL if not a valid image
+ */
+extern const iot_data_snapshot_t * iot_data_snapshot_root (const void * image, size_t size);
+
+/**
+ * @brief  Get the data type of a snapshot node
+ *
+ * @param  snapshot  Snapshot node
+ * @return           Type of the data
+ */
+extern iot_data_type_t iot_data_snapshot_type (const iot_data_snapshot_t * snapshot);
+
+/**
+ * @brief  Get the size of a string, array, map or vector snapshot node
+ *
+ * @param  snapshot  Snapshot node
+ * @return           String length, array length, number of map pairs or number of vector elements
+ */
+extern uint32_t iot_data_snapshot_size (const iot_data_snapshot_t * snapshot);
+
+/**
+ * @brief  Get the address of a snapshot node value
+ *
+ * @param  snapshot  Snapshot node
+ * @return           Address of a basic type value or array data, NULL for maps and vectors
+ */
+extern const void * iot_data_snapshot_address (const iot_data_snapshot_t * snapshot);
+
+/**
+ * @brief  Get the string of a snapshot node
+ *
+ * @param  snapshot  Snapshot node
+ * @return           String, NULL if the node is not a string
+ */
+extern const char * iot_data_snapshot_string (const iot_data_snapshot_t * snapshot);
+
+/**
+ * @brief  Get the element type of an array snapshot node
+ *
+ * @param  snapshot  Array snapshot node
+ * @return           Type of the array elements
+ */
+extern iot_data_type_t iot_data_snapshot_array_type (const iot_data_snapshot_t * snapshot);
+
+/**
+ * @brief  Get the key type of a map snapshot node
+ *
+ * @param  snapshot  Map snapshot node
+ * @return           Type of the map keys
+ */
+extern iot_data_type_t iot_data_snapshot_map_key_type (const iot_data_snapshot_t * snapshot);
+
+/**
+ * @brief  Get an element of a vector snapshot node
+ *
+ * @param  vector  Vector snapshot node
+ * @param  index   Element index, less than the vector size
+ * @return         Element snapshot node
+ */
+extern const iot_data_snapshot_t * iot_data_snapshot_vector_get (const iot_data_snapshot_t * vector, uint32_t index);
+
+/**
+ * @brief  Get the key of a map snapshot node pair
+ *
+ * The function to get the key of a map pair, by index in map insertion order, for iterating over a map.
+ *
+ * @param  map    Map snapshot node
+ * @param  index  Pair index, less than the map size
+ * @return        Key snapshot node
+ */
+extern const iot_data_snapshot_t * iot_data_snapshot_map_key (const iot_data_snapshot_t * map, uint32_t index);
+
+/**
+ * @brief  Get the value of a map snapshot node pair
+ *
+ * @param  map    Map snapshot node
+ * @param  index  Pair index, less than the map size
+ * @return        Value snapshot node
+ */
+extern const iot_data_snapshot_t * iot_data_snapshot_map_value (const iot_data_snapshot_t * map, uint32_t index);
+
+/**
+ * @brief  Find a value in a map snapshot node
+ *
+ * @param  map  Map snapshot node
+ * @param  key  Key data
+ * @return      Value snapshot node, NULL if not found
+ */
+extern const iot_data_snapshot_t * iot_data_snapshot_map_get (const iot_data_snapshot_t * map, const iot_data_t * key);
+
+/**
+ * @brief  Find a value in a string keyed map snapshot node
+ *
+ * @param  map  Map snapshot node
+ * @param  key  Key string
+ * @return      Value snapshot node, NULL if not found
+ */
+extern const iot_data_snapshot_t * iot_data_snapshot_string_map_get (const iot_data_snapshot_t * map, const char * key);
+
+/**
+ * @brief  Convert a snapshot node to data
+ *
+ * The function to copy a snapshot node and any nodes it contains to data.
+ *
+ * @param  snapshot  Snapshot node
+ * @return           Copied data, which the caller must free
+ */
+extern iot_data_t * iot_data_snapshot_copy (const iot_data_snapshot_t * snapshot);
+
 #ifdef IOT_HAS_XML
 /**
  * @brief Convert XML to iot_data_t type
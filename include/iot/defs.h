@@ -0,0 +1,7 @@
+#ifndef _IOT_DEFS_H_
+#define _IOT_DEFS_H_
+
+#define IOT_VERSION "1.2.0"
+#define IOT_HAS_XML
+
+#endif
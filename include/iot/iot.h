@@ -24,6 +24,7 @@
 #include "iot/thread.h"
 #include "iot/json.h"
 #include "iot/scheduler.h"
+#include "iot/stats.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -71,6 +72,26 @@ extern char * iot_file_read (const char * path);
  */
 extern uint8_t * iot_file_read_binary (const char * path, size_t * len);
 
+/**
+ * @brief Memory map a file
+ *
+ * Function to map the contents of a file read only into memory, so that the file is read on demand and
+ * shared with other processes mapping the same file. Only supported on platforms with file systems.
+ *
+ * @param path  File path
+ * @param len   Length of the mapped file contents
+ * @return      Mapped file contents (client needs to unmap), NULL if the file could not be mapped or is empty
+ */
+extern const uint8_t * iot_file_map (const char * path, size_t * len);
+
+/**
+ * @brief Unmap a memory mapped file
+ *
+ * @param addr  Mapped file contents, as returned by iot_file_map
+ * @param len   Length of the mapped file contents
+ */
+extern void iot_file_unmap (const uint8_t * addr, size_t len);
+
 #ifdef __cplusplus
 }
 #endif
@@ -36,6 +36,8 @@ typedef enum
 #define IOT_JSON_ERROR_INVAL -2
 /** The string is not a full JSON packet, more bytes expected */
 #define IOT_JSON_ERROR_PART -3
+/** Parsing stopped by an event handler function */
+#define IOT_JSON_ERROR_STOP -4
 
 /**
  * Alias for JSON token structure
@@ -46,6 +48,7 @@ typedef struct
   int32_t start;          /**< start position in JSON data string */
   int32_t end;            /**< End position in JSON data string */
   uint32_t size;          /**< Size of array / object */
+  int32_t parent;         /**< Index of parent token, -1 if none */
 } iot_json_tok_t;
 
 /**
@@ -72,6 +75,8 @@ void iot_json_init (iot_json_parser * parser);
   * @brief Run JSON parser
   *
   * A JSON data string is parsed into an array of tokens each describing a single JSON object.
+  * Each token records the index of its parent token, so parsing is linear in the size of the
+  * JSON string.
   *
   * @param parser     Pointer to JSON parser
   * @param json       Input JSON string
@@ -82,6 +87,104 @@ void iot_json_init (iot_json_parser * parser);
   */
 int iot_json_parse (iot_json_parser * parser, const char * json, size_t len, iot_json_tok_t * tokens, uint32_t num_tokens);
 
+/**
+ * @brief Check whether text is a JSON number
+ *
+ * The function to check text against the JSON number grammar, additionally accepting hexadecimal integers
+ * (such as 0x1F or -0x10) for compatibility with earlier lenient parsing.
+ *
+ * @param str  Text to check, not necessarily NUL terminated
+ * @param len  Length of text
+ * @return     Whether the text is a number
+ */
+bool iot_json_is_number (const char * str, size_t len);
+
+/**
+ * Alias for JSON event handler structure
+ *
+ * Functions called by the JSON event parser as each JSON element is parsed. Any function can be NULL, in which
+ * case the corresponding elements are skipped. Key and string text is unescaped, number text is as in the JSON.
+ * Text is not NUL terminated and is only valid for the duration of the call. Parsing stops if a function
+ * returns false.
+ */
+typedef struct iot_json_handler_t
+{
+  bool (*object_begin) (void * arg);                              /**< Start of object */
+  bool (*object_end) (void * arg);                                /**< End of object */
+  bool (*array_begin) (void * arg);                               /**< Start of array */
+  bool (*array_end) (void * arg);                                 /**< End of array */
+  bool (*key) (void * arg, const char * str, size_t len);         /**< Object key, quoted or unquoted */
+  bool (*string) (void * arg, const char * str, size_t len);      /**< String value */
+  bool (*number) (void * arg, const char * str, size_t len);      /**< Number value (see iot_json_is_number) */
+  bool (*boolean) (void * arg, bool val);                         /**< Boolean value */
+  bool (*null) (void * arg);                                      /**< Null value */
+} iot_json_handler_t;
+
+/** Alias for JSON event parser structure */
+typedef struct iot_json_sax_t iot_json_sax_t;
+
+/**
+ * @brief Parse JSON, calling event handler functions for each element
+ *
+ * The JSON is parsed without building any token array or data, so values of interest can be extracted from
+ * large documents with no allocation beyond a small buffer for strings containing escapes. Parsing is lenient:
+ * commas are optional and object keys may be unquoted. Unquoted values must be true, false, null or a number
+ * (see iot_json_is_number), anything else is invalid. Objects and arrays can be nested to a depth of 512.
+ *
+ * @param json    Input JSON string
+ * @param len     Length of JSON string
+ * @param handler Event handler functions
+ * @param arg     Argument passed to the handler functions
+ * @return        Zero if parsed, IOT_JSON_ERROR_INVAL if invalid, IOT_JSON_ERROR_PART if incomplete or
+ *                IOT_JSON_ERROR_STOP if stopped by a handler function
+ */
+int iot_json_sax_parse (const char * json, size_t len, const iot_json_handler_t * handler, void * arg);
+
+/**
+ * @brief Allocate an incremental JSON event parser
+ *
+ * The parser accepts JSON in successive chunks, which may be split at any point, and calls the handler
+ * functions for each element as soon as it is complete. A sequence of concatenated or newline delimited
+ * JSON documents can be parsed.
+ *
+ * @param handler Event handler functions, which must remain valid while the parser is in use
+ * @param arg     Argument passed to the handler functions
+ * @return        Pointer to the allocated parser
+ */
+iot_json_sax_t * iot_json_sax_alloc (const iot_json_handler_t * handler, void * arg);
+
+/**
+ * @brief Push a chunk of JSON to an incremental JSON event parser
+ *
+ * Once parsing has failed or been stopped by a handler function no further input is parsed until the
+ * parser is finished.
+ *
+ * @param sax  Pointer to JSON event parser
+ * @param json JSON chunk (need not be NUL terminated)
+ * @param len  Length of JSON chunk
+ * @return     Zero, IOT_JSON_ERROR_INVAL if invalid or IOT_JSON_ERROR_STOP if stopped by a handler function
+ */
+int iot_json_sax_push (iot_json_sax_t * sax, const char * json, size_t len);
+
+/**
+ * @brief Finish incremental JSON event parsing
+ *
+ * Signals the end of JSON input, completing any trailing top level primitive. The parser is then reset so can
+ * be reused for new input.
+ *
+ * @param sax  Pointer to JSON event parser
+ * @return     Zero if all input parsed, IOT_JSON_ERROR_INVAL if invalid, IOT_JSON_ERROR_PART if incomplete or
+ *             IOT_JSON_ERROR_STOP if stopped by a handler function
+ */
+int iot_json_sax_finish (iot_json_sax_t * sax);
+
+/**
+ * @brief Free an incremental JSON event parser
+ *
+ * @param sax  Pointer to JSON event parser
+ */
+void iot_json_sax_free (iot_json_sax_t * sax);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,100 @@
+//
+// Copyright (c) 2020 IOTech Ltd
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+
+#ifndef _IOT_STATS_H_
+#define _IOT_STATS_H_
+
+/**
+ * @file
+ * @brief IOTech Data Statistics API
+ */
+
+#include "iot/scheduler.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Data statistics component name */
+#define IOT_STATS_TYPE "IOT::Stats"
+
+/** Alias for data statistics structure */
+typedef struct iot_stats_t iot_stats_t;
+
+/**
+ * @brief Allocate and initialise a data statistics component
+ *
+ * The function to allocate a component that reports data allocation statistics (see iot_data_stats).
+ * If a scheduler is given, statistics are sampled periodically while the component is running and
+ * logged at info level, otherwise statistics are sampled when requested. If trim is set, the data
+ * block cache is trimmed (see iot_data_cache_trim) before each periodic sample.
+ *
+ * @param scheduler  Scheduler used to sample statistics, can be NULL
+ * @param interval   Sample interval in nanoseconds
+ * @param trim       Whether to periodically trim the data block cache
+ * @param logger     Logger, can be NULL
+ * @return           Pointer to the created statistics component
+ */
+extern iot_stats_t * iot_stats_alloc (iot_scheduler_t * scheduler, uint64_t interval, bool trim, iot_logger_t * logger);
+
+/**
+ * @brief Increment the statistics component reference count
+ *
+ * @param stats  Pointer to the statistics component
+ */
+extern void iot_stats_add_ref (iot_stats_t * stats);
+
+/**
+ * @brief Free the resources used by the statistics component
+ *
+ * @param stats  Pointer to the statistics component
+ */
+extern void iot_stats_free (iot_stats_t * stats);
+
+/**
+ * @brief Start periodic sampling of statistics and set the component state to IOT_COMPONENT_RUNNING
+ *
+ * @param stats  Pointer to the statistics component
+ */
+extern void iot_stats_start (iot_stats_t * stats);
+
+/**
+ * @brief Stop periodic sampling of statistics and set the component state to IOT_COMPONENT_STOPPED
+ *
+ * @param stats  Pointer to the statistics component
+ */
+extern void iot_stats_stop (iot_stats_t * stats);
+
+/**
+ * @brief Get data allocation statistics
+ *
+ * The function to return the latest sample of data allocation statistics as a string keyed map, with
+ * entries "Chunks", "BlocksAllocated", "BlocksInUse", "BlocksCached" and "BlocksPeakSampled" (all UInt64,
+ * the last being the highest sampled blocks in use, see iot_data_stats),
+ * "Live" (a map of data type name to live instance count) and "Strings" (a map of "Inline", "Block"
+ * and "Heap" copied string counts). If the component is not sampling periodically a new sample is taken.
+ *
+ * @param stats  Pointer to the statistics component
+ * @return       Map of statistics, which the caller must free
+ */
+extern iot_data_t * iot_stats_data (iot_stats_t * stats);
+
+/**
+ * @brief  Create statistics component factory
+ *
+ * The component configuration supports "Logger" and "Scheduler" component names, "Interval" (sample
+ * interval in milliseconds), "Trim" (bool) and "CacheLimit" (Int64). Note that "CacheLimit" is not
+ * specific to the component, it sets the process wide data block cache limit (see iot_data_cache_set_limit),
+ * so overrides any limit previously set by the application or another statistics component.
+ *
+ * @return  Pointer to statistics component factory
+ */
+extern const iot_component_factory_t * iot_stats_factory (void);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
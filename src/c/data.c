@@ -4,8 +4,10 @@
 // SPDX-License-Identifier: Apache-2.0
 //
 #include "iot/typecode.h"
-#include "iot/json.h"
 #include "iot/base64.h"
+#include "iot/hash.h"
+#include "iot/json.h"
+#include <float.h>
 
 #ifdef IOT_HAS_XML
 #include "yxml.h"
@@ -21,11 +23,36 @@
 #define IOT_DATA_CACHE
 #endif
 
+#if defined (__SSE2__)
+#include <emmintrin.h>
+#define IOT_DATA_SSE2
+#elif defined (__aarch64__) && defined (__ARM_NEON)
+#include <arm_neon.h>
+#define IOT_DATA_NEON
+#endif
+
+#if defined (__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+#define IOT_DATA_BIG_ENDIAN 1
+#else
+#define IOT_DATA_BIG_ENDIAN 0
+#endif
+
+#ifdef __ZEPHYR__ // No thread local storage, so thread local state is shared
+#define IOT_DATA_THREAD_LOCAL
+#else
+#define IOT_DATA_THREAD_LOCAL _Thread_local
+#endif
+
 #define IOT_MEMORY_BLOCK_SIZE 4096
 #define IOT_JSON_BUFF_SIZE 512
 #define IOT_VAL_BUFF_SIZE 128
 #define IOT_JSON_BUFF_DOUBLING_LIMIT 4096
-#define IOT_JSON_BUFF_INCREMENT 1024
+#define IOT_JSON_SINK_BUFF_SIZE 4096
+#define IOT_DATA_MAP_INDEX_THRESHOLD 8u
+#define IOT_DATA_MAP_INDEX_MIN_SIZE 32u
+#define IOT_DATA_INTERN_MIN_SIZE 64u
+#define IOT_JSON_NUMBER_BUFF_SIZE 64u
+#define IOT_JSON_ARRAY_MIN_SIZE 16u
 
 static const char * iot_data_type_names [] = {"Int8","UInt8","Int16","UInt16","Int32","UInt32","Int64","UInt64","Float32","Float64","Bool","String","Array","Map","Vector"};
 static const uint8_t iot_data_type_size [] = { 1u, 1u, 2u, 2u, 4u, 4u, 8u, 8u, 4u, 8u, sizeof (bool), sizeof (char*) };
@@ -54,6 +81,11 @@ struct iot_data_t
   iot_data_type_t type : 8;
   bool release : 1;
   bool release_block : 1;
+  bool interned : 1;
+  bool arena : 1;
+  bool view : 1;
+  bool lazy : 1;
+  uint8_t block_class : 2; // Block class of string storage, when release_block set
 };
 
 struct iot_typecode_t
@@ -69,20 +101,42 @@ typedef struct iot_data_value_base_t
   iot_data_union_t value;
 } iot_data_value_base_t;
 
-typedef struct iot_data_array_t
+typedef struct iot_data_array_base_t
 {
   iot_data_t base;
   iot_data_type_t type;
   uint32_t length;
-  uint32_t size;
   void * data;
-} iot_data_array_t;
+} iot_data_array_base_t;
+
+// Map or vector converted from json and not yet built, referencing the tokenized json and the token of
+// the json object or array. Held in place of the map index or vector values until built.
+
+typedef struct iot_data_lazy_doc_t
+{
+  atomic_uint_fast32_t refs;
+  uint32_t count;
+  iot_json_tok_t * tokens;
+  uint32_t * next;      // Index of first token after the token and its children
+  char * json;
+} iot_data_lazy_doc_t;
+
+typedef struct iot_data_lazy_t
+{
+  iot_data_lazy_doc_t * doc;
+  uint32_t token;
+} iot_data_lazy_t;
 
 typedef struct iot_data_vector_t
 {
   iot_data_t base;
   uint32_t size;
-  iot_data_t ** values;
+  uint32_t capacity;
+  union
+  {
+    iot_data_t ** values;
+    iot_data_lazy_t * lazy;
+  };
 } iot_data_vector_t;
 
 typedef struct iot_data_pair_t
@@ -90,8 +144,19 @@ typedef struct iot_data_pair_t
   iot_data_t base;
   iot_data_t * key;
   iot_data_t * value;
+  struct iot_data_pair_t * prev;
+  uint32_t hash;
 } iot_data_pair_t;
 
+// Open addressing (linear probing) hash index of map pairs, only built once a map
+// grows beyond IOT_DATA_MAP_INDEX_THRESHOLD pairs. Pair list retains insertion order.
+
+typedef struct iot_data_map_index_t
+{
+  uint32_t mask;
+  iot_data_pair_t * slots [];
+} iot_data_map_index_t;
+
 typedef struct iot_data_map_t
 {
   iot_data_t base;
@@ -99,35 +164,115 @@ typedef struct iot_data_map_t
   uint32_t size;
   iot_data_pair_t * head;
   iot_data_pair_t * tail;
+  union
+  {
+    iot_data_map_index_t * index;
+    iot_data_lazy_t * lazy;
+  };
 } iot_data_map_t;
 
+static void iot_data_lazy_load (iot_data_t * data);
+static void iot_data_lazy_release (iot_data_lazy_t * lazy);
+
+static inline iot_data_lazy_t * iot_data_lazy_of (const iot_data_t * data)
+{
+  return (data->type == IOT_DATA_MAP) ? ((const iot_data_map_t*) data)->lazy : ((const iot_data_vector_t*) data)->lazy;
+}
+
+// Build a lazy map or vector before its contents are accessed
+
+static inline void iot_data_lazy_check (const iot_data_t * data)
+{
+  if (data->lazy) iot_data_lazy_load ((iot_data_t*) data);
+}
+
+// String builder, appends at a tracked length so output is never rescanned. The string is kept
+// NUL terminated. If a sink is set the buffer is of fixed size and written to the sink when full.
+
 typedef struct iot_string_holder_t
 {
   char * str;
   size_t size;
-  size_t free;
+  size_t len;
+  iot_data_sink_fn sink; // Optional sink, buffered string written to sink when buffer full
+  void * arg;            // Sink argument
+  bool ok;               // Whether all sink writes succeeded
 } iot_string_holder_t;
 
-// Determine minimum block size that can hold all iot_data types, maximum size of
-// value string cache buffer and number of blocks per allocated memory chunk.
+// Determine minimum block size that can hold all iot_data types and maximum size of
+// value string cache buffer. Blocks are allocated in size classes: small blocks for scalar
+// values and typecodes, standard blocks for all other data types and map pairs, and large
+// blocks for string and array buffers. The smallest class that fits is used. The block size
+// is rounded up to a multiple of 8 so that blocks stay 8 byte aligned on 32 bit targets.
 
-#define IOT_DATA_BLOCK_SIZE (sizeof (iot_data_map_t))
-#define IOT_DATA_BLOCKS ((IOT_MEMORY_BLOCK_SIZE / IOT_DATA_BLOCK_SIZE) - 1)
+#define IOT_DATA_BLOCK_SIZE ((sizeof (iot_data_map_t) + 7u) & ~((size_t) 7u))
+#define IOT_DATA_SMALL_BLOCK_SIZE (sizeof (iot_data_value_base_t))
+#define IOT_DATA_LARGE_BLOCK_SIZE (4u * IOT_DATA_BLOCK_SIZE)
 #define IOT_DATA_VALUE_BUFF_SIZE (IOT_DATA_BLOCK_SIZE - sizeof (iot_data_value_base_t))
-#define IOT_DATA_ALLOCATING ((iot_data_t *) 1)
+#define IOT_DATA_ARRAY_BUFF_SIZE (IOT_DATA_BLOCK_SIZE - sizeof (iot_data_array_base_t))
+
+typedef enum iot_data_block_class_t
+{
+  IOT_DATA_BLOCK_SMALL = 0,
+  IOT_DATA_BLOCK_STANDARD = 1,
+  IOT_DATA_BLOCK_LARGE = 2
+} iot_data_block_class_t;
+
+#define IOT_DATA_BLOCK_CLASSES 3u
+
+static const uint32_t iot_data_block_sizes [IOT_DATA_BLOCK_CLASSES] = { IOT_DATA_SMALL_BLOCK_SIZE, IOT_DATA_BLOCK_SIZE, IOT_DATA_LARGE_BLOCK_SIZE };
 
 typedef struct iot_data_value_t
 {
   iot_data_t base;
   iot_data_union_t value;
-  char buff [IOT_DATA_VALUE_BUFF_SIZE];
+  union
+  {
+    char buff [IOT_DATA_VALUE_BUFF_SIZE];
+    uint32_t hash; // Cached hash of interned string
+    iot_data_t * owner; // Data owning the storage of a string view
+  };
 } iot_data_value_t;
 
+// Arrays copied with a size of up to IOT_DATA_ARRAY_BUFF_SIZE bytes are held in the array buffer.
+// Array size in bytes is not stored, but calculated from the element type size and length.
+
+typedef struct iot_data_array_t
+{
+  iot_data_t base;
+  iot_data_type_t type;
+  uint32_t length;
+  void * data;
+  uint8_t buff [IOT_DATA_ARRAY_BUFF_SIZE];
+} iot_data_array_t;
+
+#define IOT_DATA_ARRAY_SIZE(a) ((uint32_t) iot_data_type_size[(a)->type] * (a)->length)
+
+// Table of interned strings, open addressing (linear probing). Interned strings are never freed.
+
+typedef struct iot_data_intern_t
+{
+  const char * str;
+  uint32_t hash;
+} iot_data_intern_t;
+
+static iot_data_intern_t * iot_data_interns = NULL;
+static uint32_t iot_data_interns_mask = 0;
+static uint32_t iot_data_interns_count = 0;
+static pthread_mutex_t iot_data_intern_mutex;
+
 // Total size of this struct should be <= IOT_MEMORY_BLOCK_SIZE, chunks must be 8 byte aligned.
+// Memory blocks are aligned to IOT_MEMORY_BLOCK_SIZE so the memory block of a data block can be
+// found from its address. Each memory block holds data blocks of a single size class.
+
+#define IOT_MEMORY_BLOCK_DATA (IOT_MEMORY_BLOCK_SIZE - 2u * sizeof (uint64_t))
+#define IOT_DATA_BLOCKS(c) (IOT_MEMORY_BLOCK_DATA / iot_data_block_sizes[c])
+
 typedef struct iot_memory_block_t
 {
-  uint64_t chunks [(IOT_DATA_BLOCKS * IOT_DATA_BLOCK_SIZE) / (sizeof (uint64_t))];
+  uint64_t chunks [IOT_MEMORY_BLOCK_DATA / sizeof (uint64_t)];
   struct iot_memory_block_t * next;
+  uint32_t free; // Number of free data blocks in depot, only valid when trimming cache
 } iot_memory_block_t;
 
 // Data size and alignment sanity checks
@@ -136,234 +281,847 @@ _Static_assert ((IOT_DATA_BLOCK_SIZE % 8) == 0, "IOT_DATA_BLOCK_SIZE not 8 byte
 _Static_assert (sizeof (iot_data_value_t) == IOT_DATA_BLOCK_SIZE, "size of iot_data_value_t not equal to IOT_DATA_BLOCK_SIZE");
 _Static_assert (sizeof (iot_data_map_t) <= IOT_DATA_BLOCK_SIZE, "iot_data_map_t bigger than IOT_DATA_BLOCK_SIZE");
 _Static_assert (sizeof (iot_data_vector_t) <= IOT_DATA_BLOCK_SIZE, "iot_data_vector_t bigger than IOT_DATA_BLOCK_SIZE");
-_Static_assert (sizeof (iot_data_array_t) <= IOT_DATA_BLOCK_SIZE, "iot_data_array_t bigger than IOT_DATA_BLOCK_SIZE");
+_Static_assert (sizeof (iot_data_array_t) == IOT_DATA_BLOCK_SIZE, "size of iot_data_array_t not equal to IOT_DATA_BLOCK_SIZE");
 _Static_assert (sizeof (iot_data_pair_t) <= IOT_DATA_BLOCK_SIZE, "iot_data_pair_t bigger than IOT_DATA_BLOCK_SIZE");
-_Static_assert (sizeof (iot_typecode_t) <= IOT_DATA_BLOCK_SIZE, "iot_typecode_t bigger than IOT_DATA_BLOCK_SIZE");
+_Static_assert (sizeof (iot_typecode_t) <= IOT_DATA_SMALL_BLOCK_SIZE, "iot_typecode_t bigger than IOT_DATA_SMALL_BLOCK_SIZE");
+_Static_assert ((IOT_DATA_SMALL_BLOCK_SIZE % 8) == 0, "IOT_DATA_SMALL_BLOCK_SIZE not 8 byte aligned");
 _Static_assert (sizeof (iot_memory_block_t) <= IOT_MEMORY_BLOCK_SIZE, "iot_memory_block_t bigger than IOT_MEMORY_BLOCK_SIZE");
 _Static_assert (sizeof (iot_data_vector_t) <= sizeof (iot_data_map_t), "iot_data_vector_t bigger than iot_data_map_t");
-_Static_assert (sizeof (iot_data_array_t) <= sizeof (iot_data_map_t), "iot_data_array_t bigger than iot_data_map_t");
 
 extern void iot_data_init (void);
 
-// Data cache usually disabled for debug builds as otherwise too difficult to trace leaks
+// Allocation statistics. Counters are held per thread, so are updated without contention or
+// atomic read-modify-write operations, and are summed on demand. Counts of exited threads are
+// accumulated in retired totals. Per thread counts can be negative as data can be freed by a
+// different thread to the one that allocated it.
+
+typedef enum iot_data_string_tier_t
+{
+  IOT_DATA_STRING_INLINE = 0,
+  IOT_DATA_STRING_BLOCK = 1,
+  IOT_DATA_STRING_HEAP = 2
+} iot_data_string_tier_t;
+
+#define IOT_DATA_COUNT_BLOCKS 0u                                      // Blocks in use, one per size class
+#define IOT_DATA_COUNT_LIVE IOT_DATA_BLOCK_CLASSES                    // Live data, one per type
+#define IOT_DATA_COUNT_STRINGS (IOT_DATA_COUNT_LIVE + IOT_DATA_VECTOR + 1u) // Copied strings, one per tier
+#define IOT_DATA_COUNTERS (IOT_DATA_COUNT_STRINGS + IOT_DATA_STRING_HEAP + 1u)
+
+typedef struct iot_data_thread_stats_t
+{
+  atomic_int_fast64_t counters [IOT_DATA_COUNTERS];
+  struct iot_data_thread_stats_t * next;
+  bool registered;
+} iot_data_thread_stats_t;
+
+static IOT_DATA_THREAD_LOCAL iot_data_thread_stats_t iot_data_thread_stats;
+static iot_data_thread_stats_t * iot_data_stats_threads = NULL;
+static int64_t iot_data_stats_retired [IOT_DATA_COUNTERS];
+static int64_t iot_data_stats_peak = 0;
+static atomic_uint_fast32_t iot_data_stats_chunks [IOT_DATA_BLOCK_CLASSES];
+static pthread_mutex_t iot_data_stats_mutex;
+#ifndef __ZEPHYR__
+static pthread_key_t iot_data_stats_key;
+#endif
 
-#ifdef IOT_DATA_CACHE
-static iot_data_t * iot_data_cache = NULL;
-static iot_memory_block_t * iot_data_blocks = NULL;
-#ifdef IOT_HAS_SPINLOCK
-static pthread_spinlock_t iot_data_slock;
+static void iot_data_thread_stats_register (iot_data_thread_stats_t * stats)
+{
+  pthread_mutex_lock (&iot_data_stats_mutex);
+  if (! stats->registered)
+  {
+    stats->next = iot_data_stats_threads;
+    iot_data_stats_threads = stats;
+    stats->registered = true;
+  }
+  pthread_mutex_unlock (&iot_data_stats_mutex);
+#ifndef __ZEPHYR__
+  pthread_setspecific (iot_data_stats_key, stats); // Arrange for counts to be retired on thread exit
 #endif
-static pthread_mutex_t iot_data_mutex;
+}
+
+#ifndef __ZEPHYR__
+static void iot_data_thread_stats_retire (void * arg)
+{
+  iot_data_thread_stats_t * stats = (iot_data_thread_stats_t*) arg;
+  pthread_mutex_lock (&iot_data_stats_mutex);
+  for (iot_data_thread_stats_t ** iter = &iot_data_stats_threads; *iter; iter = &(*iter)->next)
+  {
+    if (*iter == stats)
+    {
+      *iter = stats->next;
+      break;
+    }
+  }
+  for (uint32_t i = 0; i < IOT_DATA_COUNTERS; i++)
+  {
+    iot_data_stats_retired[i] += atomic_load_explicit (&stats->counters[i], memory_order_relaxed);
+    atomic_store_explicit (&stats->counters[i], 0, memory_order_relaxed);
+  }
+  stats->registered = false;
+  pthread_mutex_unlock (&iot_data_stats_mutex);
+}
+#endif
+
+static inline void iot_data_count (uint32_t counter, int64_t n)
+{
+  iot_data_thread_stats_t * stats = &iot_data_thread_stats;
+  if (! stats->registered) iot_data_thread_stats_register (stats);
+#ifdef __ZEPHYR__ // Counters shared between threads
+  atomic_fetch_add_explicit (&stats->counters[counter], n, memory_order_relaxed);
+#else // Counters only updated by owning thread
+  atomic_store_explicit (&stats->counters[counter], atomic_load_explicit (&stats->counters[counter], memory_order_relaxed) + n, memory_order_relaxed);
 #endif
+}
 
-static iot_data_t * iot_data_all_from_json (iot_json_tok_t ** tokens, const char * json);
+// Sum counters of all threads and update peak blocks in use. Must hold iot_data_stats_mutex.
 
-static void * iot_data_block_alloc (void)
+static void iot_data_stats_sum (int64_t * sums)
 {
-  iot_data_t * data;
+  memcpy (sums, iot_data_stats_retired, sizeof (iot_data_stats_retired));
+  for (iot_data_thread_stats_t * iter = iot_data_stats_threads; iter; iter = iter->next)
+  {
+    for (uint32_t i = 0; i < IOT_DATA_COUNTERS; i++) sums[i] += atomic_load_explicit (&iter->counters[i], memory_order_relaxed);
+  }
+  int64_t blocks = 0;
+  for (uint32_t i = 0; i < IOT_DATA_COUNTERS; i++) if (sums[i] < 0) sums[i] = 0;
+  for (uint32_t c = 0; c < IOT_DATA_BLOCK_CLASSES; c++) blocks += sums[IOT_DATA_COUNT_BLOCKS + c];
+  if (blocks > iot_data_stats_peak) iot_data_stats_peak = blocks;
+}
+
 #ifdef IOT_DATA_CACHE
-#ifdef IOT_HAS_SPINLOCK
-  pthread_spin_lock (&iot_data_slock);
-#else
-  pthread_mutex_lock (&iot_data_mutex);
+static void iot_data_stats_sample (void)
+{
+  int64_t sums [IOT_DATA_COUNTERS];
+  pthread_mutex_lock (&iot_data_stats_mutex);
+  iot_data_stats_sum (sums);
+  pthread_mutex_unlock (&iot_data_stats_mutex);
+}
 #endif
-#ifdef IOT_HAS_SPINLOCK
-  while (iot_data_cache <= IOT_DATA_ALLOCATING)
+
+void iot_data_stats (iot_data_stats_t * stats)
+{
+  int64_t sums [IOT_DATA_COUNTERS];
+  assert (stats);
+  pthread_mutex_lock (&iot_data_stats_mutex);
+  iot_data_stats_sum (sums);
+  stats->blocks_peak_sampled = (uint64_t) iot_data_stats_peak;
+  pthread_mutex_unlock (&iot_data_stats_mutex);
+  for (uint32_t i = 0; i <= IOT_DATA_VECTOR; i++) stats->live[i] = (uint64_t) sums[IOT_DATA_COUNT_LIVE + i];
+  stats->strings_inline = (uint64_t) sums[IOT_DATA_COUNT_STRINGS + IOT_DATA_STRING_INLINE];
+  stats->strings_block = (uint64_t) sums[IOT_DATA_COUNT_STRINGS + IOT_DATA_STRING_BLOCK];
+  stats->strings_heap = (uint64_t) sums[IOT_DATA_COUNT_STRINGS + IOT_DATA_STRING_HEAP];
+  stats->chunks = 0u;
+  stats->blocks_allocated = 0u;
+  stats->blocks_in_use = 0u;
+  stats->blocks_cached = 0u;
+  for (uint32_t c = 0; c < IOT_DATA_BLOCK_CLASSES; c++)
   {
-    bool allocate = (iot_data_cache == NULL);
-    iot_data_t * new_data_cache = NULL;
-    if (allocate) iot_data_cache = IOT_DATA_ALLOCATING;
-    pthread_spin_unlock (&iot_data_slock);
-    pthread_mutex_lock (&iot_data_mutex);
-#else
-    bool allocate = (iot_data_cache == NULL);
+    uint64_t in_use = (uint64_t) sums[IOT_DATA_COUNT_BLOCKS + c];
+#ifdef IOT_DATA_CACHE
+    uint64_t chunks = atomic_load (&iot_data_stats_chunks[c]);
+    uint64_t allocated = chunks * IOT_DATA_BLOCKS (c);
+    if (in_use > allocated) in_use = allocated;
+    stats->chunks += chunks;
+    stats->blocks_cached += allocated - in_use;
 #endif
-    if (allocate)
-    {
-      iot_memory_block_t * block = calloc (1, IOT_MEMORY_BLOCK_SIZE);
-      block->next = iot_data_blocks;
-      iot_data_blocks = block;
-
-      uint8_t * iter = (uint8_t*) block->chunks;
-      new_data_cache = (iot_data_t*) iter;
-      for (unsigned i = 0; i < (IOT_DATA_BLOCKS - 1); i++)
-      {
-        iot_data_t * prev = (iot_data_t*) iter;
-        iter += IOT_DATA_BLOCK_SIZE;
-        prev->next = (iot_data_t*) iter;
-      }
-    }
-#ifdef IOT_HAS_SPINLOCK
-    pthread_mutex_unlock (&iot_data_mutex);
-    pthread_spin_lock (&iot_data_slock);
-    if (allocate) iot_data_cache = new_data_cache;
+    stats->blocks_in_use += in_use;
   }
-#endif
-  data = iot_data_cache;
-  iot_data_cache = data->next;
+  stats->blocks_allocated = stats->blocks_in_use + stats->blocks_cached;
+}
+
+// Data cache usually disabled for debug builds as otherwise too difficult to trace leaks.
+// Free blocks are held in per thread magazines (loaded and previous) so that the common
+// allocation and free paths take no lock. Full magazines are exchanged with a global depot.
+
+#ifdef IOT_DATA_CACHE
+
+#define IOT_DATA_MAGAZINE_SIZE 32
+
+typedef struct iot_data_free_t
+{
+  struct iot_data_free_t * next;     // Next free block in magazine
+  struct iot_data_free_t * next_mag; // Next magazine in depot (head block only)
+  uint32_t count;                    // Number of blocks in magazine (head block only)
+} iot_data_free_t;
+
+typedef struct iot_data_magazine_t
+{
+  iot_data_free_t * head;
+  uint32_t count;
+} iot_data_magazine_t;
+
+typedef struct iot_data_thread_cache_t
+{
+  iot_data_magazine_t loaded [IOT_DATA_BLOCK_CLASSES];
+  iot_data_magazine_t previous [IOT_DATA_BLOCK_CLASSES];
+  bool registered;
+} iot_data_thread_cache_t;
+
+_Static_assert (sizeof (iot_data_free_t) <= IOT_DATA_SMALL_BLOCK_SIZE, "iot_data_free_t bigger than IOT_DATA_SMALL_BLOCK_SIZE");
+
+static iot_data_free_t * iot_data_depot [IOT_DATA_BLOCK_CLASSES];
+static iot_memory_block_t * iot_data_blocks [IOT_DATA_BLOCK_CLASSES];
+static atomic_uint_fast32_t iot_data_cache_limit = ATOMIC_VAR_INIT (0);
 #ifdef IOT_HAS_SPINLOCK
-  pthread_spin_unlock (&iot_data_slock);
+static pthread_spinlock_t iot_data_slock;
 #else
-  pthread_mutex_unlock (&iot_data_mutex);
+static pthread_mutex_t iot_data_mutex;
 #endif
-  data = (data) ? memset (data, 0, IOT_DATA_BLOCK_SIZE) : calloc (1, IOT_DATA_BLOCK_SIZE);
+
+#ifdef __ZEPHYR__
+static iot_data_thread_cache_t iot_data_thread_cache; // Shared, protected by depot lock
 #else
-  data = calloc (1, IOT_DATA_BLOCK_SIZE);
+#define IOT_DATA_THREAD_CACHE
+static IOT_DATA_THREAD_LOCAL iot_data_thread_cache_t iot_data_thread_cache;
+static pthread_key_t iot_data_thread_key;
 #endif
-  return data;
-}
 
-static inline void iot_data_block_free (iot_data_t * data)
+static inline void iot_data_depot_lock (void)
 {
-#ifdef IOT_DATA_CACHE
 #ifdef IOT_HAS_SPINLOCK
   pthread_spin_lock (&iot_data_slock);
-  while (iot_data_cache == IOT_DATA_ALLOCATING)
-  {
-    pthread_spin_unlock (&iot_data_slock);
-    pthread_mutex_lock (&iot_data_mutex);
-    pthread_mutex_unlock (&iot_data_mutex);
-    pthread_spin_lock (&iot_data_slock);
-  }
 #else
   pthread_mutex_lock (&iot_data_mutex);
 #endif
-  data->next = iot_data_cache;
-  iot_data_cache = data;
+}
+
+static inline void iot_data_depot_unlock (void)
+{
 #ifdef IOT_HAS_SPINLOCK
   pthread_spin_unlock (&iot_data_slock);
 #else
   pthread_mutex_unlock (&iot_data_mutex);
 #endif
-#else
-  free (data);
+}
+
+static void iot_data_depot_put (iot_data_magazine_t * mag, iot_data_block_class_t cls)
+{
+  mag->head->count = mag->count;
+#ifdef IOT_DATA_THREAD_CACHE
+  iot_data_depot_lock ();
+#endif
+  mag->head->next_mag = iot_data_depot[cls];
+  iot_data_depot[cls] = mag->head;
+#ifdef IOT_DATA_THREAD_CACHE
+  iot_data_depot_unlock ();
 #endif
+  mag->head = NULL;
+  mag->count = 0;
 }
 
-static void * iot_data_factory_alloc (void)
+static void iot_data_depot_get (iot_data_magazine_t * mag, iot_data_block_class_t cls)
 {
-  iot_data_t * data = iot_data_block_alloc ();
-  atomic_store (&data->refs, 1);
-  return data;
+#ifdef IOT_DATA_THREAD_CACHE
+  iot_data_depot_lock ();
+#endif
+  iot_data_free_t * head = iot_data_depot[cls];
+  if (head) iot_data_depot[cls] = head->next_mag;
+#ifdef IOT_DATA_THREAD_CACHE
+  iot_data_depot_unlock ();
+#endif
+  if (head)
+  {
+    mag->head = head;
+    mag->count = head->count;
+  }
+  else // Depot empty so allocate new memory block and load magazine with all blocks
+  {
+    iot_memory_block_t * block = memset (aligned_alloc (IOT_MEMORY_BLOCK_SIZE, IOT_MEMORY_BLOCK_SIZE), 0, IOT_MEMORY_BLOCK_SIZE);
+    uint8_t * iter = (uint8_t*) block->chunks;
+    for (unsigned i = 0; i < (IOT_DATA_BLOCKS (cls) - 1); i++)
+    {
+      iot_data_free_t * prev = (iot_data_free_t*) iter;
+      iter += iot_data_block_sizes[cls];
+      prev->next = (iot_data_free_t*) iter;
+    }
+    mag->head = (iot_data_free_t*) block->chunks;
+    mag->count = IOT_DATA_BLOCKS (cls);
+#ifdef IOT_DATA_THREAD_CACHE
+    iot_data_depot_lock ();
+#endif
+    block->next = iot_data_blocks[cls];
+    iot_data_blocks[cls] = block;
+#ifdef IOT_DATA_THREAD_CACHE
+    iot_data_depot_unlock ();
+#endif
+    atomic_fetch_add (&iot_data_stats_chunks[cls], 1u);
+    iot_data_stats_sample (); // Cache growth indicates new peak usage
+  }
 }
 
-static inline iot_data_value_t * iot_data_value_alloc (iot_data_type_t type, iot_data_ownership_t own)
+#ifdef IOT_DATA_THREAD_CACHE
+static void iot_data_thread_cache_flush (void * arg)
 {
-  iot_data_value_t * val = iot_data_factory_alloc ();
-  val->base.type = type;
-  val->base.release = (own != IOT_DATA_REF);
-  return val;
+  iot_data_thread_cache_t * cache = (iot_data_thread_cache_t*) arg;
+  for (uint32_t c = 0; c < IOT_DATA_BLOCK_CLASSES; c++)
+  {
+    if (cache->loaded[c].count) iot_data_depot_put (&cache->loaded[c], c);
+    if (cache->previous[c].count) iot_data_depot_put (&cache->previous[c], c);
+  }
+  cache->registered = false;
 }
 
-static void iot_data_fini (void)
+static inline void iot_data_thread_cache_register (iot_data_thread_cache_t * cache)
 {
-#ifdef IOT_DATA_CACHE
-  while (iot_data_blocks)
+  if (! cache->registered) // Arrange for magazines to be returned to depot on thread exit
   {
-    iot_memory_block_t * block = iot_data_blocks;
-    iot_data_blocks = block->next;
-    free (block);
+    pthread_setspecific (iot_data_thread_key, cache);
+    cache->registered = true;
   }
-#ifdef IOT_HAS_SPINLOCK
-  pthread_spin_destroy (&iot_data_slock);
+}
 #endif
-  pthread_mutex_destroy (&iot_data_mutex);
+
+static inline iot_data_thread_cache_t * iot_data_thread_cache_acquire (void)
+{
+#ifndef IOT_DATA_THREAD_CACHE
+  iot_data_depot_lock ();
 #endif
+  return &iot_data_thread_cache;
 }
 
-void iot_data_init (void)
+static inline void iot_data_thread_cache_release (void)
 {
-/*
-  printf ("sizeof (iot_data_value_t): %zu\n", sizeof (iot_data_value_t));
-  printf ("sizeof (iot_data_map_t): %zu\n", sizeof (iot_data_map_t));
-  printf ("sizeof (iot_data_vector_t): %zu\n", sizeof (iot_data_vector_t));
-  printf ("sizeof (iot_data_array_t): %zu\n", sizeof (iot_data_array_t));
-  printf ("sizeof (iot_data_pair_t): %zu\n", sizeof (iot_data_pair_t));
-  printf ("IOT_DATA_BLOCK_SIZE %zu IOT_DATA_BLOCKS: %zu\n", IOT_DATA_BLOCK_SIZE, IOT_DATA_BLOCKS);
-*/
-
-#ifdef IOT_DATA_CACHE
-#ifdef IOT_HAS_SPINLOCK
-  pthread_spin_init (&iot_data_slock, 0);
+#ifndef IOT_DATA_THREAD_CACHE
+  iot_data_depot_unlock ();
 #endif
-  pthread_mutex_init (&iot_data_mutex, NULL);
-  iot_data_block_free (iot_data_block_alloc ());  // Initialize data cache
-#endif
-  atexit (iot_data_fini);
 }
+#endif
 
-void iot_data_add_ref (iot_data_t * data)
+
+// Return smallest block size class that can hold size bytes
+
+static inline iot_data_block_class_t iot_data_block_class (size_t size)
 {
-  assert (data);
-  atomic_fetch_add (&data->refs, 1);
+  return (size <= IOT_DATA_SMALL_BLOCK_SIZE) ? IOT_DATA_BLOCK_SMALL : ((size <= IOT_DATA_BLOCK_SIZE) ? IOT_DATA_BLOCK_STANDARD : IOT_DATA_BLOCK_LARGE);
 }
 
-iot_data_type_t iot_data_name_type (const char * name)
+static void * iot_data_block_alloc (iot_data_block_class_t cls)
 {
-  int type = 0;
-  while (type >= 0)
+#ifdef IOT_DATA_CACHE
+  iot_data_thread_cache_t * cache = iot_data_thread_cache_acquire ();
+  iot_data_magazine_t * loaded = &cache->loaded[cls];
+  if (loaded->count == 0)
   {
-    if (strcasecmp (name, iot_data_type_names[type]) == 0) break;
-    type = (type == IOT_DATA_VECTOR) ? -1 : (type + 1);
+    if (cache->previous[cls].count)
+    {
+      iot_data_magazine_t tmp = *loaded;
+      *loaded = cache->previous[cls];
+      cache->previous[cls] = tmp;
+    }
+    else
+    {
+#ifdef IOT_DATA_THREAD_CACHE
+      iot_data_thread_cache_register (cache);
+#endif
+      iot_data_depot_get (loaded, cls);
+    }
   }
-  return type;
+  iot_data_free_t * block = loaded->head;
+  loaded->head = block->next;
+  loaded->count--;
+  iot_data_thread_cache_release ();
+  iot_data_count (IOT_DATA_COUNT_BLOCKS + cls, 1);
+  return memset (block, 0, iot_data_block_sizes[cls]);
+#else
+  iot_data_count (IOT_DATA_COUNT_BLOCKS + cls, 1);
+  return calloc (1, iot_data_block_sizes[cls]);
+#endif
 }
 
-const char * iot_data_type_string (iot_data_type_t type)
+static inline void iot_data_block_free (void * ptr, iot_data_block_class_t cls)
 {
-  assert (type <= IOT_DATA_VECTOR);
-  return iot_data_type_names[type];
+  iot_data_count (IOT_DATA_COUNT_BLOCKS + cls, -1);
+#ifdef IOT_DATA_CACHE
+  iot_data_thread_cache_t * cache = iot_data_thread_cache_acquire ();
+  iot_data_magazine_t * loaded = &cache->loaded[cls];
+  iot_data_free_t * block = (iot_data_free_t*) ptr;
+  if (loaded->count >= IOT_DATA_MAGAZINE_SIZE)
+  {
+    if (cache->previous[cls].count) iot_data_depot_put (&cache->previous[cls], cls);
+    cache->previous[cls] = *loaded;
+    loaded->head = NULL;
+    loaded->count = 0;
+  }
+#ifdef IOT_DATA_THREAD_CACHE
+  else if (loaded->count == 0)
+  {
+    iot_data_thread_cache_register (cache);
+  }
+#endif
+  block->next = loaded->head;
+  loaded->head = block;
+  loaded->count++;
+  iot_data_thread_cache_release ();
+#else
+  free (ptr);
+#endif
 }
 
-const char * iot_data_type_name (const iot_data_t * data)
+#ifdef IOT_DATA_CACHE
+static inline iot_memory_block_t * iot_data_memory_block (const void * ptr)
 {
-  assert (data && (data->type <= IOT_DATA_VECTOR));
-  return iot_data_type_names[data->type];
+  return (iot_memory_block_t*) ((uintptr_t) ptr & ~((uintptr_t) IOT_MEMORY_BLOCK_SIZE - 1u));
 }
 
-extern void iot_data_set_metadata (iot_data_t * data, iot_data_t * metadata)
-{
-  assert (data);
-  if (data->metadata) iot_data_free (data->metadata);
-  if (metadata) iot_data_add_ref (metadata);
-  data->metadata = metadata;
-}
+// Release memory blocks of a size class whose data blocks are all free in the depot, while the
+// number of free data blocks in the depot exceeds the limit. Free data blocks held in per thread
+// magazines are not counted. Depot occupancy of each memory block is counted by walking the depot.
+// Must hold depot lock.
 
-extern const iot_data_t * iot_data_get_metadata (const iot_data_t * data)
+static uint32_t iot_data_cache_trim_class (iot_data_block_class_t cls, uint32_t limit, iot_memory_block_t ** trimmed)
 {
-  assert (data);
-  return data->metadata;
-}
+  const uint32_t blocks = IOT_DATA_BLOCKS (cls);
+  iot_memory_block_t ** iter;
+  iot_data_free_t * head;
+  iot_data_free_t * next_mag;
+  uint32_t cached = 0;
+  uint32_t released = 0;
 
-bool iot_data_equal (const iot_data_t * v1, const iot_data_t * v2)
-{
-  assert (v1 && v2);
-  if (v1 == v2) return true;
-  if (v1->type == v2->type)
+  for (iot_memory_block_t * block = iot_data_blocks[cls]; block; block = block->next) block->free = 0;
+  for (head = iot_data_depot[cls]; head; head = head->next_mag)
   {
-    switch (v1->type)
+    for (iot_data_free_t * blk = head; blk; blk = blk->next)
     {
-      case IOT_DATA_STRING: return ((iot_data_value_t*) v1)->value.str == ((iot_data_value_t*) v2)->value.str || (strcmp (((iot_data_value_t*) v1)->value.str, ((iot_data_value_t*) v2)->value.str) == 0);
-      case IOT_DATA_ARRAY:
-      {
-        iot_data_array_t * a1 = (iot_data_array_t*) v1;
-        iot_data_array_t * a2 = (iot_data_array_t*) v2;
-        return  ((a1->size == a2->size) && (a1->type == a2->type) && ((a1->data == a2->data) || (memcmp (a1->data, a2->data, a1->size) == 0)));
-      }
-      case IOT_DATA_VECTOR:
+      iot_data_memory_block (blk)->free++;
+      cached++;
+    }
+  }
+  iter = &iot_data_blocks[cls];
+  while (*iter)
+  {
+    iot_memory_block_t * block = *iter;
+    if ((block->free == blocks) && ((cached - blocks) >= limit)) // Fully free blocks are counted in cached
+    {
+      *iter = block->next;
+      block->next = *trimmed;
+      block->free = UINT32_MAX; // Mark as released
+      *trimmed = block;
+      cached -= blocks;
+      released++;
+    }
+    else
+    {
+      iter = &block->next;
+    }
+  }
+  if (released) // Rebuild depot from data blocks of retained memory blocks
+  {
+    iot_data_free_t * depot = NULL;
+    iot_data_magazine_t mag = { NULL, 0 };
+    for (head = iot_data_depot[cls]; head; head = next_mag)
+    {
+      iot_data_free_t * next;
+      next_mag = head->next_mag;
+      for (iot_data_free_t * blk = head; blk; blk = next)
       {
-        if (iot_data_vector_size (v1) != iot_data_vector_size (v2)) return false;
-
-        iot_data_vector_iter_t iter1;
-        iot_data_vector_iter_t iter2;
-        iot_data_vector_iter (v1, &iter1);
-        iot_data_vector_iter (v2, &iter2);
-
-        while ((iot_data_vector_iter_next (&iter1)) && (iot_data_vector_iter_next (&iter2)))
+        next = blk->next;
+        if (iot_data_memory_block (blk)->free != UINT32_MAX)
         {
-          const iot_data_t * data1 = iot_data_vector_get (v1, (iter1.index - 1));
-          const iot_data_t * data2 = iot_data_vector_get (v2, (iter2.index - 1));
-          if (!iot_data_equal (data1, data2)) return false;
+          blk->next = mag.head;
+          mag.head = blk;
+          if (++mag.count == IOT_DATA_MAGAZINE_SIZE)
+          {
+            mag.head->count = mag.count;
+            mag.head->next_mag = depot;
+            depot = mag.head;
+            mag.head = NULL;
+            mag.count = 0;
+          }
+        }
+      }
+    }
+    if (mag.count)
+    {
+      mag.head->count = mag.count;
+      mag.head->next_mag = depot;
+      depot = mag.head;
+    }
+    iot_data_depot[cls] = depot;
+  }
+  atomic_fetch_sub (&iot_data_stats_chunks[cls], released);
+  return released;
+}
+#endif
+
+void iot_data_cache_set_limit (uint32_t blocks)
+{
+#ifdef IOT_DATA_CACHE
+  atomic_store (&iot_data_cache_limit, blocks);
+#else
+  (void) blocks;
+#endif
+}
+
+uint32_t iot_data_cache_trim (void)
+{
+  uint32_t released = 0;
+#ifdef IOT_DATA_CACHE
+  const uint32_t limit = (uint32_t) atomic_load (&iot_data_cache_limit);
+  iot_memory_block_t * trimmed = NULL;
+  iot_data_depot_lock ();
+  for (uint32_t c = 0; c < IOT_DATA_BLOCK_CLASSES; c++)
+  {
+    released += iot_data_cache_trim_class (c, limit, &trimmed);
+  }
+  iot_data_depot_unlock ();
+  while (trimmed)
+  {
+    iot_memory_block_t * block = trimmed;
+    trimmed = block->next;
+    free (block);
+  }
+#endif
+  return released;
+}
+
+// Arena allocation. Data allocated while an arena is the current allocation target of a thread
+// is bump allocated from the arena's chunks and only released when the arena is reset or freed.
+// Chunks are aligned to their size so that the owning arena can be found from any data address.
+
+#define IOT_DATA_ARENA_CHUNK_SIZE 65536u
+
+typedef struct iot_data_arena_chunk_t
+{
+  struct iot_data_arena_chunk_t * next;
+  iot_data_arena_t * arena;
+} iot_data_arena_chunk_t;
+
+typedef struct iot_data_arena_ref_t
+{
+  struct iot_data_arena_ref_t * next;
+  void * ptr;
+} iot_data_arena_ref_t;
+
+struct iot_data_arena_t
+{
+  iot_data_arena_chunk_t * chunks;
+  uint8_t * ptr;
+  uint8_t * end;
+  iot_data_arena_ref_t * heap;     // Heap allocations freed with arena
+  iot_data_arena_ref_t * data;     // Non arena data referenced by arena data
+  iot_data_arena_t * prev;         // Previous allocation target of thread
+};
+
+#define IOT_DATA_ARENA_CHUNK_DATA (IOT_DATA_ARENA_CHUNK_SIZE - sizeof (iot_data_arena_chunk_t))
+
+static IOT_DATA_THREAD_LOCAL iot_data_arena_t * iot_data_arena_current = NULL;
+
+static inline iot_data_arena_t * iot_data_arena_of (const iot_data_t * data)
+{
+  return ((iot_data_arena_chunk_t*) ((uintptr_t) data & ~((uintptr_t) IOT_DATA_ARENA_CHUNK_SIZE - 1u)))->arena;
+}
+
+static void iot_data_arena_add_chunk (iot_data_arena_t * arena)
+{
+  iot_data_arena_chunk_t * chunk = aligned_alloc (IOT_DATA_ARENA_CHUNK_SIZE, IOT_DATA_ARENA_CHUNK_SIZE);
+  chunk->arena = arena;
+  chunk->next = arena->chunks;
+  arena->chunks = chunk;
+  arena->ptr = (uint8_t*) (chunk + 1);
+  arena->end = (uint8_t*) chunk + IOT_DATA_ARENA_CHUNK_SIZE;
+}
+
+static void * iot_data_arena_mem (iot_data_arena_t * arena, size_t size);
+
+static void iot_data_arena_ref (iot_data_arena_t * arena, iot_data_arena_ref_t ** list, void * ptr)
+{
+  iot_data_arena_ref_t * ref = iot_data_arena_mem (arena, sizeof (*ref));
+  ref->ptr = ptr;
+  ref->next = *list;
+  *list = ref;
+}
+
+static void * iot_data_arena_mem (iot_data_arena_t * arena, size_t size)
+{
+  void * mem;
+  size = (size + 7u) & ~((size_t) 7u);
+  if (size > IOT_DATA_ARENA_CHUNK_DATA / 4u) // Large allocations made from heap
+  {
+    mem = calloc (1, size);
+    iot_data_arena_ref (arena, &arena->heap, mem);
+  }
+  else
+  {
+    if ((size_t) (arena->end - arena->ptr) < size) iot_data_arena_add_chunk (arena);
+    mem = memset (arena->ptr, 0, size);
+    arena->ptr += size;
+  }
+  return mem;
+}
+
+// Allocate memory owned by a data element, from the element's arena or the heap
+
+static inline void * iot_data_mem_alloc (const iot_data_t * owner, size_t size)
+{
+  return owner->arena ? iot_data_arena_mem (iot_data_arena_of (owner), size) : calloc (1, size);
+}
+
+static inline void iot_data_mem_free (const iot_data_t * owner, void * ptr)
+{
+  if (! owner->arena) free (ptr);
+}
+
+// Account for a heap allocation taken by arena data
+
+static inline void iot_data_arena_take (const iot_data_t * owner, void * ptr)
+{
+  iot_data_arena_ref (iot_data_arena_of (owner), &iot_data_arena_of (owner)->heap, ptr);
+}
+
+// Account for a non arena data reference held by arena data, released with the arena
+
+static inline void iot_data_arena_hold (const iot_data_t * owner, iot_data_t * data)
+{
+  assert (! data->arena || (owner->arena && iot_data_arena_of (owner) == iot_data_arena_of (data))); // Arena data can only be referenced from the same arena
+  if (owner->arena && ! data->arena) iot_data_arena_ref (iot_data_arena_of (owner), &iot_data_arena_of (owner)->data, data);
+}
+
+// Release a data reference held by a container or data element
+
+static inline void iot_data_release (const iot_data_t * owner, iot_data_t * data)
+{
+  if (! owner->arena) iot_data_free (data);
+}
+
+iot_data_arena_t * iot_data_arena_alloc (void)
+{
+  iot_data_arena_t * arena = calloc (1, sizeof (*arena));
+  iot_data_arena_add_chunk (arena);
+  return arena;
+}
+
+void iot_data_arena_begin (iot_data_arena_t * arena)
+{
+  assert (arena && (arena->prev == NULL) && (arena != iot_data_arena_current));
+  arena->prev = iot_data_arena_current;
+  iot_data_arena_current = arena;
+}
+
+void iot_data_arena_end (iot_data_arena_t * arena)
+{
+  assert (arena && (arena == iot_data_arena_current));
+  iot_data_arena_current = arena->prev;
+  arena->prev = NULL;
+}
+
+void iot_data_arena_reset (iot_data_arena_t * arena)
+{
+  assert (arena);
+  iot_data_arena_ref_t * ref;
+  for (ref = arena->data; ref; ref = ref->next) iot_data_free (ref->ptr);
+  for (ref = arena->heap; ref; ref = ref->next) free (ref->ptr);
+  arena->data = NULL;
+  arena->heap = NULL;
+  while (arena->chunks->next) // Retain first chunk for reuse
+  {
+    iot_data_arena_chunk_t * chunk = arena->chunks;
+    arena->chunks = chunk->next;
+    free (chunk);
+  }
+  arena->ptr = (uint8_t*) (arena->chunks + 1);
+}
+
+void iot_data_arena_free (iot_data_arena_t * arena)
+{
+  if (arena)
+  {
+    assert (arena != iot_data_arena_current);
+    iot_data_arena_reset (arena);
+    free (arena->chunks);
+    free (arena);
+  }
+}
+
+// Scalar values are held in small blocks, all other data types in standard blocks
+
+static inline iot_data_block_class_t iot_data_type_class (iot_data_type_t type)
+{
+  return (type < IOT_DATA_STRING) ? IOT_DATA_BLOCK_SMALL : IOT_DATA_BLOCK_STANDARD;
+}
+
+static void * iot_data_factory_alloc (iot_data_type_t type)
+{
+  iot_data_t * data;
+  iot_data_arena_t * arena = iot_data_arena_current;
+  if (arena)
+  {
+    data = iot_data_arena_mem (arena, iot_data_block_sizes[iot_data_type_class (type)]);
+    data->arena = true;
+  }
+  else
+  {
+    data = iot_data_block_alloc (iot_data_type_class (type));
+    iot_data_count (IOT_DATA_COUNT_LIVE + type, 1);
+  }
+  data->type = type;
+  atomic_store (&data->refs, 1);
+  return data;
+}
+
+static inline iot_data_value_t * iot_data_value_alloc (iot_data_type_t type, iot_data_ownership_t own)
+{
+  iot_data_value_t * val = iot_data_factory_alloc (type);
+  val->base.release = (own != IOT_DATA_REF);
+  return val;
+}
+
+static void iot_data_fini (void)
+{
+  for (uint32_t i = 0; iot_data_interns && i <= iot_data_interns_mask; i++)
+  {
+    free ((char*) iot_data_interns[i].str);
+  }
+  free (iot_data_interns);
+  iot_data_interns = NULL;
+  iot_data_interns_mask = 0;
+  iot_data_interns_count = 0;
+  pthread_mutex_destroy (&iot_data_intern_mutex);
+  iot_data_stats_threads = NULL;
+  memset (iot_data_stats_retired, 0, sizeof (iot_data_stats_retired));
+  memset (&iot_data_thread_stats, 0, sizeof (iot_data_thread_stats));
+  iot_data_stats_peak = 0;
+  for (uint32_t c = 0; c < IOT_DATA_BLOCK_CLASSES; c++) atomic_store (&iot_data_stats_chunks[c], 0u);
+#ifndef __ZEPHYR__
+  pthread_key_delete (iot_data_stats_key);
+#endif
+  pthread_mutex_destroy (&iot_data_stats_mutex);
+#ifdef IOT_DATA_CACHE
+  for (uint32_t c = 0; c < IOT_DATA_BLOCK_CLASSES; c++)
+  {
+    while (iot_data_blocks[c])
+    {
+      iot_memory_block_t * block = iot_data_blocks[c];
+      iot_data_blocks[c] = block->next;
+      free (block);
+    }
+    iot_data_depot[c] = NULL;
+  }
+  memset (&iot_data_thread_cache, 0, sizeof (iot_data_thread_cache));
+#ifdef IOT_DATA_THREAD_CACHE
+  pthread_key_delete (iot_data_thread_key);
+#endif
+#ifdef IOT_HAS_SPINLOCK
+  pthread_spin_destroy (&iot_data_slock);
+#else
+  pthread_mutex_destroy (&iot_data_mutex);
+#endif
+#endif
+}
+
+void iot_data_init (void)
+{
+/*
+  printf ("sizeof (iot_data_value_t): %zu\n", sizeof (iot_data_value_t));
+  printf ("sizeof (iot_data_map_t): %zu\n", sizeof (iot_data_map_t));
+  printf ("sizeof (iot_data_vector_t): %zu\n", sizeof (iot_data_vector_t));
+  printf ("sizeof (iot_data_array_t): %zu\n", sizeof (iot_data_array_t));
+  printf ("sizeof (iot_data_pair_t): %zu\n", sizeof (iot_data_pair_t));
+  printf ("IOT_DATA_BLOCK_SIZE %zu IOT_DATA_BLOCKS: %zu\n", IOT_DATA_BLOCK_SIZE, IOT_DATA_BLOCKS (IOT_DATA_BLOCK_STANDARD));
+*/
+
+  pthread_mutex_init (&iot_data_intern_mutex, NULL);
+  pthread_mutex_init (&iot_data_stats_mutex, NULL);
+#ifndef __ZEPHYR__
+  pthread_key_create (&iot_data_stats_key, iot_data_thread_stats_retire);
+#endif
+#ifdef IOT_DATA_CACHE
+#ifdef IOT_HAS_SPINLOCK
+  pthread_spin_init (&iot_data_slock, 0);
+#else
+  pthread_mutex_init (&iot_data_mutex, NULL);
+#endif
+#ifdef IOT_DATA_THREAD_CACHE
+  pthread_key_create (&iot_data_thread_key, iot_data_thread_cache_flush);
+#endif
+  for (uint32_t c = 0; c < IOT_DATA_BLOCK_CLASSES; c++) // Initialize data cache
+  {
+    iot_data_block_free (iot_data_block_alloc (c), c);
+  }
+#endif
+  atexit (iot_data_fini);
+}
+
+void iot_data_add_ref (iot_data_t * data)
+{
+  assert (data);
+  atomic_fetch_add (&data->refs, 1);
+}
+
+iot_data_type_t iot_data_name_type (const char * name)
+{
+  int type = 0;
+  while (type >= 0)
+  {
+    if (strcasecmp (name, iot_data_type_names[type]) == 0) break;
+    type = (type == IOT_DATA_VECTOR) ? -1 : (type + 1);
+  }
+  return type;
+}
+
+const char * iot_data_type_string (iot_data_type_t type)
+{
+  assert (type <= IOT_DATA_VECTOR);
+  return iot_data_type_names[type];
+}
+
+const char * iot_data_type_name (const iot_data_t * data)
+{
+  assert (data && (data->type <= IOT_DATA_VECTOR));
+  return iot_data_type_names[data->type];
+}
+
+extern void iot_data_set_metadata (iot_data_t * data, iot_data_t * metadata)
+{
+  assert (data);
+  if (data->metadata) iot_data_release (data, data->metadata);
+  if (metadata)
+  {
+    iot_data_add_ref (metadata);
+    iot_data_arena_hold (data, metadata);
+  }
+  data->metadata = metadata;
+}
+
+extern const iot_data_t * iot_data_get_metadata (const iot_data_t * data)
+{
+  assert (data);
+  return data->metadata;
+}
+
+bool iot_data_equal (const iot_data_t * v1, const iot_data_t * v2)
+{
+  assert (v1 && v2);
+  if (v1 == v2) return true;
+  if (v1->type == v2->type)
+  {
+    switch (v1->type)
+    {
+      case IOT_DATA_STRING:
+      {
+        const char * s1 = ((iot_data_value_t*) v1)->value.str;
+        const char * s2 = ((iot_data_value_t*) v2)->value.str;
+        return (s1 == s2) || (! (v1->interned && v2->interned) && (strcmp (s1, s2) == 0));
+      }
+      case IOT_DATA_ARRAY:
+      {
+        iot_data_array_t * a1 = (iot_data_array_t*) v1;
+        iot_data_array_t * a2 = (iot_data_array_t*) v2;
+        return  ((a1->length == a2->length) && (a1->type == a2->type) && ((a1->data == a2->data) || (memcmp (a1->data, a2->data, IOT_DATA_ARRAY_SIZE (a1)) == 0)));
+      }
+      case IOT_DATA_VECTOR:
+      {
+        if (iot_data_vector_size (v1) != iot_data_vector_size (v2)) return false;
+
+        iot_data_vector_iter_t iter1;
+        iot_data_vector_iter_t iter2;
+        iot_data_vector_iter (v1, &iter1);
+        iot_data_vector_iter (v2, &iter2);
+
+        while ((iot_data_vector_iter_next (&iter1)) && (iot_data_vector_iter_next (&iter2)))
+        {
+          const iot_data_t * data1 = iot_data_vector_get (v1, (iter1.index - 1));
+          const iot_data_t * data2 = iot_data_vector_get (v2, (iter2.index - 1));
+          if (!iot_data_equal (data1, data2)) return false;
         }
         return true;
       }
@@ -397,18 +1155,69 @@ bool iot_data_equal (const iot_data_t * v1, const iot_data_t * v2)
 iot_data_t * iot_data_alloc_map (iot_data_type_t key_type)
 {
   assert (key_type < IOT_DATA_MAP);
-  iot_data_map_t * map = iot_data_factory_alloc ();
-  map->base.type = IOT_DATA_MAP;
+  iot_data_map_t * map = iot_data_factory_alloc (IOT_DATA_MAP);
   map->key_type = key_type;
   return (iot_data_t*) map;
 }
 
+// Vector element slots are held in the smallest data block that fits, or on the heap if larger than
+// a large block. Capacity is rounded up to the number of slots in a block, so slot storage can be
+// determined from the capacity. Slots beyond the vector size are always NULL.
+
+static iot_data_t ** iot_data_vector_slots_alloc (const iot_data_vector_t * vector, uint32_t * capacity)
+{
+  size_t size = *capacity * sizeof (iot_data_t*);
+  if (size == 0) return NULL;
+  if (vector->base.arena) return iot_data_mem_alloc (&vector->base, size);
+  if (size <= IOT_DATA_LARGE_BLOCK_SIZE)
+  {
+    iot_data_block_class_t cls = iot_data_block_class (size);
+    *capacity = iot_data_block_sizes[cls] / sizeof (iot_data_t*);
+    return iot_data_block_alloc (cls);
+  }
+  return calloc (1, size);
+}
+
+static void iot_data_vector_slots_free (const iot_data_vector_t * vector)
+{
+  size_t size = vector->capacity * sizeof (iot_data_t*);
+  if (size && ! vector->base.arena)
+  {
+    if (size <= IOT_DATA_LARGE_BLOCK_SIZE)
+    {
+      iot_data_block_free (vector->values, iot_data_block_class (size));
+    }
+    else
+    {
+      free (vector->values);
+    }
+  }
+}
+
+static void iot_data_vector_reserve (iot_data_vector_t * vector, uint32_t capacity)
+{
+  size_t size = capacity * sizeof (iot_data_t*);
+  if (! vector->base.arena && (size > IOT_DATA_LARGE_BLOCK_SIZE) && (vector->capacity * sizeof (iot_data_t*) > IOT_DATA_LARGE_BLOCK_SIZE))
+  {
+    vector->values = realloc (vector->values, size);
+    if (capacity > vector->capacity) memset (&vector->values[vector->capacity], 0, (capacity - vector->capacity) * sizeof (iot_data_t*));
+  }
+  else
+  {
+    iot_data_t ** values = iot_data_vector_slots_alloc (vector, &capacity);
+    if (vector->size) memcpy (values, vector->values, vector->size * sizeof (iot_data_t*));
+    iot_data_vector_slots_free (vector);
+    vector->values = values;
+  }
+  vector->capacity = capacity;
+}
+
 iot_data_t * iot_data_alloc_vector (uint32_t size)
 {
-  iot_data_vector_t * vector = iot_data_factory_alloc ();
-  vector->base.type = IOT_DATA_VECTOR;
+  iot_data_vector_t * vector = iot_data_factory_alloc (IOT_DATA_VECTOR);
+  vector->capacity = size;
+  vector->values = iot_data_vector_slots_alloc (vector, &vector->capacity);
   vector->size = size;
-  vector->values = calloc (size, sizeof (iot_data_t*));
   return (iot_data_t*) vector;
 }
 
@@ -430,7 +1239,7 @@ void * iot_data_address (const iot_data_t * data)
 
 void iot_data_free (iot_data_t * data)
 {
-  if (data && (atomic_fetch_add (&data->refs, -1) <= 1))
+  if (data && ! data->arena && (atomic_fetch_add (&data->refs, -1) <= 1))
   {
     if (data->metadata) iot_data_free (data->metadata);
     switch (data->type)
@@ -438,11 +1247,15 @@ void iot_data_free (iot_data_t * data)
       case IOT_DATA_STRING:
       {
         iot_data_value_t * val = (iot_data_value_t*) data;
-        if (data->release && (val->value.str != val->buff))
+        if (data->view)
+        {
+          iot_data_free (val->owner);
+        }
+        else if (data->release && (val->value.str != val->buff))
         {
           if (data->release_block)
           {
-            iot_data_block_free ((iot_data_t*) val->value.str);
+            iot_data_block_free (val->value.str, data->block_class);
           }
           else
           {
@@ -453,37 +1266,57 @@ void iot_data_free (iot_data_t * data)
       }
       case IOT_DATA_ARRAY:
       {
-        if (data->release) free (((iot_data_array_t*) data)->data);
-        break;
+        iot_data_array_t * array = (iot_data_array_t*) data;
+        if (data->release_block)
+        {
+          iot_data_block_free (array->data, iot_data_block_class (IOT_DATA_ARRAY_SIZE (array)));
+        }
+        else if (data->release && (array->data != array->buff))
+        {
+          free (array->data);
+        }
+        break;
       }
       case IOT_DATA_MAP:
       {
         iot_data_map_t * map = (iot_data_map_t*) data;
         iot_data_pair_t * pair;
+        if (data->lazy)
+        {
+          iot_data_lazy_release (map->lazy);
+          break;
+        }
         while ((pair = map->head))
         {
           iot_data_free (pair->key);
           iot_data_free (pair->value);
           map->head = (iot_data_pair_t *) pair->base.next;
-          iot_data_block_free (&pair->base);
+          iot_data_block_free (pair, IOT_DATA_BLOCK_STANDARD);
         }
+        free (map->index);
         map->size = 0;
         break;
       }
       case IOT_DATA_VECTOR:
       {
         iot_data_vector_t * vector = (iot_data_vector_t*) data;
+        if (data->lazy)
+        {
+          iot_data_lazy_release (vector->lazy);
+          break;
+        }
         for (uint32_t i = 0; i < vector->size; i++)
         {
           iot_data_free (vector->values[i]);
         }
-        free (vector->values);
+        iot_data_vector_slots_free (vector);
         vector->size = 0;
         break;
       }
       default: break;
     }
-    iot_data_block_free (data);
+    iot_data_count (IOT_DATA_COUNT_LIVE + data->type, -1);
+    iot_data_block_free (data, iot_data_type_class (data->type));
   }
 }
 
@@ -620,6 +1453,35 @@ iot_data_t * iot_data_alloc_bool (bool val)
   return (iot_data_t*) data;
 }
 
+// Set storage for a copied string of len characters (excluding terminator) and return it
+
+static char * iot_data_string_storage (iot_data_value_t * data, size_t len)
+{
+  if (len < IOT_DATA_VALUE_BUFF_SIZE) // If string small enough save in iot_data_value_t buffer
+  {
+    data->value.str = data->buff;
+    iot_data_count (IOT_DATA_COUNT_STRINGS + IOT_DATA_STRING_INLINE, 1);
+  }
+  else if (data->base.arena) // If allocated in arena save in arena
+  {
+    data->value.str = iot_data_mem_alloc (&data->base, len + 1u);
+  }
+  else if (len < IOT_DATA_LARGE_BLOCK_SIZE) // If less than size of largest block save in smallest block that fits
+  {
+    // Record block class as string may contain embedded NULs, so cannot be derived from strlen when freed
+    data->base.block_class = iot_data_block_class (len + 1u);
+    data->value.str = iot_data_block_alloc (data->base.block_class);
+    data->base.release_block = true;
+    iot_data_count (IOT_DATA_COUNT_STRINGS + IOT_DATA_STRING_BLOCK, 1);
+  }
+  else // Allocate as last resort
+  {
+    data->value.str = malloc (len + 1u);
+    iot_data_count (IOT_DATA_COUNT_STRINGS + IOT_DATA_STRING_HEAP, 1);
+  }
+  return data->value.str;
+}
+
 iot_data_t * iot_data_alloc_string (const char * val, iot_data_ownership_t ownership)
 {
   assert (val);
@@ -628,39 +1490,111 @@ iot_data_t * iot_data_alloc_string (const char * val, iot_data_ownership_t owner
   if (ownership == IOT_DATA_COPY)
   {
     size_t len = strlen (val);
-    if (len < IOT_DATA_VALUE_BUFF_SIZE) // If string small enough save in iot_data_value_t buffer
-    {
-      data->value.str = data->buff;
-      strcpy (data->buff, val);
-    }
-    else if (len < IOT_DATA_BLOCK_SIZE) // If less than size of block save in block
-    {
-      data->value.str = iot_data_block_alloc ();
-      strcpy (data->value.str, val);
-      data->base.release_block = true;
-    }
-    else // Allocate as last resort
+    memcpy (iot_data_string_storage (data, len), val, len + 1u);
+  }
+  else if ((ownership == IOT_DATA_TAKE) && data->base.arena)
+  {
+    iot_data_arena_take (&data->base, data->value.str);
+  }
+  return (iot_data_t*) data;
+}
+
+// String referencing storage held by another data item, which is kept until the string is freed
+
+static iot_data_t * iot_data_string_view (iot_data_t * owner, const char * str)
+{
+  iot_data_value_t * data = iot_data_value_alloc (IOT_DATA_STRING, IOT_DATA_REF);
+  data->value.str = (char*) str;
+  data->owner = owner;
+  data->base.view = true;
+  iot_data_add_ref (owner);
+  return (iot_data_t*) data;
+}
+
+static void iot_data_intern_grow (void)
+{
+  uint32_t size = iot_data_interns ? (iot_data_interns_mask + 1u) * 2u : IOT_DATA_INTERN_MIN_SIZE;
+  iot_data_intern_t * table = calloc (size, sizeof (iot_data_intern_t));
+  for (uint32_t i = 0; iot_data_interns && i <= iot_data_interns_mask; i++)
+  {
+    if (iot_data_interns[i].str)
     {
-      data->value.str = strdup (val);
+      uint32_t j = iot_data_interns[i].hash & (size - 1u);
+      while (table[j].str) j = (j + 1u) & (size - 1u);
+      table[j] = iot_data_interns[i];
     }
   }
+  free (iot_data_interns);
+  iot_data_interns = table;
+  iot_data_interns_mask = size - 1u;
+}
+
+iot_data_t * iot_data_alloc_string_intern (const char * val)
+{
+  assert (val);
+  uint32_t hash = iot_hash (val);
+  iot_data_value_t * data = iot_data_value_alloc (IOT_DATA_STRING, IOT_DATA_REF);
+  pthread_mutex_lock (&iot_data_intern_mutex);
+  if ((iot_data_interns_count + 1u) * 2u > iot_data_interns_mask + 1u) // Keep load factor below 0.5
+  {
+    iot_data_intern_grow ();
+  }
+  uint32_t i = hash & iot_data_interns_mask;
+  while (iot_data_interns[i].str && (iot_data_interns[i].hash != hash || strcmp (iot_data_interns[i].str, val) != 0))
+  {
+    i = (i + 1u) & iot_data_interns_mask;
+  }
+  if (iot_data_interns[i].str == NULL)
+  {
+    iot_data_interns[i].str = strdup (val);
+    iot_data_interns[i].hash = hash;
+    iot_data_interns_count++;
+  }
+  data->value.str = (char*) iot_data_interns[i].str;
+  pthread_mutex_unlock (&iot_data_intern_mutex);
+  data->hash = hash;
+  data->base.interned = true;
   return (iot_data_t*) data;
 }
 
+bool iot_data_string_is_interned (const iot_data_t * data)
+{
+  return (data && (data->type == IOT_DATA_STRING) && data->interned);
+}
+
 extern iot_data_t * iot_data_alloc_array (void * data, uint32_t length, iot_data_type_t type, iot_data_ownership_t ownership)
 {
-  assert (data && length && (type < IOT_DATA_STRING));
-  iot_data_array_t * array = iot_data_factory_alloc ();
-  array->base.type = IOT_DATA_ARRAY;
+  assert ((data || length == 0u) && (type < IOT_DATA_STRING));
+  iot_data_array_t * array = iot_data_factory_alloc (IOT_DATA_ARRAY);
   array->type = type;
-  array->data = data;
+  array->data = data ? data : array->buff; // Empty array may have no data
   array->length = length;
-  array->size = iot_data_type_size[type] * length;
   array->base.release = (ownership != IOT_DATA_REF);
   if (ownership == IOT_DATA_COPY)
   {
-    array->data = malloc (array->size);
-    memcpy (array->data, data, array->size);
+    uint32_t size = IOT_DATA_ARRAY_SIZE (array);
+    if (size <= IOT_DATA_ARRAY_BUFF_SIZE) // If array small enough save in iot_data_array_t buffer
+    {
+      array->data = array->buff;
+    }
+    else if (array->base.arena)
+    {
+      array->data = iot_data_mem_alloc (&array->base, size);
+    }
+    else if (size <= IOT_DATA_LARGE_BLOCK_SIZE) // If small enough save in smallest block that fits
+    {
+      array->data = iot_data_block_alloc (iot_data_block_class (size));
+      array->base.release_block = true;
+    }
+    else
+    {
+      array->data = malloc (size);
+    }
+    if (size) memcpy (array->data, data, size);
+  }
+  else if ((ownership == IOT_DATA_TAKE) && array->base.arena)
+  {
+    iot_data_arena_take (&array->base, data);
   }
   return (iot_data_t*) array;
 }
@@ -679,7 +1613,7 @@ extern bool iot_data_array_is_of_type (const iot_data_t * array, iot_data_type_t
 extern uint32_t iot_data_array_size (const iot_data_t * array)
 {
   assert (array && (array->type == IOT_DATA_ARRAY));
-  return ((iot_data_array_t*) array)->size;
+  return IOT_DATA_ARRAY_SIZE ((iot_data_array_t*) array);
 }
 
 extern uint32_t iot_data_array_length (const iot_data_t * array)
@@ -782,55 +1716,177 @@ const char * iot_data_string (const iot_data_t * data)
   return ((iot_data_value_t*) data)->value.str;
 }
 
-static iot_data_pair_t * iot_data_map_find (iot_data_map_t * map, const iot_data_t * key)
+static uint32_t iot_data_hash (const iot_data_t * data)
 {
-  iot_data_pair_t * pair = map->head;
-  while (pair)
+  uint32_t hash;
+  switch (data->type)
   {
-    if (iot_data_equal (pair->key, key))
+    case IOT_DATA_STRING:
+    {
+      const iot_data_value_t * val = (const iot_data_value_t*) data;
+      hash = data->interned ? val->hash : iot_hash (val->value.str);
+      break;
+    }
+    case IOT_DATA_ARRAY:
+    {
+      const iot_data_array_t * array = (const iot_data_array_t*) data;
+      const uint8_t * ptr = array->data;
+      hash = 538u;
+      for (uint32_t i = 0; i < IOT_DATA_ARRAY_SIZE (array); i++)
+      {
+        hash = ((hash << 5u) + hash) ^ ptr[i];
+      }
+      break;
+    }
+    default: // Mix all value bits, consistent with iot_data_equal
     {
+      uint64_t val = ((iot_data_value_t*) data)->value.ui64;
+      val ^= val >> 33u;
+      val *= 0xff51afd7ed558ccdULL;
+      val ^= val >> 33u;
+      hash = (uint32_t) val;
       break;
     }
-    pair = (iot_data_pair_t*) pair->base.next;
+  }
+  return hash;
+}
+
+static inline void iot_data_map_index_insert (iot_data_map_index_t * index, iot_data_pair_t * pair)
+{
+  uint32_t i = pair->hash & index->mask;
+  while (index->slots[i]) i = (i + 1u) & index->mask;
+  index->slots[i] = pair;
+}
+
+static void iot_data_map_index_remove (iot_data_map_index_t * index, const iot_data_pair_t * pair)
+{
+  uint32_t i = pair->hash & index->mask;
+  while (index->slots[i] != pair) i = (i + 1u) & index->mask;
+
+  // Backward shift deletion, moves later entries in probe sequence into the freed slot
+
+  uint32_t j = i;
+  while (true)
+  {
+    j = (j + 1u) & index->mask;
+    if (index->slots[j] == NULL) break;
+    uint32_t k = index->slots[j]->hash & index->mask;
+    if ((j > i && (k <= i || k > j)) || (j < i && (k <= i && k > j)))
+    {
+      index->slots[i] = index->slots[j];
+      i = j;
+    }
+  }
+  index->slots[i] = NULL;
+}
+
+static void iot_data_map_index_build (iot_data_map_t * map, uint32_t capacity, bool rehash)
+{
+  iot_data_mem_free (&map->base, map->index);
+  map->index = iot_data_mem_alloc (&map->base, sizeof (iot_data_map_index_t) + capacity * sizeof (iot_data_pair_t*));
+  map->index->mask = capacity - 1u;
+  for (iot_data_pair_t * pair = map->head; pair; pair = (iot_data_pair_t*) pair->base.next)
+  {
+    if (rehash) pair->hash = iot_data_hash (pair->key);
+    iot_data_map_index_insert (map->index, pair);
+  }
+}
+
+static iot_data_pair_t * iot_data_map_find (const iot_data_map_t * map, const iot_data_t * key, uint32_t * hash)
+{
+  iot_data_pair_t * pair;
+  if (map->index)
+  {
+    uint32_t h = iot_data_hash (key);
+    uint32_t i = h & map->index->mask;
+    while ((pair = map->index->slots[i]))
+    {
+      if (pair->hash == h && iot_data_equal (pair->key, key)) break;
+      i = (i + 1u) & map->index->mask;
+    }
+    if (hash) *hash = h;
+  }
+  else
+  {
+    pair = map->head;
+    while (pair)
+    {
+      if (iot_data_equal (pair->key, key)) break;
+      pair = (iot_data_pair_t*) pair->base.next;
+    }
   }
   return pair;
 }
 
-bool iot_data_map_remove (iot_data_t * map, const iot_data_t * key)
+// Find pair with a string key, comparing directly against a C string to avoid allocating a key
+
+static iot_data_pair_t * iot_data_map_find_string (const iot_data_map_t * map, const char * key, const uint32_t * hash)
 {
-  assert (map && (map->type == IOT_DATA_MAP));
   iot_data_pair_t * pair = NULL;
-  if (key)
+  if (map->key_type == IOT_DATA_STRING)
   {
-    iot_data_pair_t * prev = NULL;
-    iot_data_map_t * mp = (iot_data_map_t*) map;
-    pair = mp->head;
-    while (pair)
+    if (map->index)
     {
-      if (iot_data_equal (pair->key, key))
+      uint32_t h = hash ? *hash : iot_hash (key);
+      uint32_t i = h & map->index->mask;
+      while ((pair = map->index->slots[i]))
       {
-        if (pair == mp->head)
-        {
-          mp->head = (iot_data_pair_t *) pair->base.next;
-        }
-        else
-        {
-          prev->base.next = pair->base.next;
-        }
-        if (pair == mp->tail)
-        {
-          mp->tail = (iot_data_pair_t *) (prev ? prev->base.next : NULL);
-        }
-        mp->size--;
-        iot_data_free (pair->key);
-        iot_data_free (pair->value);
-        iot_data_free (&pair->base);
-        break;
+        if (pair->hash == h && strcmp (((iot_data_value_t*) pair->key)->value.str, key) == 0) break;
+        i = (i + 1u) & map->index->mask;
+      }
+    }
+    else
+    {
+      pair = map->head;
+      while (pair)
+      {
+        if (strcmp (((iot_data_value_t*) pair->key)->value.str, key) == 0) break;
+        pair = (iot_data_pair_t*) pair->base.next;
       }
-      prev = pair;
-      pair = (iot_data_pair_t *) pair->base.next;
     }
   }
+  return pair;
+}
+
+static void iot_data_map_remove_pair (iot_data_map_t * map, iot_data_pair_t * pair)
+{
+  iot_data_pair_t * next = (iot_data_pair_t*) pair->base.next;
+  if (pair->prev)
+  {
+    pair->prev->base.next = (iot_data_t*) next;
+  }
+  else
+  {
+    map->head = next;
+  }
+  if (next)
+  {
+    next->prev = pair->prev;
+  }
+  else
+  {
+    map->tail = pair->prev;
+  }
+  if (map->index) iot_data_map_index_remove (map->index, pair);
+  map->size--;
+  if (! map->base.arena)
+  {
+    iot_data_free (pair->key);
+    iot_data_free (pair->value);
+    iot_data_block_free (pair, IOT_DATA_BLOCK_STANDARD);
+  }
+}
+
+bool iot_data_map_remove (iot_data_t * map, const iot_data_t * key)
+{
+  assert (map && (map->type == IOT_DATA_MAP));
+  iot_data_pair_t * pair = NULL;
+  iot_data_lazy_check (map);
+  if (key)
+  {
+    pair = iot_data_map_find ((iot_data_map_t*) map, key, NULL);
+    if (pair) iot_data_map_remove_pair ((iot_data_map_t*) map, pair);
+  }
   return (pair != NULL);
 }
 
@@ -842,14 +1898,15 @@ void iot_data_string_map_add (iot_data_t * map, const char * key, iot_data_t * v
 
 bool iot_data_string_map_remove (iot_data_t * map, const char * key)
 {
-  bool ret = false;
+  assert (map && (map->type == IOT_DATA_MAP));
+  iot_data_pair_t * pair = NULL;
+  iot_data_lazy_check (map);
   if (key)
   {
-    iot_data_t * kdata = iot_data_alloc_string (key, IOT_DATA_REF);
-    ret = iot_data_map_remove (map, kdata);
-    iot_data_free (kdata);
+    pair = iot_data_map_find_string ((iot_data_map_t*) map, key, NULL);
+    if (pair) iot_data_map_remove_pair ((iot_data_map_t*) map, pair);
   }
-  return ret;
+  return (pair != NULL);
 }
 
 void iot_data_map_add (iot_data_t * map, iot_data_t * key, iot_data_t * val)
@@ -859,19 +1916,42 @@ void iot_data_map_add (iot_data_t * map, iot_data_t * key, iot_data_t * val)
   assert (mp && (mp->base.type == IOT_DATA_MAP));
   assert (key && key->type == mp->key_type);
 
-  iot_data_pair_t * pair = iot_data_map_find (mp, key);
+  iot_data_lazy_check (map);
+  uint32_t hash = 0;
+  iot_data_pair_t * pair = iot_data_map_find (mp, key, &hash);
+  iot_data_arena_hold (map, key);
+  iot_data_arena_hold (map, val);
   if (pair)
   {
-    iot_data_free (pair->value);
-    iot_data_free (pair->key);
+    iot_data_release (map, pair->value);
+    iot_data_release (map, pair->key);
   }
   else
   {
-    pair = (iot_data_pair_t*) iot_data_factory_alloc ();
+    pair = map->arena ? iot_data_mem_alloc (map, sizeof (*pair)) : iot_data_block_alloc (IOT_DATA_BLOCK_STANDARD);
+    pair->key = key;
+    pair->hash = hash;
+    pair->prev = mp->tail;
     if (mp->tail) mp->tail->base.next = &pair->base;
     mp->tail = pair;
     if (mp->head == NULL) mp->head = pair;
     mp->size++;
+    if (mp->index)
+    {
+      uint32_t capacity = mp->index->mask + 1u;
+      if ((mp->size * 4u) > (capacity * 3u)) // Keep load factor below 0.75
+      {
+        iot_data_map_index_build (mp, capacity * 2u, false);
+      }
+      else
+      {
+        iot_data_map_index_insert (mp->index, pair);
+      }
+    }
+    else if (mp->size > IOT_DATA_MAP_INDEX_THRESHOLD)
+    {
+      iot_data_map_index_build (mp, IOT_DATA_MAP_INDEX_MIN_SIZE, true);
+    }
   }
   pair->value = val;
   pair->key = key;
@@ -881,6 +1961,7 @@ uint32_t iot_data_map_size (const iot_data_t * map)
 {
   iot_data_map_t * mp = (iot_data_map_t*) map;
   assert (mp && (mp->base.type == IOT_DATA_MAP));
+  iot_data_lazy_check (map);
   return mp->size;
 }
 
@@ -892,7 +1973,8 @@ bool iot_data_map_base64_to_array (iot_data_t * map, const iot_data_t * key)
   assert (mp && (mp->base.type == IOT_DATA_MAP));
   assert (key && key->type == mp->key_type);
 
-  iot_data_pair_t * pair = iot_data_map_find (mp, key);
+  iot_data_lazy_check (map);
+  iot_data_pair_t * pair = iot_data_map_find (mp, key, NULL);
   if (pair && (pair->value->type == IOT_DATA_STRING))
   {
     const char * str = ((iot_data_value_t*) pair->value)->value.str;
@@ -902,686 +1984,2891 @@ bool iot_data_map_base64_to_array (iot_data_t * map, const iot_data_t * key)
 
     if (result)
     {
-      iot_data_free (pair->value);
-      pair->value = array;
+      iot_data_release (map, pair->value);
+      iot_data_arena_hold (map, array);
+      pair->value = array;
+    }
+  }
+  return result;
+}
+
+const iot_data_t * iot_data_map_get (const iot_data_t * map, const iot_data_t * key)
+{
+  iot_data_map_t * mp = (iot_data_map_t*) map;
+  assert (mp && key && (mp->base.type == IOT_DATA_MAP));
+  iot_data_lazy_check (map);
+  iot_data_pair_t * pair = iot_data_map_find (mp, key, NULL);
+  return pair ? pair->value : NULL;
+}
+
+const iot_data_t * iot_data_string_map_get (const iot_data_t * map, const char * key)
+{
+  assert (map && key && (map->type == IOT_DATA_MAP));
+  iot_data_lazy_check (map);
+  iot_data_pair_t * pair = iot_data_map_find_string ((iot_data_map_t*) map, key, NULL);
+  return pair ? pair->value : NULL;
+}
+
+const iot_data_t * iot_data_string_map_get_with_hash (const iot_data_t * map, const char * key, uint32_t hash)
+{
+  assert (map && key && (map->type == IOT_DATA_MAP));
+  iot_data_lazy_check (map);
+  iot_data_pair_t * pair = iot_data_map_find_string ((iot_data_map_t*) map, key, &hash);
+  return pair ? pair->value : NULL;
+}
+
+const char * iot_data_string_map_get_string (const iot_data_t * map, const char * key)
+{
+  const iot_data_t * data = iot_data_string_map_get (map, key);
+  return data ? iot_data_string (data) : NULL;
+}
+
+int64_t iot_data_string_map_get_i64 (const iot_data_t * map, const char * key, int64_t default_val)
+{
+  const iot_data_t * data = iot_data_string_map_get (map, key);
+  return (data && (iot_data_type (data) == IOT_DATA_INT64)) ? iot_data_i64 (data) : default_val;
+}
+
+bool iot_data_string_map_get_bool (const iot_data_t * map, const char * key, bool default_val)
+{
+  const iot_data_t * data = iot_data_string_map_get (map, key);
+  return (data && (iot_data_type (data) == IOT_DATA_BOOL)) ? iot_data_bool (data) : default_val;
+}
+
+double iot_data_string_map_get_f64 (const iot_data_t * map, const char * key, double default_val)
+{
+  const iot_data_t * data = iot_data_string_map_get (map, key);
+  return (data && (iot_data_type (data) == IOT_DATA_FLOAT64)) ? iot_data_f64 (data) : default_val;
+}
+
+const iot_data_t * iot_data_string_map_get_vector (const iot_data_t * map, const char * key)
+{
+  const iot_data_t * data = iot_data_string_map_get (map, key);
+  return ((data && (iot_data_type (data) == IOT_DATA_VECTOR)) ? data : NULL);
+}
+
+const iot_data_t * iot_data_string_map_get_map (const iot_data_t * map, const char * key)
+{
+  const iot_data_t * data = iot_data_string_map_get (map, key);
+  return ((data && (iot_data_type (data) == IOT_DATA_MAP)) ? data : NULL);
+}
+
+iot_data_type_t iot_data_map_key_type (const iot_data_t * map)
+{
+  assert (map);
+  return ((iot_data_map_t*) map)->key_type;
+}
+
+extern bool iot_data_map_key_is_of_type (const iot_data_t * map, iot_data_type_t type)
+{
+  return (map && (map->type == IOT_DATA_MAP) && (((iot_data_map_t*) map)->key_type == type));
+}
+
+void iot_data_vector_add (iot_data_t * vector, uint32_t index, iot_data_t * val)
+{
+  iot_data_vector_t * arr = (iot_data_vector_t*) vector;
+  assert (val && vector && (vector->type == IOT_DATA_VECTOR));
+  iot_data_lazy_check (vector);
+  assert (index < arr->size);
+  iot_data_t * element = arr->values[index];
+  if (element) iot_data_release (vector, element);
+  if (val) iot_data_arena_hold (vector, val);
+  arr->values[index] = val;
+}
+
+const iot_data_t * iot_data_vector_get (const iot_data_t * vector, uint32_t index)
+{
+  iot_data_vector_t * arr = (iot_data_vector_t*) vector;
+  assert (vector && (vector->type == IOT_DATA_VECTOR));
+  iot_data_lazy_check (vector);
+  assert (index < arr->size);
+  return arr->values[index];
+}
+
+void iot_data_vector_resize (iot_data_t * vector, uint32_t size)
+{
+  iot_data_vector_t * vec = (iot_data_vector_t*) vector;
+  assert (vector && (vector->type == IOT_DATA_VECTOR));
+  iot_data_lazy_check (vector);
+  if (size < vec->size)
+  {
+    for (uint32_t i = size; i < vec->size; i++)
+    {
+      if (vec->values[i]) iot_data_release (vector, vec->values[i]);
+      vec->values[i] = NULL;
+    }
+    vec->size = size;
+    if (! vector->arena && ((size * 4u) <= vec->capacity) && (vec->capacity * sizeof (iot_data_t*) > IOT_DATA_SMALL_BLOCK_SIZE)) // Shrink when no more than a quarter used
+    {
+      iot_data_vector_reserve (vec, size * 2u);
+    }
+  }
+  else if (size > vec->capacity) // Grow geometrically
+  {
+    iot_data_vector_reserve (vec, (size > vec->capacity * 2u) ? size : vec->capacity * 2u);
+  }
+  vec->size = size;
+}
+
+uint32_t iot_data_vector_size (const iot_data_t * vector)
+{
+  assert (vector && (vector->type == IOT_DATA_VECTOR));
+  iot_data_lazy_check (vector);
+  return ((iot_data_vector_t*) vector)->size;
+}
+
+void iot_data_map_iter (const iot_data_t * map, iot_data_map_iter_t * iter)
+{
+  assert (iter && map && map->type == IOT_DATA_MAP);
+  iot_data_lazy_check (map);
+  iter->pair = NULL;
+  iter->map = (iot_data_map_t*) map;
+}
+
+bool iot_data_map_iter_next (iot_data_map_iter_t * iter)
+{
+  assert (iter);
+  iter->pair = iter->pair ? (iot_data_pair_t*) iter->pair->base.next : iter->map->head;
+  return (iter->pair != NULL);
+}
+
+const iot_data_t * iot_data_map_iter_key (const iot_data_map_iter_t * iter)
+{
+  assert (iter);
+  return (iter->pair) ? iter->pair->key : NULL;
+}
+
+const iot_data_t * iot_data_map_iter_value (const iot_data_map_iter_t * iter)
+{
+  assert (iter);
+  return (iter->pair) ? iter->pair->value : NULL;
+}
+
+iot_data_t * iot_data_map_iter_replace_value (iot_data_map_iter_t * iter, iot_data_t *value)
+{
+  assert (iter);
+  iot_data_t *res = (iter->pair) ? iter->pair->value : NULL;
+  if (res)
+  {
+    if (iter->map->base.arena && ! res->arena) iot_data_add_ref (res); // Arena retains its reference
+    iot_data_arena_hold (&iter->map->base, value);
+    iter->pair->value = value;
+  }
+  return res;
+}
+
+const char * iot_data_map_iter_string_key (const iot_data_map_iter_t * iter)
+{
+  assert (iter);
+  return (iter->pair) ? iot_data_string (iot_data_map_iter_key (iter)) : NULL;
+}
+
+const char * iot_data_map_iter_string_value (const iot_data_map_iter_t * iter)
+{
+  assert (iter);
+  return (iter->pair) ? iot_data_string (iot_data_map_iter_value (iter)) : NULL;
+}
+
+void iot_data_array_iter (const iot_data_t * array, iot_data_array_iter_t * iter)
+{
+  assert (iter && array && array->type == IOT_DATA_ARRAY);
+  iter->array = (iot_data_array_t*) array;
+  iter->index = 0;
+}
+
+bool iot_data_array_iter_next (iot_data_array_iter_t * iter)
+{
+  assert (iter);
+  iter->index = (iter->index <= iter->array->length) ? iter->index + 1 : 1;
+  return (iter->index <= iter->array->length);
+}
+
+uint32_t iot_data_array_iter_index (const iot_data_array_iter_t * iter)
+{
+  assert (iter);
+  return (iter->index - 1);
+}
+
+const void * iot_data_array_iter_value (const iot_data_array_iter_t * iter)
+{
+  assert (iter);
+  return (iter->index <= iter->array->length) ? ((char*) (iter->array->data) + (iter->index - 1) * iot_data_type_size[iter->array->type]) : NULL;
+}
+
+void iot_data_vector_iter (const iot_data_t * vector, iot_data_vector_iter_t * iter)
+{
+  assert (iter && vector && vector->type == IOT_DATA_VECTOR);
+  iot_data_lazy_check (vector);
+  iter->vector = (iot_data_vector_t*) vector;
+  iter->index = 0;
+}
+
+bool iot_data_vector_iter_next (iot_data_vector_iter_t * iter)
+{
+  assert (iter);
+  iter->index = (iter->index <= iter->vector->size) ? iter->index + 1 : 1;
+  return (iter->index <= iter->vector->size);
+}
+
+uint32_t iot_data_vector_iter_index (const iot_data_vector_iter_t * iter)
+{
+  assert (iter);
+  return (iter->index - 1);
+}
+
+const iot_data_t * iot_data_vector_iter_value (const iot_data_vector_iter_t * iter)
+{
+  assert (iter);
+  return (iter->index <= iter->vector->size) ? iter->vector->values[iter->index - 1] : NULL;
+}
+
+iot_data_t * iot_data_vector_iter_replace_value (iot_data_vector_iter_t * iter, iot_data_t *value)
+{
+  assert (iter);
+  iot_data_t *res = NULL;
+  if (iter->index <= iter->vector->size)
+  {
+    res = iter->vector->values[iter->index - 1];
+    if (iter->vector->base.arena && res && ! res->arena) iot_data_add_ref (res); // Arena retains its reference
+    if (value) iot_data_arena_hold (&iter->vector->base, value);
+    iter->vector->values[iter->index - 1] = value;
+  }
+  return res;
+}
+
+const char * iot_data_vector_iter_string (const iot_data_vector_iter_t * iter)
+{
+  assert (iter);
+  return (iter->index <= iter->vector->size) ? iot_data_string (iter->vector->values[iter->index - 1]) : NULL;
+}
+
+const iot_data_t * iot_data_vector_find (const iot_data_t * vector, iot_data_cmp_fn cmp, const void * arg)
+{
+  const iot_data_t * result = NULL;
+  iot_data_vector_iter_t iter;
+  iot_data_vector_iter (vector, &iter);
+  while (iot_data_vector_iter_next (&iter))
+  {
+    const iot_data_t * val = iot_data_vector_iter_value (&iter);
+    if (cmp (val, arg))
+    {
+      result = val;
+      break;
+    }
+  }
+  return result;
+}
+
+// JSON escape characters for control characters, zero if written as \u00XX
+
+static const char iot_data_json_escapes [0x20] = { 0, 0, 0, 0, 0, 0, 0, 0, 'b', 't', 'n', 0, 'f', 'r' };
+
+static void iot_data_holder_init (iot_string_holder_t * holder, size_t size, iot_data_sink_fn sink, void * arg)
+{
+  holder->str = calloc (1, size);
+  holder->size = size;
+  holder->len = 0;
+  holder->sink = sink;
+  holder->arg = arg;
+  holder->ok = true;
+}
+
+static inline void iot_data_holder_reset (iot_string_holder_t * holder)
+{
+  holder->len = 0;
+  holder->str[0] = '\0';
+}
+
+static void iot_data_holder_flush (iot_string_holder_t * holder)
+{
+  if (holder->len && holder->ok) holder->ok = holder->sink (holder->arg, holder->str, holder->len);
+  iot_data_holder_reset (holder);
+}
+
+// Ensure holder has space for required characters plus terminator, either by writing buffered
+// string to sink or growing the buffer. Growth is geometric so total copying is linear in string size.
+
+static void iot_data_holder_reserve (iot_string_holder_t * holder, size_t required)
+{
+  if ((holder->size - holder->len - 1u) < required)
+  {
+    if (holder->sink) iot_data_holder_flush (holder);
+    if ((holder->size - holder->len - 1u) < required)
+    {
+      size_t inc = holder->size > IOT_JSON_BUFF_DOUBLING_LIMIT ? holder->size / 2u : holder->size;
+      if (inc < required) inc = required;
+      holder->size += inc;
+      holder->str = realloc (holder->str, holder->size);
+    }
+  }
+}
+
+static void iot_data_holder_write (iot_string_holder_t * holder, const char * add, size_t len)
+{
+  while (holder->sink && (len > (holder->size - holder->len - 1u))) // Fill and flush sink buffer
+  {
+    size_t n = holder->size - holder->len - 1u;
+    memcpy (holder->str + holder->len, add, n);
+    holder->len += n;
+    add += n;
+    len -= n;
+    iot_data_holder_flush (holder);
+  }
+  iot_data_holder_reserve (holder, len);
+  memcpy (holder->str + holder->len, add, len);
+  holder->len += len;
+  holder->str[holder->len] = '\0';
+}
+
+static inline void iot_data_holder_putc (iot_string_holder_t * holder, char c)
+{
+  iot_data_holder_reserve (holder, 1u);
+  holder->str[holder->len++] = c;
+  holder->str[holder->len] = '\0';
+}
+
+// Return length of leading run of characters that need no JSON escaping. Scans 16 bytes at a
+// time with SSE2 (x86_64) or NEON (arm64), otherwise 8 bytes at a time within a 64 bit word.
+
+static inline bool iot_data_json_plain (uint8_t c)
+{
+  return (c >= 0x20u && c != '"' && c != '\\');
+}
+
+static size_t iot_data_json_plain_run (const char * str, size_t len)
+{
+  size_t i = 0;
+#if defined (IOT_DATA_SSE2)
+  const __m128i ctrl = _mm_set1_epi8 (0x1f);
+  const __m128i quote = _mm_set1_epi8 ('"');
+  const __m128i bslash = _mm_set1_epi8 ('\\');
+  for (; i + 16u <= len; i += 16u)
+  {
+    __m128i v = _mm_loadu_si128 ((const __m128i*) (str + i));
+    __m128i esc = _mm_or_si128 (_mm_cmpeq_epi8 (_mm_min_epu8 (v, ctrl), v), _mm_or_si128 (_mm_cmpeq_epi8 (v, quote), _mm_cmpeq_epi8 (v, bslash)));
+    int mask = _mm_movemask_epi8 (esc);
+    if (mask) return i + (size_t) __builtin_ctz ((unsigned) mask);
+  }
+#elif defined (IOT_DATA_NEON)
+  const uint8x16_t ctrl = vdupq_n_u8 (0x20u);
+  const uint8x16_t quote = vdupq_n_u8 ('"');
+  const uint8x16_t bslash = vdupq_n_u8 ('\\');
+  for (; i + 16u <= len; i += 16u)
+  {
+    uint8x16_t v = vld1q_u8 ((const uint8_t*) (str + i));
+    uint8x16_t esc = vorrq_u8 (vcltq_u8 (v, ctrl), vorrq_u8 (vceqq_u8 (v, quote), vceqq_u8 (v, bslash)));
+    if (vmaxvq_u8 (esc)) break; // Find character in scalar loop
+  }
+#else
+  const uint64_t ones = UINT64_C (0x0101010101010101);
+  const uint64_t highs = UINT64_C (0x8080808080808080);
+  for (; i + 8u <= len; i += 8u)
+  {
+    uint64_t w;
+    memcpy (&w, str + i, sizeof (w));
+    uint64_t q = w ^ (ones * '"');
+    uint64_t b = w ^ (ones * '\\');
+    if ((((w - ones * 0x20u) & ~w) | ((q - ones) & ~q) | ((b - ones) & ~b)) & highs) break; // Find character in scalar loop
+  }
+#endif
+  while (i < len && iot_data_json_plain ((uint8_t) str[i])) i++;
+  return i;
+}
+
+// Write string with JSON escaping, copying runs of unescaped characters in one go
+
+static void iot_data_holder_write_escaped (iot_string_holder_t * holder, const char * add)
+{
+  static const char * hex = "0123456789abcdef";
+  size_t len = strlen (add);
+  while (len)
+  {
+    size_t run = iot_data_json_plain_run (add, len);
+    if (run)
+    {
+      iot_data_holder_write (holder, add, run);
+      add += run;
+      len -= run;
+    }
+    if (len)
+    {
+      uint8_t c = (uint8_t) *add;
+      char esc [6] = { '\\', (char) c, '0', '0', (c & 0x10u) ? '1' : '0', hex[c & 0x0fu] };
+      size_t esc_len = 2u;
+      if (c < 0x20u)
+      {
+        esc[1] = iot_data_json_escapes[c] ? iot_data_json_escapes[c] : 'u';
+        if (esc[1] == 'u') esc_len = 6u;
+      }
+      iot_data_holder_write (holder, esc, esc_len);
+      add++;
+      len--;
+    }
+  }
+}
+
+static void iot_data_base64_encode (iot_string_holder_t * holder, const iot_data_t * array)
+{
+  size_t in_len = iot_data_array_size (array);
+  const uint8_t * data = iot_data_address (array);
+  size_t seg = holder->sink ? ((holder->size - 1u) / 4u) * 3u : in_len; // Whole base64 quanta fit the sink buffer
+  do
+  {
+    size_t n = (in_len > seg) ? seg : in_len;
+    size_t len = iot_b64_encodesize (n) - 1; /* Allow for string terminator */
+    iot_data_holder_reserve (holder, len);
+    iot_b64_encode (data, n, holder->str + holder->len, holder->size - holder->len);
+    holder->len += len;
+    data += n;
+    in_len -= n;
+  } while (in_len);
+}
+
+// Integer formatting, two digits at a time
+
+static const char iot_data_digit_pairs [] = "00010203040506070809101112131415161718192021222324252627282930313233343536373839404142434445464748495051525354555657585960616263646566676869707172737475767778798081828384858687888990919293949596979899";
+
+static size_t iot_data_utoa (uint64_t val, char * buff)
+{
+  char tmp [20];
+  char * ptr = tmp + sizeof (tmp);
+  while (val >= 100u)
+  {
+    uint32_t i = (uint32_t) (val % 100u) * 2u;
+    val /= 100u;
+    *--ptr = iot_data_digit_pairs[i + 1u];
+    *--ptr = iot_data_digit_pairs[i];
+  }
+  if (val >= 10u)
+  {
+    *--ptr = iot_data_digit_pairs[val * 2u + 1u];
+    *--ptr = iot_data_digit_pairs[val * 2u];
+  }
+  else
+  {
+    *--ptr = (char) ('0' + val);
+  }
+  size_t len = (size_t) (tmp + sizeof (tmp) - ptr);
+  memcpy (buff, ptr, len);
+  return len;
+}
+
+static size_t iot_data_itoa (int64_t val, char * buff)
+{
+  if (val < 0)
+  {
+    *buff = '-';
+    return iot_data_utoa (0u - (uint64_t) val, buff + 1) + 1u;
+  }
+  return iot_data_utoa ((uint64_t) val, buff);
+}
+
+// Shortest round trip floating point formatting using the Grisu2 algorithm (Florian Loitsch,
+// "Printing Floating-Point Numbers Quickly and Accurately with Integers"). Numbers are held
+// as a 64 bit significand and binary exponent (a "do it yourself" floating point number).
+
+typedef struct iot_data_diyfp_t
+{
+  uint64_t f;
+  int e;
+} iot_data_diyfp_t;
+
+// Normalized significands and binary exponents of 10^-348, 10^-340, ... 10^340
+
+static const uint64_t iot_data_cached_powers_f [] =
+{
+  UINT64_C(0xfa8fd5a0081c0288), UINT64_C(0xbaaee17fa23ebf76), UINT64_C(0x8b16fb203055ac76), UINT64_C(0xcf42894a5dce35ea),
+  UINT64_C(0x9a6bb0aa55653b2d), UINT64_C(0xe61acf033d1a45df), UINT64_C(0xab70fe17c79ac6ca), UINT64_C(0xff77b1fcbebcdc4f),
+  UINT64_C(0xbe5691ef416bd60c), UINT64_C(0x8dd01fad907ffc3c), UINT64_C(0xd3515c2831559a83), UINT64_C(0x9d71ac8fada6c9b5),
+  UINT64_C(0xea9c227723ee8bcb), UINT64_C(0xaecc49914078536d), UINT64_C(0x823c12795db6ce57), UINT64_C(0xc21094364dfb5637),
+  UINT64_C(0x9096ea6f3848984f), UINT64_C(0xd77485cb25823ac7), UINT64_C(0xa086cfcd97bf97f4), UINT64_C(0xef340a98172aace5),
+  UINT64_C(0xb23867fb2a35b28e), UINT64_C(0x84c8d4dfd2c63f3b), UINT64_C(0xc5dd44271ad3cdba), UINT64_C(0x936b9fcebb25c996),
+  UINT64_C(0xdbac6c247d62a584), UINT64_C(0xa3ab66580d5fdaf6), UINT64_C(0xf3e2f893dec3f126), UINT64_C(0xb5b5ada8aaff80b8),
+  UINT64_C(0x87625f056c7c4a8b), UINT64_C(0xc9bcff6034c13053), UINT64_C(0x964e858c91ba2655), UINT64_C(0xdff9772470297ebd),
+  UINT64_C(0xa6dfbd9fb8e5b88f), UINT64_C(0xf8a95fcf88747d94), UINT64_C(0xb94470938fa89bcf), UINT64_C(0x8a08f0f8bf0f156b),
+  UINT64_C(0xcdb02555653131b6), UINT64_C(0x993fe2c6d07b7fac), UINT64_C(0xe45c10c42a2b3b06), UINT64_C(0xaa242499697392d3),
+  UINT64_C(0xfd87b5f28300ca0e), UINT64_C(0xbce5086492111aeb), UINT64_C(0x8cbccc096f5088cc), UINT64_C(0xd1b71758e219652c),
+  UINT64_C(0x9c40000000000000), UINT64_C(0xe8d4a51000000000), UINT64_C(0xad78ebc5ac620000), UINT64_C(0x813f3978f8940984),
+  UINT64_C(0xc097ce7bc90715b3), UINT64_C(0x8f7e32ce7bea5c70), UINT64_C(0xd5d238a4abe98068), UINT64_C(0x9f4f2726179a2245),
+  UINT64_C(0xed63a231d4c4fb27), UINT64_C(0xb0de65388cc8ada8), UINT64_C(0x83c7088e1aab65db), UINT64_C(0xc45d1df942711d9a),
+  UINT64_C(0x924d692ca61be758), UINT64_C(0xda01ee641a708dea), UINT64_C(0xa26da3999aef774a), UINT64_C(0xf209787bb47d6b85),
+  UINT64_C(0xb454e4a179dd1877), UINT64_C(0x865b86925b9bc5c2), UINT64_C(0xc83553c5c8965d3d), UINT64_C(0x952ab45cfa97a0b3),
+  UINT64_C(0xde469fbd99a05fe3), UINT64_C(0xa59bc234db398c25), UINT64_C(0xf6c69a72a3989f5c), UINT64_C(0xb7dcbf5354e9bece),
+  UINT64_C(0x88fcf317f22241e2), UINT64_C(0xcc20ce9bd35c78a5), UINT64_C(0x98165af37b2153df), UINT64_C(0xe2a0b5dc971f303a),
+  UINT64_C(0xa8d9d1535ce3b396), UINT64_C(0xfb9b7cd9a4a7443c), UINT64_C(0xbb764c4ca7a44410), UINT64_C(0x8bab8eefb6409c1a),
+  UINT64_C(0xd01fef10a657842c), UINT64_C(0x9b10a4e5e9913129), UINT64_C(0xe7109bfba19c0c9d), UINT64_C(0xac2820d9623bf429),
+  UINT64_C(0x80444b5e7aa7cf85), UINT64_C(0xbf21e44003acdd2d), UINT64_C(0x8e679c2f5e44ff8f), UINT64_C(0xd433179d9c8cb841),
+  UINT64_C(0x9e19db92b4e31ba9), UINT64_C(0xeb96bf6ebadf77d9), UINT64_C(0xaf87023b9bf0ee6b),
+};
+
+static const int16_t iot_data_cached_powers_e [] =
+{
+  -1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007, -980, -954, -927, -901, -874, -847, -821,
+  -794, -768, -741, -715, -688, -661, -635, -608, -582, -555, -529, -502, -475, -449, -422, -396,
+  -369, -343, -316, -289, -263, -236, -210, -183, -157, -130, -103, -77, -50, -24, 3, 30,
+  56, 83, 109, 136, 162, 189, 216, 242, 269, 295, 322, 348, 375, 402, 428, 455,
+  481, 508, 534, 561, 588, 614, 641, 667, 694, 720, 747, 774, 800, 827, 853, 880,
+  907, 933, 960, 986, 1013, 1039, 1066,
+};
+
+static const uint64_t iot_data_pow10 [] =
+{
+  1u, 10u, 100u, 1000u, 10000u, 100000u, 1000000u, 10000000u, 100000000u, 1000000000u, UINT64_C (10000000000),
+  UINT64_C (100000000000), UINT64_C (1000000000000), UINT64_C (10000000000000), UINT64_C (100000000000000),
+  UINT64_C (1000000000000000), UINT64_C (10000000000000000), UINT64_C (100000000000000000),
+  UINT64_C (1000000000000000000), UINT64_C (10000000000000000000)
+};
+
+static inline iot_data_diyfp_t iot_data_diyfp (uint64_t f, int e)
+{
+  iot_data_diyfp_t fp = { f, e };
+  return fp;
+}
+
+static iot_data_diyfp_t iot_data_diyfp_normalize (iot_data_diyfp_t x)
+{
+  while (! (x.f & (UINT64_C (1) << 63)))
+  {
+    x.f <<= 1;
+    x.e--;
+  }
+  return x;
+}
+
+// Multiply, keeping the rounded upper 64 bits of the 128 bit product
+
+static iot_data_diyfp_t iot_data_diyfp_mul (iot_data_diyfp_t x, iot_data_diyfp_t y)
+{
+  const uint64_t mask = UINT32_MAX;
+  uint64_t a = x.f >> 32;
+  uint64_t b = x.f & mask;
+  uint64_t c = y.f >> 32;
+  uint64_t d = y.f & mask;
+  uint64_t bc = b * c;
+  uint64_t ad = a * d;
+  uint64_t tmp = ((b * d) >> 32) + (ad & mask) + (bc & mask) + (UINT64_C (1) << 31);
+  return iot_data_diyfp (a * c + (ad >> 32) + (bc >> 32) + (tmp >> 32), x.e + y.e + 64);
+}
+
+// Get cached power of ten c such that binary exponent of c * 2^e is in the range [-60, -32]
+
+static iot_data_diyfp_t iot_data_cached_power (int e, int * k)
+{
+  double dk = (-61 - e) * 0.30102999566398114 + 347; // log10 (2)
+  int ik = (int) dk;
+  if (dk - ik > 0.0) ik++;
+  uint32_t index = (uint32_t) ((ik >> 3) + 1);
+  *k = -(-348 + (int) (index << 3));
+  return iot_data_diyfp (iot_data_cached_powers_f[index], iot_data_cached_powers_e[index]);
+}
+
+static void iot_data_grisu_round (char * buff, int len, uint64_t delta, uint64_t rest, uint64_t ten_kappa, uint64_t wp_w)
+{
+  while ((rest < wp_w) && (delta - rest >= ten_kappa) && ((rest + ten_kappa < wp_w) || (wp_w - rest > rest + ten_kappa - wp_w)))
+  {
+    buff[len - 1]--;
+    rest += ten_kappa;
+  }
+}
+
+// Generate shortest digits of a number in the range (mm, mp), w being the closest approximation
+
+static int iot_data_grisu_digits (iot_data_diyfp_t w, iot_data_diyfp_t mp, uint64_t delta, char * buff, int * k)
+{
+  iot_data_diyfp_t one = iot_data_diyfp (UINT64_C (1) << -mp.e, mp.e);
+  uint64_t wp_w = mp.f - w.f;
+  uint32_t p1 = (uint32_t) (mp.f >> -one.e);
+  uint64_t p2 = mp.f & (one.f - 1u);
+  int kappa = 1;
+  int len = 0;
+  while (kappa < 10 && p1 >= iot_data_pow10[kappa]) kappa++;
+  while (kappa > 0)
+  {
+    uint32_t d = (uint32_t) (p1 / iot_data_pow10[kappa - 1]);
+    p1 %= (uint32_t) iot_data_pow10[kappa - 1];
+    if (d || len) buff[len++] = (char) ('0' + d);
+    kappa--;
+    uint64_t tmp = ((uint64_t) p1 << -one.e) + p2;
+    if (tmp <= delta)
+    {
+      *k += kappa;
+      iot_data_grisu_round (buff, len, delta, tmp, iot_data_pow10[kappa] << -one.e, wp_w);
+      return len;
+    }
+  }
+  while (true)
+  {
+    p2 *= 10u;
+    delta *= 10u;
+    char d = (char) (p2 >> -one.e);
+    if (d || len) buff[len++] = (char) ('0' + d);
+    p2 &= one.f - 1u;
+    kappa--;
+    if (p2 < delta)
+    {
+      *k += kappa;
+      iot_data_grisu_round (buff, len, delta, p2, one.f, wp_w * ((-kappa < 20) ? iot_data_pow10[-kappa] : 0u));
+      return len;
+    }
+  }
+}
+
+// Generate shortest digits of f * 2^e, for a floating point type with the given hidden bit.
+// Returns the number of digits, the value being the digits * 10^k.
+
+static int iot_data_grisu2 (uint64_t f, int e, uint64_t hidden, char * buff, int * k)
+{
+  iot_data_diyfp_t mp = iot_data_diyfp_normalize (iot_data_diyfp ((f << 1) + 1u, e - 1));
+  iot_data_diyfp_t mm = (f == hidden) ? iot_data_diyfp ((f << 2) - 1u, e - 2) : iot_data_diyfp ((f << 1) - 1u, e - 1);
+  mm.f <<= mm.e - mp.e;
+  mm.e = mp.e;
+  iot_data_diyfp_t c = iot_data_cached_power (mp.e, k);
+  iot_data_diyfp_t w = iot_data_diyfp_mul (iot_data_diyfp_normalize (iot_data_diyfp (f, e)), c);
+  mp = iot_data_diyfp_mul (mp, c);
+  mm = iot_data_diyfp_mul (mm, c);
+  mm.f++;
+  mp.f--;
+  return iot_data_grisu_digits (w, mp, mp.f - mm.f, buff, k);
+}
+
+// Format digits * 10^k in place, as an integer or decimal if not too large or small, otherwise
+// in exponent notation. Always includes a decimal point or exponent so is read back as floating point.
+
+static size_t iot_data_grisu_format (char * buff, int len, int k)
+{
+  int kk = len + k; // 10^(kk-1) <= value < 10^kk
+  if (k >= 0 && kk <= 21) // 1234e7 -> 12340000000.0
+  {
+    memset (buff + len, '0', (size_t) k);
+    buff[kk] = '.';
+    buff[kk + 1] = '0';
+    return (size_t) kk + 2u;
+  }
+  if (kk > 0 && kk <= 21) // 1234e-2 -> 12.34
+  {
+    memmove (buff + kk + 1, buff + kk, (size_t) (len - kk));
+    buff[kk] = '.';
+    return (size_t) len + 1u;
+  }
+  if (kk > -6 && kk <= 0) // 1234e-6 -> 0.001234
+  {
+    int offset = 2 - kk;
+    memmove (buff + offset, buff, (size_t) len);
+    buff[0] = '0';
+    buff[1] = '.';
+    memset (buff + 2, '0', (size_t) (offset - 2));
+    return (size_t) (len + offset);
+  }
+  if (len == 1) // 1e30
+  {
+    buff[1] = 'e';
+    return iot_data_itoa (kk - 1, buff + 2) + 2u;
+  }
+  memmove (buff + 2, buff + 1, (size_t) (len - 1)); // 1234e30 -> 1.234e33
+  buff[1] = '.';
+  buff[len + 1] = 'e';
+  return iot_data_itoa (kk - 1, buff + len + 2) + (size_t) len + 2u;
+}
+
+static size_t iot_data_ftoa (uint64_t sig, int exp, bool neg, uint32_t sig_bits, int bias, int max_exp, char * buff)
+{
+  char * ptr = buff;
+  uint64_t hidden = UINT64_C (1) << sig_bits;
+  int k;
+  if (neg) *ptr++ = '-';
+  if (exp == max_exp)
+  {
+    strcpy (ptr, sig ? "nan" : "inf");
+    return (size_t) (ptr - buff) + 3u;
+  }
+  if (exp == 0 && sig == 0)
+  {
+    strcpy (ptr, "0.0");
+    return (size_t) (ptr - buff) + 3u;
+  }
+  int len = (exp == 0) ? iot_data_grisu2 (sig, 1 - bias, hidden, ptr, &k) : iot_data_grisu2 (sig | hidden, exp - bias, hidden, ptr, &k);
+  return (size_t) (ptr - buff) + iot_data_grisu_format (ptr, len, k);
+}
+
+static size_t iot_data_f64toa (double val, char * buff)
+{
+  uint64_t bits;
+  memcpy (&bits, &val, sizeof (bits));
+  return iot_data_ftoa (bits & ((UINT64_C (1) << 52) - 1u), (int) ((bits >> 52) & 0x7ffu), (bits >> 63) != 0, 52u, 1075, 0x7ff, buff);
+}
+
+static size_t iot_data_f32toa (float val, char * buff)
+{
+  uint32_t bits;
+  memcpy (&bits, &val, sizeof (bits));
+  return iot_data_ftoa (bits & ((1u << 23) - 1u), (int) ((bits >> 23) & 0xffu), (bits >> 31) != 0, 23u, 150, 0xff, buff);
+}
+
+static void iot_data_dump_raw (iot_string_holder_t * holder, const iot_data_t * data)
+{
+  iot_data_holder_reserve (holder, IOT_VAL_BUFF_SIZE);
+  char * buff = holder->str + holder->len;
+  size_t len;
+
+  switch (data->type)
+  {
+    case IOT_DATA_INT8: len = iot_data_itoa (iot_data_i8 (data), buff); break;
+    case IOT_DATA_UINT8: len = iot_data_utoa (iot_data_ui8 (data), buff); break;
+    case IOT_DATA_INT16: len = iot_data_itoa (iot_data_i16 (data), buff); break;
+    case IOT_DATA_UINT16: len = iot_data_utoa (iot_data_ui16 (data), buff); break;
+    case IOT_DATA_INT32: len = iot_data_itoa (iot_data_i32 (data), buff); break;
+    case IOT_DATA_UINT32: len = iot_data_utoa (iot_data_ui32 (data), buff); break;
+    case IOT_DATA_INT64: len = iot_data_itoa (iot_data_i64 (data), buff); break;
+    case IOT_DATA_UINT64: len = iot_data_utoa (iot_data_ui64 (data), buff); break;
+    case IOT_DATA_FLOAT32: len = iot_data_f32toa (iot_data_f32 (data), buff); break;
+    case IOT_DATA_FLOAT64: len = iot_data_f64toa (iot_data_f64 (data), buff); break;
+    default:
+    {
+      len = iot_data_bool (data) ? 4u : 5u;
+      memcpy (buff, iot_data_bool (data) ? "true" : "false", len);
+      break;
+    }
+  }
+  holder->len += len;
+  holder->str[holder->len] = '\0';
+}
+
+static void iot_data_dump (iot_string_holder_t * holder, const iot_data_t * data)
+{
+  if (data->lazy) // Unbuilt map or vector written as the original json, other than null which is built as a string
+  {
+    const iot_data_lazy_t * lazy = iot_data_lazy_of (data);
+    const iot_data_lazy_doc_t * doc = lazy->doc;
+    const iot_json_tok_t * tok = &doc->tokens[lazy->token];
+    const char * pos = doc->json + tok->start;
+    for (uint32_t i = lazy->token + 1u; i < doc->next[lazy->token]; i++)
+    {
+      const char * str = doc->json + doc->tokens[i].start;
+      if (doc->tokens[i].type == IOT_JSON_PRIMITIVE && *str == 'n')
+      {
+        iot_data_holder_write (holder, pos, (size_t) (str - pos));
+        iot_data_holder_write (holder, "\"null\"", 6u);
+        pos = str + 4;
+      }
+    }
+    iot_data_holder_write (holder, pos, (size_t) (doc->json + tok->end - pos));
+    return;
+  }
+  switch (data->type)
+  {
+    case IOT_DATA_STRING:
+    {
+      iot_data_holder_putc (holder, '"');
+      iot_data_holder_write_escaped (holder, iot_data_string (data));
+      iot_data_holder_putc (holder, '"');
+      break;
+    }
+    case IOT_DATA_ARRAY:
+    {
+      iot_data_holder_putc (holder, '"');
+      iot_data_base64_encode (holder, data);
+      iot_data_holder_putc (holder, '"');
+      break;
+    }
+    case IOT_DATA_MAP:
+    {
+      iot_data_map_iter_t iter;
+      iot_data_map_iter (data, &iter);
+      iot_data_holder_putc (holder, '{');
+      while (iot_data_map_iter_next (&iter))
+      {
+        const iot_data_t * key = iot_data_map_iter_key (&iter);
+        const iot_data_t * value = iot_data_map_iter_value (&iter);
+        if (iot_data_type (key) != IOT_DATA_STRING) iot_data_holder_putc (holder, '"');
+        iot_data_dump (holder, key);
+        if (iot_data_type (key) != IOT_DATA_STRING) iot_data_holder_putc (holder, '"');
+        iot_data_holder_putc (holder, ':');
+        iot_data_dump (holder, value);
+        if (iter.pair->base.next)
+        {
+          iot_data_holder_putc (holder, ',');
+        }
+      }
+      iot_data_holder_putc (holder, '}');
+      break;
+    }
+    case IOT_DATA_VECTOR:
+    {
+      iot_data_vector_iter_t iter;
+      iot_data_vector_iter (data, &iter);
+      iot_data_holder_putc (holder, '[');
+      while (iot_data_vector_iter_next (&iter))
+      {
+        const iot_data_t * value = iot_data_vector_iter_value (&iter);
+        iot_data_dump (holder, value);
+        if (iter.index < iter.vector->size)
+        {
+          iot_data_holder_putc (holder, ',');
+        }
+      }
+      iot_data_holder_putc (holder, ']');
+      break;
+    }
+    default: iot_data_dump_raw (holder, data);
+  }
+}
+
+char * iot_data_to_json (const iot_data_t * data)
+{
+  return iot_data_to_json_with_size (data, IOT_JSON_BUFF_SIZE);
+}
+
+char * iot_data_to_json_with_size (const iot_data_t * data, uint32_t size)
+{
+  iot_string_holder_t holder;
+  assert (data && size > 0);
+  iot_data_holder_init (&holder, size, NULL, NULL);
+  iot_data_dump (&holder, data);
+  return holder.str;
+}
+
+bool iot_data_to_json_sink (const iot_data_t * data, iot_data_sink_fn sink, void * arg)
+{
+  iot_string_holder_t holder;
+  assert (data && sink);
+  iot_data_holder_init (&holder, IOT_JSON_SINK_BUFF_SIZE, sink, arg);
+  iot_data_dump (&holder, data);
+  iot_data_holder_flush (&holder);
+  free (holder.str);
+  return holder.ok;
+}
+
+// JSON to data conversion, building data from JSON parser events. Strings are copied straight into string
+// storage and numbers parsed in place. Containers are added to their parent once complete and each complete
+// top level value is passed to the builder function or, if there is none, kept as the result and parsing stopped.
+// If a typecode is given values are decoded as the typecode types, and arrays accumulated in an element buffer,
+// with parsing stopped at the first value not matching the typecode.
+
+typedef struct iot_data_json_frame_t
+{
+  iot_data_t * container;             // Map or vector being built, NULL if building an array
+  iot_data_t * key;                   // Map key awaiting its value
+  const iot_typecode_t * element;     // Element typecode, NULL if any type
+  uint8_t * elements;                 // Array element buffer
+  uint32_t size;                      // Vector or array size
+  uint32_t capacity;                  // Array element buffer capacity
+  bool packing;                       // Whether packing numbers (as int64 or double) into an array
+  bool real;                          // Whether packed numbers are floating point
+} iot_data_json_frame_t;
+
+typedef struct iot_data_json_builder_t
+{
+  iot_data_json_fn fn;                // Function called with each complete top level value, can be NULL
+  void * arg;                         // Function argument
+  const iot_typecode_t * typecode;    // Top level value typecode, NULL if any type
+  const iot_data_json_options_t * options; // Parse options, NULL for defaults
+  iot_data_t * document;              // Copy of json referenced by string views, if any
+  size_t length;                      // Json length
+  iot_data_t * result;                // First complete top level value, if no function
+  iot_data_json_frame_t * stack;      // Open containers
+  uint32_t depth;                     // Number of open containers
+  uint32_t capacity;                  // Container stack capacity
+  bool invalid;                       // Whether a value did not match the typecode
+} iot_data_json_builder_t;
+
+struct iot_data_json_parser_t
+{
+  iot_data_json_builder_t builder;    // Data builder
+  iot_json_sax_t * sax;               // JSON event parser
+};
+
+static iot_data_t * iot_data_json_string (const char * str, size_t len)
+{
+  iot_data_value_t * data = iot_data_value_alloc (IOT_DATA_STRING, IOT_DATA_COPY);
+  char * copy = iot_data_string_storage (data, len);
+  memcpy (copy, str, len);
+  copy[len] = '\0';
+  return (iot_data_t*) data;
+}
+
+// Parse number text as a double if it has a decimal point or exponent, otherwise as a 64 bit integer
+
+static bool iot_data_json_parse_number (const char * str, size_t len, iot_data_union_t * val)
+{
+  // Fast path for decimal integers of up to 18 digits
+
+  const char * end = str + len;
+  const char * ptr = str + ((*str == '-') ? 1 : 0);
+  if (end > ptr && end - ptr <= 18 && (*ptr != '0' || end - ptr == 1))
+  {
+    int64_t i = 0;
+    while (ptr < end && *ptr >= '0' && *ptr <= '9') i = i * 10 + (*ptr++ - '0');
+    if (ptr == end)
+    {
+      val->i64 = (*str == '-') ? -i : i;
+      return false;
+    }
+  }
+
+  // Floating point and other integer forms (hex, octal, overflow) parsed from a NUL terminated copy
+
+  char buff [IOT_JSON_NUMBER_BUFF_SIZE];
+  char * num = (len < sizeof (buff)) ? buff : malloc (len + 1u);
+  memcpy (num, str, len);
+  num[len] = '\0';
+  bool real = (strpbrk (num, ".eE") != NULL);
+  if (real)
+  {
+    val->f64 = strtod (num, NULL);
+  }
+  else
+  {
+    val->i64 = strtol (num, NULL, 0);
+  }
+  if (num != buff) free (num);
+  return real;
+}
+
+// String views are used for unescaped quoted strings in the json copy (so terminated in place, replacing the
+// closing quote) that are too long to be held in the string data itself
+
+static iot_data_t * iot_data_json_string_data (iot_data_json_builder_t * builder, const char * str, size_t len)
+{
+  if (builder->document && len >= IOT_DATA_VALUE_BUFF_SIZE)
+  {
+    char * doc = ((iot_data_value_t*) builder->document)->value.str;
+    if (str > doc && str < doc + builder->length && str[len] == '"')
+    {
+      doc[str + len - doc] = '\0';
+      return iot_data_string_view (builder->document, str);
+    }
+  }
+  return iot_data_json_string (str, len);
+}
+
+static iot_data_t * iot_data_json_number (const char * str, size_t len)
+{
+  iot_data_union_t val;
+  return iot_data_json_parse_number (str, len, &val) ? iot_data_alloc_f64 (val.f64) : iot_data_alloc_i64 (val.i64);
+}
+
+static const int64_t iot_data_int_mins [] = { INT8_MIN, 0, INT16_MIN, 0, INT32_MIN, 0, INT64_MIN, 0 };
+static const uint64_t iot_data_int_maxs [] = { INT8_MAX, UINT8_MAX, INT16_MAX, UINT16_MAX, INT32_MAX, UINT32_MAX, INT64_MAX, UINT64_MAX };
+
+// Convert number text to a value of a numeric type, failing if not wholly a number or out of range for the type
+
+static bool iot_data_json_convert (const char * str, size_t len, iot_data_type_t type, iot_data_union_t * val)
+{
+  char num [IOT_JSON_NUMBER_BUFF_SIZE];
+  char * end;
+  if (len == 0u || len >= sizeof (num) || type > IOT_DATA_FLOAT64) return false;
+  memcpy (num, str, len);
+  num[len] = '\0';
+  errno = 0;
+  val->ui64 = 0u; // Clear unused value bytes, as compared and hashed
+  if (type >= IOT_DATA_FLOAT32)
+  {
+    double d = strtod (num, &end);
+    if (*end || errno || (type == IOT_DATA_FLOAT32 && (d > FLT_MAX || d < -FLT_MAX))) return false;
+    if (type == IOT_DATA_FLOAT32) val->f32 = (float) d; else val->f64 = d;
+    return true;
+  }
+  if (iot_data_int_mins[type] < 0) // Signed integer types
+  {
+    long long i = strtoll (num, &end, 0);
+    if (*end || errno || i < iot_data_int_mins[type] || i > (int64_t) iot_data_int_maxs[type]) return false;
+    switch (type)
+    {
+      case IOT_DATA_INT8: val->i8 = (int8_t) i; break;
+      case IOT_DATA_INT16: val->i16 = (int16_t) i; break;
+      case IOT_DATA_INT32: val->i32 = (int32_t) i; break;
+      default: val->i64 = (int64_t) i; break;
+    }
+  }
+  else
+  {
+    unsigned long long u = strtoull (num, &end, 0);
+    if (*end || errno || *num == '-' || u > iot_data_int_maxs[type]) return false;
+    switch (type)
+    {
+      case IOT_DATA_UINT8: val->ui8 = (uint8_t) u; break;
+      case IOT_DATA_UINT16: val->ui16 = (uint16_t) u; break;
+      case IOT_DATA_UINT32: val->ui32 = (uint32_t) u; break;
+      default: val->ui64 = (uint64_t) u; break;
+    }
+  }
+  return true;
+}
+
+static inline const iot_typecode_t * iot_data_json_expected (const iot_data_json_builder_t * builder)
+{
+  return builder->depth ? builder->stack[builder->depth - 1u].element : builder->typecode;
+}
+
+static bool iot_data_json_invalid (iot_data_json_builder_t * builder)
+{
+  builder->invalid = true;
+  return false;
+}
+
+static bool iot_data_json_element (iot_data_json_builder_t * builder, iot_data_t * data)
+{
+  if (builder->depth == 0u)
+  {
+    if (builder->fn == NULL)
+    {
+      builder->result = data;
+      return false;
+    }
+    (builder->fn) (builder->arg, data);
+    return true;
+  }
+  iot_data_json_frame_t * frame = &builder->stack[builder->depth - 1u];
+  if (frame->key)
+  {
+    iot_data_map_add (frame->container, frame->key, data);
+    frame->key = NULL;
+  }
+  else
+  {
+    iot_data_vector_resize (frame->container, frame->size + 1u);
+    iot_data_vector_add (frame->container, frame->size++, data);
+  }
+  return true;
+}
+
+static void iot_data_json_append (iot_data_json_frame_t * frame, const iot_data_union_t * val, uint32_t size)
+{
+  if (frame->size == frame->capacity)
+  {
+    frame->capacity = frame->capacity ? frame->capacity * 2u : IOT_JSON_ARRAY_MIN_SIZE;
+    frame->elements = realloc (frame->elements, (size_t) frame->capacity * size);
+  }
+  memcpy (frame->elements + (size_t) frame->size++ * size, val, size);
+}
+
+// Revert an array being packed to a vector of the numbers so far
+
+static void iot_data_json_unpack (iot_data_json_frame_t * frame)
+{
+  const iot_data_union_t * vals = (const iot_data_union_t*) frame->elements;
+  frame->container = iot_data_alloc_vector (frame->size);
+  for (uint32_t i = 0; i < frame->size; i++)
+  {
+    iot_data_vector_add (frame->container, i, frame->real ? iot_data_alloc_f64 (vals[i].f64) : iot_data_alloc_i64 (vals[i].i64));
+  }
+  free (frame->elements);
+  frame->elements = NULL;
+  frame->capacity = 0u;
+  frame->packing = false;
+}
+
+// Any value other than a number reverts an array being packed to a vector
+
+static inline void iot_data_json_not_number (iot_data_json_builder_t * builder)
+{
+  if (builder->depth && builder->stack[builder->depth - 1u].packing) iot_data_json_unpack (&builder->stack[builder->depth - 1u]);
+}
+
+static void iot_data_json_store (uint8_t * dst, iot_data_type_t type, const iot_data_union_t * src, bool real)
+{
+  iot_data_union_t val;
+  switch (type)
+  {
+    case IOT_DATA_INT8: val.i8 = (int8_t) src->i64; break;
+    case IOT_DATA_UINT8: val.ui8 = (uint8_t) src->i64; break;
+    case IOT_DATA_INT16: val.i16 = (int16_t) src->i64; break;
+    case IOT_DATA_UINT16: val.ui16 = (uint16_t) src->i64; break;
+    case IOT_DATA_INT32: val.i32 = (int32_t) src->i64; break;
+    case IOT_DATA_UINT32: val.ui32 = (uint32_t) src->i64; break;
+    case IOT_DATA_FLOAT32: val.f32 = real ? (float) src->f64 : (float) src->i64; break;
+    case IOT_DATA_FLOAT64: val.f64 = real ? src->f64 : (double) src->i64; break;
+    default: val.i64 = src->i64; break;
+  }
+  memcpy (dst, &val, iot_data_type_size[type]);
+}
+
+// Convert packed numbers in place to the array type if given, otherwise to the narrowest type holding them all.
+// Fails if the numbers do not fit the given type.
+
+static bool iot_data_json_pack (iot_data_json_frame_t * frame, const iot_typecode_t * array_type, iot_data_type_t * type)
+{
+  const iot_data_union_t * vals = (const iot_data_union_t*) frame->elements;
+  int64_t min = INT64_MAX;
+  int64_t max = INT64_MIN;
+  bool float32 = true;
+  for (uint32_t i = 0; i < frame->size; i++)
+  {
+    if (frame->real)
+    {
+      double d = vals[i].f64;
+      if (array_type ? (d > FLT_MAX || d < -FLT_MAX) : ((double) (float) d != d)) float32 = false;
+    }
+    else
+    {
+      if (vals[i].i64 < min) min = vals[i].i64;
+      if (vals[i].i64 > max) max = vals[i].i64;
+    }
+  }
+  if (array_type)
+  {
+    *type = array_type->element_type->type;
+    if (*type == IOT_DATA_FLOAT32 && ! float32) return false;
+    if (*type < IOT_DATA_FLOAT32 && (frame->real || min < iot_data_int_mins[*type] || (max > 0 && (uint64_t) max > iot_data_int_maxs[*type]))) return false;
+    if (*type > IOT_DATA_FLOAT64) return false;
+  }
+  else if (frame->real)
+  {
+    *type = float32 ? IOT_DATA_FLOAT32 : IOT_DATA_FLOAT64;
+  }
+  else if (min >= 0)
+  {
+    *type = (max <= UINT8_MAX) ? IOT_DATA_UINT8 : (max <= UINT16_MAX) ? IOT_DATA_UINT16 : (max <= UINT32_MAX) ? IOT_DATA_UINT32 : IOT_DATA_INT64;
+  }
+  else
+  {
+    *type = (min >= INT8_MIN && max <= INT8_MAX) ? IOT_DATA_INT8 : (min >= INT16_MIN && max <= INT16_MAX) ? IOT_DATA_INT16 : (min >= INT32_MIN && max <= INT32_MAX) ? IOT_DATA_INT32 : IOT_DATA_INT64;
+  }
+  uint32_t size = iot_data_type_size[*type];
+  for (uint32_t i = 0; i < frame->size; i++) // Narrowed elements never overwrite unconverted numbers
+  {
+    iot_data_union_t val = vals[i];
+    iot_data_json_store (frame->elements + (size_t) i * size, *type, &val, frame->real);
+  }
+  return true;
+}
+
+// Add a typed value, either to the array being built or as a new data value
+
+static bool iot_data_json_typed_element (iot_data_json_builder_t * builder, iot_data_type_t type, const iot_data_union_t * val)
+{
+  iot_data_json_frame_t * frame = builder->depth ? &builder->stack[builder->depth - 1u] : NULL;
+  if (frame && frame->container == NULL)
+  {
+    iot_data_json_append (frame, val, iot_data_type_size[type]);
+    return true;
+  }
+  iot_data_value_t * data = iot_data_value_alloc (type, false);
+  data->value = *val;
+  return iot_data_json_element (builder, (iot_data_t*) data);
+}
+
+static bool iot_data_json_begin (iot_data_json_builder_t * builder, iot_data_t * container, const iot_typecode_t * element)
+{
+  if (builder->depth == builder->capacity)
+  {
+    builder->capacity = builder->capacity ? builder->capacity * 2u : 8u;
+    builder->stack = realloc (builder->stack, builder->capacity * sizeof (*builder->stack));
+  }
+  iot_data_json_frame_t * frame = &builder->stack[builder->depth++];
+  frame->container = container;
+  frame->key = NULL;
+  frame->element = element;
+  frame->elements = NULL;
+  frame->size = 0u;
+  frame->capacity = 0u;
+  frame->packing = false;
+  frame->real = false;
+  return true;
+}
+
+static bool iot_data_json_object_begin (void * arg)
+{
+  iot_data_json_builder_t * builder = (iot_data_json_builder_t*) arg;
+  iot_data_json_not_number (builder);
+  const iot_typecode_t * tc = iot_data_json_expected (builder);
+  if (tc == NULL) return iot_data_json_begin (builder, iot_data_alloc_map (IOT_DATA_STRING), NULL);
+  if (tc->type != IOT_DATA_MAP) return iot_data_json_invalid (builder);
+  return iot_data_json_begin (builder, iot_data_alloc_map (tc->key_type), tc->element_type);
+}
+
+static bool iot_data_json_array_begin (void * arg)
+{
+  iot_data_json_builder_t * builder = (iot_data_json_builder_t*) arg;
+  iot_data_json_not_number (builder);
+  const iot_typecode_t * tc = iot_data_json_expected (builder);
+  if (tc == NULL && builder->options && builder->options->arrays)
+  {
+    iot_data_json_begin (builder, NULL, NULL);
+    builder->stack[builder->depth - 1u].packing = true;
+    return true;
+  }
+  if (tc == NULL) return iot_data_json_begin (builder, iot_data_alloc_vector (0), NULL);
+  if (tc->type == IOT_DATA_ARRAY) return iot_data_json_begin (builder, NULL, tc->element_type);
+  if (tc->type != IOT_DATA_VECTOR) return iot_data_json_invalid (builder);
+  return iot_data_json_begin (builder, iot_data_alloc_vector (0), tc->element_type);
+}
+
+static bool iot_data_json_end (void * arg)
+{
+  iot_data_json_builder_t * builder = (iot_data_json_builder_t*) arg;
+  iot_data_json_frame_t * frame = &builder->stack[builder->depth - 1u];
+  iot_data_type_t type = frame->element ? frame->element->type : IOT_DATA_INT64;
+  const iot_typecode_t * array_type = frame->packing ? builder->options->array_type : NULL;
+  if (frame->packing && ((frame->size == 0u && ! array_type) || ! iot_data_json_pack (frame, array_type, &type))) // Empty array only packed to a given type
+  {
+    iot_data_json_unpack (frame);
+  }
+  if (frame->container == NULL) // Array, moving small arrays into the array data or a cache block
+  {
+    uint32_t size = frame->size * iot_data_type_size[type];
+    if (size <= IOT_DATA_LARGE_BLOCK_SIZE) // Includes empty array, with no elements
+    {
+      frame->container = iot_data_alloc_array (frame->elements, frame->size, type, IOT_DATA_COPY);
+      free (frame->elements);
+    }
+    else
+    {
+      frame->container = iot_data_alloc_array (realloc (frame->elements, size), frame->size, type, IOT_DATA_TAKE);
+    }
+    frame->elements = NULL;
+  }
+  builder->depth--;
+  return iot_data_json_element (builder, frame->container);
+}
+
+static bool iot_data_json_key (void * arg, const char * str, size_t len)
+{
+  iot_data_json_builder_t * builder = (iot_data_json_builder_t*) arg;
+  iot_data_json_frame_t * frame = &builder->stack[builder->depth - 1u];
+  iot_data_type_t type = ((iot_data_map_t*) frame->container)->key_type;
+  iot_data_union_t val;
+  if (type == IOT_DATA_STRING)
+  {
+    if (memchr (str, '\0', len)) return iot_data_json_invalid (builder);
+    frame->key = iot_data_json_string_data (builder, str, len);
+  }
+  else if (type == IOT_DATA_BOOL && (len == 4u || len == 5u) && (strncmp (str, "true", len) == 0 || strncmp (str, "false", len) == 0))
+  {
+    frame->key = iot_data_alloc_bool (*str == 't');
+  }
+  else if (iot_data_json_convert (str, len, type, &val))
+  {
+    iot_data_value_t * key = iot_data_value_alloc (type, false);
+    key->value = val;
+    frame->key = (iot_data_t*) key;
+  }
+  else
+  {
+    return iot_data_json_invalid (builder);
+  }
+  return true;
+}
+
+static bool iot_data_json_string_value (void * arg, const char * str, size_t len)
+{
+  iot_data_json_builder_t * builder = (iot_data_json_builder_t*) arg;
+  iot_data_json_not_number (builder);
+  const iot_typecode_t * tc = iot_data_json_expected (builder);
+  if ((tc && tc->type != IOT_DATA_STRING) || memchr (str, '\0', len)) return iot_data_json_invalid (builder); // NUL would truncate string
+  return iot_data_json_element (builder, iot_data_json_string_data (builder, str, len));
+}
+
+static bool iot_data_json_number_value (void * arg, const char * str, size_t len)
+{
+  iot_data_json_builder_t * builder = (iot_data_json_builder_t*) arg;
+  iot_data_json_frame_t * frame = builder->depth ? &builder->stack[builder->depth - 1u] : NULL;
+  const iot_typecode_t * tc = iot_data_json_expected (builder);
+  iot_data_union_t val;
+  if (frame && frame->packing)
+  {
+    bool real = iot_data_json_parse_number (str, len, &val);
+    if (real && ! frame->real) // First floating point number, convert integers so far
+    {
+      iot_data_union_t * vals = (iot_data_union_t*) frame->elements;
+      for (uint32_t i = 0; i < frame->size; i++) vals[i].f64 = (double) vals[i].i64;
+      frame->real = true;
+    }
+    else if (! real && frame->real)
+    {
+      val.f64 = (double) val.i64;
+    }
+    iot_data_json_append (frame, &val, sizeof (val));
+    return true;
+  }
+  if (tc == NULL) return iot_data_json_element (builder, iot_data_json_number (str, len));
+  if (! iot_data_json_convert (str, len, tc->type, &val)) return iot_data_json_invalid (builder);
+  return iot_data_json_typed_element (builder, tc->type, &val);
+}
+
+static bool iot_data_json_bool_value (void * arg, bool bl)
+{
+  iot_data_json_builder_t * builder = (iot_data_json_builder_t*) arg;
+  iot_data_json_not_number (builder);
+  const iot_typecode_t * tc = iot_data_json_expected (builder);
+  iot_data_union_t val = { .bl = bl };
+  if (tc && tc->type != IOT_DATA_BOOL) return iot_data_json_invalid (builder);
+  return iot_data_json_typed_element (builder, IOT_DATA_BOOL, &val);
+}
+
+static bool iot_data_json_null_value (void * arg)
+{
+  iot_data_json_builder_t * builder = (iot_data_json_builder_t*) arg;
+  iot_data_json_not_number (builder);
+  const iot_typecode_t * tc = iot_data_json_expected (builder);
+  if (tc && tc->type != IOT_DATA_STRING) return iot_data_json_invalid (builder);
+  return iot_data_json_element (builder, iot_data_alloc_string ("null", IOT_DATA_REF));
+}
+
+static const iot_json_handler_t iot_data_json_handler =
+{
+  iot_data_json_object_begin, iot_data_json_end, iot_data_json_array_begin, iot_data_json_end, iot_data_json_key,
+  iot_data_json_string_value, iot_data_json_number_value, iot_data_json_bool_value, iot_data_json_null_value
+};
+
+static void iot_data_json_builder_reset (iot_data_json_builder_t * builder)
+{
+  while (builder->depth)
+  {
+    iot_data_json_frame_t * frame = &builder->stack[--builder->depth];
+    iot_data_free (frame->key);
+    iot_data_free (frame->container);
+    free (frame->elements);
+  }
+  builder->invalid = false;
+}
+
+static iot_data_t * iot_data_json_build (const char * json, const iot_typecode_t * typecode, const iot_data_json_options_t * options)
+{
+  iot_data_json_builder_t builder = { .typecode = typecode, .options = options, .length = strlen (json) };
+  if (options && options->string_views)
+  {
+    char * copy = malloc (builder.length + 1u);
+    memcpy (copy, json, builder.length + 1u);
+    builder.document = iot_data_alloc_string (copy, IOT_DATA_TAKE);
+    json = copy;
+  }
+  iot_json_sax_parse (json, builder.length, &iot_data_json_handler, &builder);
+  iot_data_json_builder_reset (&builder);
+  iot_data_free (builder.document);
+  free (builder.stack);
+  return builder.result;
+}
+
+iot_data_t * iot_data_from_json (const char * json)
+{
+  assert (json);
+  return iot_data_json_build (json, NULL, NULL);
+}
+
+iot_data_t * iot_data_from_json_with_typecode (const char * json, const iot_typecode_t * typecode)
+{
+  assert (json);
+  return iot_data_json_build (json, typecode, NULL);
+}
+
+iot_data_t * iot_data_from_json_with_options (const char * json, const iot_data_json_options_t * options)
+{
+  assert (json && options);
+  assert (options->array_type == NULL || options->array_type->type == IOT_DATA_ARRAY);
+  return iot_data_json_build (json, NULL, options);
+}
+
+iot_data_json_parser_t * iot_data_json_parser_alloc (iot_data_json_fn fn, void * arg)
+{
+  assert (fn);
+  iot_data_json_parser_t * parser = calloc (1, sizeof (*parser));
+  parser->builder.fn = fn;
+  parser->builder.arg = arg;
+  parser->sax = iot_json_sax_alloc (&iot_data_json_handler, &parser->builder);
+  return parser;
+}
+
+bool iot_data_json_parser_push (iot_data_json_parser_t * parser, const char * json, size_t len)
+{
+  assert (parser);
+  return iot_json_sax_push (parser->sax, json, len) == 0;
+}
+
+bool iot_data_json_parser_finish (iot_data_json_parser_t * parser)
+{
+  assert (parser);
+  bool ok = iot_json_sax_finish (parser->sax) == 0;
+  iot_data_json_builder_reset (&parser->builder);
+  return ok;
+}
+
+void iot_data_json_parser_free (iot_data_json_parser_t * parser)
+{
+  if (parser)
+  {
+    iot_json_sax_free (parser->sax);
+    iot_data_json_builder_reset (&parser->builder);
+    free (parser->builder.stack);
+    free (parser);
+  }
+}
+
+// Lazy json conversion. The json is copied and tokenized once, with each json object or array converted to a map
+// or vector referencing its token. This is built on first access, converting the direct children of the token,
+// with nested objects and arrays again converted to lazy maps and vectors. The tokenized json is held in a single
+// allocation, freed once the last lazy map or vector referencing it is built or freed. Lazy data and data built
+// from it is never arena allocated, as it may be built after the arena is reset.
+
+static iot_data_t * iot_data_lazy_alloc (iot_data_lazy_doc_t * doc, uint32_t token)
+{
+  iot_data_lazy_t * lazy = iot_data_block_alloc (IOT_DATA_BLOCK_SMALL);
+  iot_data_t * data;
+  atomic_fetch_add (&doc->refs, 1);
+  lazy->doc = doc;
+  lazy->token = token;
+  if (doc->tokens[token].type == IOT_JSON_OBJECT)
+  {
+    data = iot_data_alloc_map (IOT_DATA_STRING);
+    ((iot_data_map_t*) data)->lazy = lazy;
+  }
+  else
+  {
+    data = iot_data_alloc_vector (0u);
+    ((iot_data_vector_t*) data)->lazy = lazy;
+  }
+  data->lazy = true;
+  return data;
+}
+
+static void iot_data_lazy_release (iot_data_lazy_t * lazy)
+{
+  iot_data_lazy_doc_t * doc = lazy->doc;
+  iot_data_block_free (lazy, IOT_DATA_BLOCK_SMALL);
+  if (atomic_fetch_add (&doc->refs, -1) <= 1) free (doc);
+}
+
+static bool iot_data_lazy_string (void * arg, const char * str, size_t len)
+{
+  *((iot_data_t**) arg) = iot_data_json_string (str, len);
+  return true;
+}
+
+static const iot_json_handler_t iot_data_lazy_handler = { .string = iot_data_lazy_string };
+
+// Convert a token to data as iot_data_from_json would, other than objects and arrays which are left to be built
+
+static iot_data_t * iot_data_lazy_value (iot_data_lazy_doc_t * doc, uint32_t token)
+{
+  const iot_json_tok_t * tok = &doc->tokens[token];
+  const char * str = doc->json + tok->start;
+  size_t len = (size_t) (tok->end - tok->start);
+  iot_data_t * data = NULL;
+  switch (tok->type)
+  {
+    case IOT_JSON_OBJECT:
+    case IOT_JSON_ARRAY: return iot_data_lazy_alloc (doc, token);
+    case IOT_JSON_STRING:
+    {
+      if (memchr (str, '\\', len) == NULL) return iot_data_json_string (str, len);
+      iot_json_sax_parse (str - 1, len + 2u, &iot_data_lazy_handler, &data); // Unescape as quoted string
+      return data ? data : iot_data_json_string (str, len);
+    }
+    default: break;
+  }
+  switch (*str)
+  {
+    case 't': case 'f': return iot_data_alloc_bool (*str == 't');
+    case 'n': return iot_data_alloc_string ("null", IOT_DATA_REF);
+    default: return iot_data_json_number (str, len);
+  }
+}
+
+static void iot_data_lazy_load (iot_data_t * data)
+{
+  iot_data_arena_t * arena = iot_data_arena_current;
+  iot_data_lazy_t * lazy = iot_data_lazy_of (data);
+  iot_data_lazy_doc_t * doc = lazy->doc;
+  uint32_t size = doc->tokens[lazy->token].size;
+  uint32_t child = lazy->token + 1u;
+
+  iot_data_arena_current = NULL;
+  data->lazy = false;
+  if (data->type == IOT_DATA_MAP)
+  {
+    ((iot_data_map_t*) data)->index = NULL;
+    for (uint32_t i = 0; i < size; i++) // Key token followed by value token
+    {
+      iot_data_t * key = iot_data_lazy_value (doc, child);
+      iot_data_map_add (data, key, iot_data_lazy_value (doc, child + 1u));
+      child = doc->next[child + 1u];
+    }
+  }
+  else
+  {
+    iot_data_vector_t * vector = (iot_data_vector_t*) data;
+    vector->values = NULL;
+    iot_data_vector_resize (data, size);
+    for (uint32_t i = 0; i < size; i++)
+    {
+      vector->values[i] = iot_data_lazy_value (doc, child);
+      child = doc->next[child];
+    }
+  }
+  iot_data_lazy_release (lazy);
+  iot_data_arena_current = arena;
+}
+
+// Whether quoted string text contains an escaped NUL character, rejected as by iot_data_from_json
+
+static bool iot_data_lazy_has_nul (const char * str, size_t len)
+{
+  const char * end = str + len;
+  for (str = memchr (str, '\\', len); str && str + 1 < end; str = memchr (str, '\\', (size_t) (end - str)))
+  {
+    if (str[1] == 'u' && end - str >= 6 && strncmp (str + 2, "0000", 4u) == 0) return true;
+    str += 2; // Skip escaped character
+  }
+  return false;
+}
+
+// Whether primitive token text is true, false, null or a number (the tokenizer accepts any unquoted text)
+
+static bool iot_data_lazy_primitive (const char * str, size_t len)
+{
+  switch (*str)
+  {
+    case 't': return len == 4u && strncmp (str, "true", 4u) == 0;
+    case 'f': return len == 5u && strncmp (str, "false", 5u) == 0;
+    case 'n': return len == 4u && strncmp (str, "null", 4u) == 0;
+    default: return iot_json_is_number (str, len);
+  }
+}
+
+// Check that no object has duplicate keys (which would be merged when built), using a hash set of key tokens.
+// Escaped keys are not compared, as differently escaped keys can be equal.
+
+static bool iot_data_lazy_unique_keys (const iot_data_lazy_doc_t * doc)
+{
+  const iot_json_tok_t * tokens = doc->tokens;
+  uint32_t mask = 15u;
+  while (mask < doc->count * 2u) mask = (mask << 1u) | 1u;
+  uint32_t * set = calloc (mask + 1u, sizeof (*set)); // Key token index plus one
+  bool unique = true;
+  for (uint32_t i = 1u; unique && i < doc->count; i++)
+  {
+    if (tokens[tokens[i].parent].type != IOT_JSON_OBJECT || tokens[tokens[i].parent].size < 2u) continue;
+    const char * key = doc->json + tokens[i].start;
+    size_t len = (size_t) (tokens[i].end - tokens[i].start);
+    if (memchr (key, '\\', len)) unique = false;
+    uint32_t hash = 2166136261u ^ (uint32_t) tokens[i].parent;
+    for (size_t j = 0; j < len; j++) hash = (hash ^ (uint8_t) key[j]) * 16777619u;
+    for (uint32_t slot = hash & mask; unique; slot = (slot + 1u) & mask)
+    {
+      if (set[slot] == 0u)
+      {
+        set[slot] = i + 1u;
+        break;
+      }
+      const iot_json_tok_t * other = &tokens[set[slot] - 1u];
+      unique = ! (other->parent == tokens[i].parent && (size_t) (other->end - other->start) == len && memcmp (doc->json + other->start, key, len) == 0);
+    }
+  }
+  free (set);
+  return unique;
+}
+
+// Check that tokens are a single object or array, with each object key a string with one value (as the tokenizer
+// does not reject missing commas or colons) and valid primitives, and set the index of the token following each
+// token and its children. Json that would not build to the same data is left to iot_data_from_json.
+
+static bool iot_data_lazy_index (iot_data_lazy_doc_t * doc)
+{
+  const iot_json_tok_t * tokens = doc->tokens;
+  if (doc->count == 0u || (tokens[0].type != IOT_JSON_OBJECT && tokens[0].type != IOT_JSON_ARRAY)) return false;
+  for (uint32_t i = 1u; i < doc->count; i++)
+  {
+    if (tokens[i].parent < 0) return false;
+    const char * str = doc->json + tokens[i].start;
+    size_t len = (size_t) (tokens[i].end - tokens[i].start);
+    if (tokens[i].type == IOT_JSON_STRING && iot_data_lazy_has_nul (str, len)) return false;
+    if (tokens[i].type == IOT_JSON_PRIMITIVE && ! iot_data_lazy_primitive (str, len)) return false;
+    const iot_json_tok_t * parent = &tokens[tokens[i].parent];
+    if (parent->type == IOT_JSON_OBJECT)
+    {
+      if (tokens[i].type != IOT_JSON_STRING || tokens[i].size != 1u) return false;
+    }
+    else if (parent->type != IOT_JSON_ARRAY && tokens[parent->parent].type != IOT_JSON_OBJECT)
+    {
+      return false;
+    }
+  }
+  if (! iot_data_lazy_unique_keys (doc)) return false;
+  for (uint32_t i = doc->count; i-- > 0u;)
+  {
+    uint32_t next = i + 1u;
+    while (next < doc->count && tokens[next].start < tokens[i].end) next = doc->next[next];
+    doc->next[i] = next;
+  }
+  return true;
+}
+
+iot_data_t * iot_data_from_json_lazy (const char * json)
+{
+  assert (json);
+  iot_json_parser parser;
+  size_t len = strlen (json);
+  iot_json_init (&parser);
+  int count = iot_json_parse (&parser, json, len, NULL, 0u);
+  if (count <= 0) return iot_data_from_json (json);
+
+  iot_data_lazy_doc_t * doc = malloc (sizeof (*doc) + (size_t) count * (sizeof (iot_json_tok_t) + sizeof (uint32_t)) + len + 1u);
+  atomic_store (&doc->refs, 0);
+  doc->count = (uint32_t) count;
+  doc->tokens = (iot_json_tok_t*) (doc + 1);
+  doc->next = (uint32_t*) (doc->tokens + count);
+  doc->json = (char*) (doc->next + count);
+  memcpy (doc->json, json, len + 1u);
+  iot_json_init (&parser);
+  if (iot_json_parse (&parser, doc->json, len, doc->tokens, doc->count) != count || ! iot_data_lazy_index (doc))
+  {
+    free (doc);
+    return iot_data_from_json (json);
+  }
+  iot_data_arena_t * arena = iot_data_arena_current;
+  iot_data_arena_current = NULL;
+  iot_data_t * data = iot_data_lazy_alloc (doc, 0u);
+  iot_data_arena_current = arena;
+  return data;
+}
+
+#ifdef IOT_HAS_XML
+static iot_data_t * iot_data_map_from_xml (bool root, yxml_t * x, iot_string_holder_t * holder, const char ** str)
+{
+  iot_data_t * elem = iot_data_alloc_map (IOT_DATA_STRING);
+  iot_data_t * children = NULL;
+  iot_data_t * attrs = iot_data_alloc_map (IOT_DATA_STRING);
+  char * elem_name = x->elem;
+  bool more = true;
+  iot_data_holder_reset (holder);
+  iot_data_string_map_add (elem, "name", iot_data_alloc_string (elem_name, IOT_DATA_COPY));
+  iot_data_string_map_add (elem, "attributes", attrs);
+  while (more && **str)
+  {
+    switch (yxml_parse (x, *(*str)++))
+    {
+      case YXML_ELEMSTART:
+      {
+        iot_data_t * child = iot_data_map_from_xml (false, x, holder, str);
+        if (child)
+        {
+          if (root)
+          {
+            iot_data_free (elem);
+            elem = child;
+            more = false;
+          }
+          else
+          {
+            uint32_t size;
+            if (!children)
+            {
+              children = iot_data_alloc_vector (1);
+              iot_data_string_map_add (elem, "children", children);
+              size = 0;
+            }
+            else
+            {
+              size = iot_data_vector_size (children);
+              iot_data_vector_resize (children, size + 1);
+            }
+            iot_data_vector_add (children, size, child);
+          }
+        }
+        else
+        {
+          iot_data_free (elem);
+          elem = NULL;
+          more = false;
+        }
+        break;
+      }
+      case YXML_ELEMEND:
+      {
+        if (holder->len)
+        {
+          iot_data_string_map_add (elem, "content", iot_data_alloc_string (holder->str, IOT_DATA_COPY));
+          iot_data_holder_reset (holder);
+        }
+        more = false;
+        break;
+      }
+      case YXML_ATTRVAL:
+      case YXML_CONTENT:
+      {
+        iot_data_holder_write (holder, x->data, strlen (x->data));
+        break;
+      }
+      case YXML_ATTREND:
+      {
+        iot_data_map_add (attrs, iot_data_alloc_string (x->attr, IOT_DATA_COPY), iot_data_alloc_string (holder->str, IOT_DATA_COPY));
+        iot_data_holder_reset (holder);
+        break;
+      }
+      case YXML_EEOF:
+      case YXML_EREF:
+      case YXML_ECLOSE:
+      case YXML_ESTACK:
+      case YXML_ESYN:
+      {
+        // Error
+        iot_data_free (elem);
+        elem = NULL;
+        more = false;
+        break;
+      }
+      default:
+      {
+        break;
+      }
+    }
+  }
+
+  return elem;
+}
+
+iot_data_t * iot_data_from_xml (const char * xml)
+{
+  iot_data_t * result;
+  yxml_t * x = malloc (sizeof (yxml_t) + YXML_PARSER_BUFF_SIZE);
+  iot_string_holder_t holder;
+  iot_data_holder_init (&holder, YXML_BUFF_SIZE, NULL, NULL);
+  yxml_init (x, x+1, YXML_PARSER_BUFF_SIZE);
+  result = iot_data_map_from_xml (true, x, &holder, &xml);
+  free (x);
+  free (holder.str);
+  return result;
+}
+#endif
+
+// CBOR (RFC 8949) conversion. Int64, Float32, Float64, Bool, String, Map and Vector data map directly to
+// CBOR items and arrays to RFC 8746 typed arrays holding the array bytes in host byte order (UInt8 arrays
+// as plain byte strings). Types without a CBOR equivalent use private tags: other integer types, Bool
+// arrays, maps not keyed by strings (whose keys are then encoded without integer type tags) and data
+// with metadata, encoded as a [metadata, data] pair.
+
+#define IOT_DATA_CBOR_UINT 0u
+#define IOT_DATA_CBOR_NINT 1u
+#define IOT_DATA_CBOR_BYTES 2u
+#define IOT_DATA_CBOR_TEXT 3u
+#define IOT_DATA_CBOR_ARRAY 4u
+#define IOT_DATA_CBOR_MAP 5u
+#define IOT_DATA_CBOR_TAG 6u
+#define IOT_DATA_CBOR_SIMPLE 7u
+#define IOT_DATA_CBOR_FALSE 0xf4u
+#define IOT_DATA_CBOR_TRUE 0xf5u
+#define IOT_DATA_CBOR_FLOAT32 0xfau
+#define IOT_DATA_CBOR_FLOAT64 0xfbu
+#define IOT_DATA_CBOR_BREAK 0xffu
+#define IOT_DATA_CBOR_INDEFINITE 31u
+#define IOT_DATA_CBOR_TAG_TYPE 0xe000u       // Plus data type, for tagged integer types and Bool arrays
+#define IOT_DATA_CBOR_TAG_MAP 0xe010u        // Plus key type, for maps not keyed by strings
+#define IOT_DATA_CBOR_TAG_METADATA 0xe020u   // Tags [metadata, data] pair
+#define IOT_DATA_CBOR_TAG_ARRAY_MIN 64u      // RFC 8746 typed array tag range
+#define IOT_DATA_CBOR_TAG_ARRAY_MAX 87u
+#define IOT_DATA_CBOR_MAX_DEPTH 512u
+#define IOT_DATA_CBOR_BUFF_SIZE 512u
+
+#define IOT_DATA_CBOR_LE (IOT_DATA_BIG_ENDIAN ? 0u : 4u) // RFC 8746 little endian typed array tag flag
+
+static const uint8_t iot_data_cbor_array_tags [] = { 72u, 64u, 73u, 65u, 74u, 66u, 75u, 67u, 81u, 82u }; // Big endian typed array tags
+static const uint8_t iot_data_cbor_info [] = { 0u, 24u, 25u, 0u, 26u, 0u, 0u, 0u, 27u }; // Additional info for argument size
+
+static void iot_data_cbor_write (iot_string_holder_t * holder, uint8_t initial, uint64_t arg, uint32_t n)
+{
+  iot_data_holder_reserve (holder, 9u);
+  uint8_t * buff = (uint8_t*) holder->str + holder->len;
+  buff[0] = initial;
+  for (uint32_t i = n; i > 0u; i--)
+  {
+    buff[i] = (uint8_t) arg;
+    arg >>= 8u;
+  }
+  holder->len += n + 1u;
+}
+
+static inline void iot_data_cbor_head (iot_string_holder_t * holder, uint32_t major, uint64_t arg)
+{
+  uint32_t n = (arg < 24u) ? 0u : (arg <= UINT8_MAX) ? 1u : (arg <= UINT16_MAX) ? 2u : (arg <= UINT32_MAX) ? 4u : 8u;
+  iot_data_cbor_write (holder, (uint8_t) ((major << 5u) | (n ? iot_data_cbor_info[n] : arg)), arg, n);
+}
+
+static inline void iot_data_cbor_int (iot_string_holder_t * holder, int64_t val)
+{
+  if (val < 0) iot_data_cbor_head (holder, IOT_DATA_CBOR_NINT, (uint64_t) (-1 - val));
+  else iot_data_cbor_head (holder, IOT_DATA_CBOR_UINT, (uint64_t) val);
+}
+
+static void iot_data_cbor_encode (iot_string_holder_t * holder, const iot_data_t * data, bool bare)
+{
+  const iot_data_value_t * val = (const iot_data_value_t*) data;
+  iot_data_lazy_check (data);
+  if (data->metadata)
+  {
+    iot_data_cbor_head (holder, IOT_DATA_CBOR_TAG, IOT_DATA_CBOR_TAG_METADATA);
+    iot_data_cbor_head (holder, IOT_DATA_CBOR_ARRAY, 2u);
+    iot_data_cbor_encode (holder, data->metadata, false);
+  }
+  if (! bare && data->type < IOT_DATA_INT64)
+  {
+    iot_data_cbor_head (holder, IOT_DATA_CBOR_TAG, IOT_DATA_CBOR_TAG_TYPE + data->type);
+  }
+  switch (data->type)
+  {
+    case IOT_DATA_INT8: iot_data_cbor_int (holder, val->value.i8); break;
+    case IOT_DATA_UINT8: iot_data_cbor_head (holder, IOT_DATA_CBOR_UINT, val->value.ui8); break;
+    case IOT_DATA_INT16: iot_data_cbor_int (holder, val->value.i16); break;
+    case IOT_DATA_UINT16: iot_data_cbor_head (holder, IOT_DATA_CBOR_UINT, val->value.ui16); break;
+    case IOT_DATA_INT32: iot_data_cbor_int (holder, val->value.i32); break;
+    case IOT_DATA_UINT32: iot_data_cbor_head (holder, IOT_DATA_CBOR_UINT, val->value.ui32); break;
+    case IOT_DATA_INT64: iot_data_cbor_int (holder, val->value.i64); break;
+    case IOT_DATA_UINT64:
+    {
+      if (! bare && val->value.ui64 <= INT64_MAX) iot_data_cbor_head (holder, IOT_DATA_CBOR_TAG, IOT_DATA_CBOR_TAG_TYPE + IOT_DATA_UINT64);
+      iot_data_cbor_head (holder, IOT_DATA_CBOR_UINT, val->value.ui64);
+      break;
+    }
+    case IOT_DATA_FLOAT32:
+    {
+      uint32_t bits;
+      memcpy (&bits, &val->value.f32, sizeof (bits));
+      iot_data_cbor_write (holder, IOT_DATA_CBOR_FLOAT32, bits, 4u);
+      break;
+    }
+    case IOT_DATA_FLOAT64:
+    {
+      uint64_t bits;
+      memcpy (&bits, &val->value.f64, sizeof (bits));
+      iot_data_cbor_write (holder, IOT_DATA_CBOR_FLOAT64, bits, 8u);
+      break;
+    }
+    case IOT_DATA_BOOL: iot_data_cbor_write (holder, val->value.bl ? IOT_DATA_CBOR_TRUE : IOT_DATA_CBOR_FALSE, 0u, 0u); break;
+    case IOT_DATA_STRING:
+    {
+      size_t len = strlen (val->value.str);
+      iot_data_cbor_head (holder, IOT_DATA_CBOR_TEXT, len);
+      iot_data_holder_write (holder, val->value.str, len);
+      break;
+    }
+    case IOT_DATA_ARRAY:
+    {
+      const iot_data_array_t * array = (const iot_data_array_t*) data;
+      uint32_t size = IOT_DATA_ARRAY_SIZE (array);
+      if (array->type == IOT_DATA_BOOL)
+      {
+        iot_data_cbor_head (holder, IOT_DATA_CBOR_TAG, IOT_DATA_CBOR_TAG_TYPE + IOT_DATA_BOOL);
+      }
+      else if (array->type != IOT_DATA_UINT8)
+      {
+        iot_data_cbor_head (holder, IOT_DATA_CBOR_TAG, iot_data_cbor_array_tags[array->type] | ((iot_data_type_size[array->type] > 1u) ? IOT_DATA_CBOR_LE : 0u));
+      }
+      iot_data_cbor_head (holder, IOT_DATA_CBOR_BYTES, size);
+      iot_data_holder_write (holder, array->data, size);
+      break;
+    }
+    case IOT_DATA_MAP:
+    {
+      const iot_data_map_t * map = (const iot_data_map_t*) data;
+      bool keyed = (map->key_type != IOT_DATA_STRING);
+      if (keyed) iot_data_cbor_head (holder, IOT_DATA_CBOR_TAG, IOT_DATA_CBOR_TAG_MAP + map->key_type);
+      iot_data_cbor_head (holder, IOT_DATA_CBOR_MAP, map->size);
+      for (const iot_data_pair_t * pair = map->head; pair; pair = (const iot_data_pair_t*) pair->base.next)
+      {
+        iot_data_cbor_encode (holder, pair->key, keyed);
+        iot_data_cbor_encode (holder, pair->value, false);
+      }
+      break;
+    }
+    case IOT_DATA_VECTOR:
+    {
+      const iot_data_vector_t * vector = (const iot_data_vector_t*) data;
+      iot_data_cbor_head (holder, IOT_DATA_CBOR_ARRAY, vector->size);
+      for (uint32_t i = 0; i < vector->size; i++)
+      {
+        iot_data_cbor_encode (holder, vector->values[i], false);
+      }
+      break;
     }
   }
-  return result;
 }
 
-const iot_data_t * iot_data_map_get (const iot_data_t * map, const iot_data_t * key)
+uint8_t * iot_data_to_cbor (const iot_data_t * data, uint32_t * size)
 {
-  iot_data_map_t * mp = (iot_data_map_t*) map;
-  assert (mp && key && (mp->base.type == IOT_DATA_MAP));
-  iot_data_pair_t * pair = iot_data_map_find (mp, key);
-  return pair ? pair->value : NULL;
+  iot_string_holder_t holder;
+  assert (data && size);
+  iot_data_holder_init (&holder, IOT_DATA_CBOR_BUFF_SIZE, NULL, NULL);
+  iot_data_cbor_encode (&holder, data, false);
+  *size = (uint32_t) holder.len;
+  return (uint8_t*) holder.str;
 }
 
-const iot_data_t * iot_data_string_map_get (const iot_data_t * map, const char * key)
+bool iot_data_to_cbor_sink (const iot_data_t * data, iot_data_sink_fn sink, void * arg)
 {
-  assert (map && key);
-  iot_data_t * dkey = iot_data_alloc_string (key, IOT_DATA_REF);
-  const iot_data_t * value = iot_data_map_get (map, dkey);
-  iot_data_free (dkey);
-  return value;
+  iot_string_holder_t holder;
+  assert (data && sink);
+  iot_data_holder_init (&holder, IOT_JSON_SINK_BUFF_SIZE, sink, arg);
+  iot_data_cbor_encode (&holder, data, false);
+  iot_data_holder_flush (&holder);
+  free (holder.str);
+  return holder.ok;
 }
 
-const char * iot_data_string_map_get_string (const iot_data_t * map, const char * key)
+typedef struct iot_data_cbor_reader_t
 {
-  const iot_data_t * data = iot_data_string_map_get (map, key);
-  return data ? iot_data_string (data) : NULL;
-}
+  const uint8_t * ptr;                // Next byte to read
+  const uint8_t * end;                // End of input
+  uint32_t depth;                     // Nesting depth of item being decoded
+} iot_data_cbor_reader_t;
 
-int64_t iot_data_string_map_get_i64 (const iot_data_t * map, const char * key, int64_t default_val)
-{
-  const iot_data_t * data = iot_data_string_map_get (map, key);
-  return (data && (iot_data_type (data) == IOT_DATA_INT64)) ? iot_data_i64 (data) : default_val;
-}
+// Read item head, returning the major type, additional info and argument (not read if indefinite)
 
-bool iot_data_string_map_get_bool (const iot_data_t * map, const char * key, bool default_val)
+static bool iot_data_cbor_read_head (iot_data_cbor_reader_t * reader, uint32_t * major, uint32_t * info, uint64_t * arg)
 {
-  const iot_data_t * data = iot_data_string_map_get (map, key);
-  return (data && (iot_data_type (data) == IOT_DATA_BOOL)) ? iot_data_bool (data) : default_val;
+  if (reader->ptr >= reader->end) return false;
+  uint8_t initial = *reader->ptr++;
+  *major = initial >> 5u;
+  *info = initial & 0x1fu;
+  *arg = *info;
+  if (*info >= 24u && *info < 28u)
+  {
+    size_t n = 1u << (*info - 24u);
+    if ((size_t) (reader->end - reader->ptr) < n) return false;
+    *arg = 0u;
+    for (size_t i = 0; i < n; i++) *arg = (*arg << 8u) | *reader->ptr++;
+  }
+  else if (*info >= 28u)
+  {
+    return (*info == IOT_DATA_CBOR_INDEFINITE) && (*major >= IOT_DATA_CBOR_BYTES) && (*major <= IOT_DATA_CBOR_MAP);
+  }
+  return true;
 }
 
-double iot_data_string_map_get_f64 (const iot_data_t * map, const char * key, double default_val)
+static inline bool iot_data_cbor_break (iot_data_cbor_reader_t * reader)
 {
-  const iot_data_t * data = iot_data_string_map_get (map, key);
-  return (data && (iot_data_type (data) == IOT_DATA_FLOAT64)) ? iot_data_f64 (data) : default_val;
+  bool brk = (reader->ptr < reader->end) && (*reader->ptr == IOT_DATA_CBOR_BREAK);
+  if (brk) reader->ptr++;
+  return brk;
 }
 
-const iot_data_t * iot_data_string_map_get_vector (const iot_data_t * map, const char * key)
-{
-  const iot_data_t * data = iot_data_string_map_get (map, key);
-  return ((data && (iot_data_type (data) == IOT_DATA_VECTOR)) ? data : NULL);
-}
+// Read a byte or text string, referencing the input if of definite length, otherwise concatenating its chunks into a buffer
 
-const iot_data_t * iot_data_string_map_get_map (const iot_data_t * map, const char * key)
+static bool iot_data_cbor_read_string (iot_data_cbor_reader_t * reader, uint32_t major, uint32_t info, uint64_t arg, const uint8_t ** str, size_t * len, uint8_t ** buff)
 {
-  const iot_data_t * data = iot_data_string_map_get (map, key);
-  return ((data && (iot_data_type (data) == IOT_DATA_MAP)) ? data : NULL);
+  *buff = NULL;
+  if (info != IOT_DATA_CBOR_INDEFINITE)
+  {
+    if (arg > (uint64_t) (reader->end - reader->ptr)) return false;
+    *str = reader->ptr;
+    *len = (size_t) arg;
+    reader->ptr += arg;
+    return true;
+  }
+  *str = (const uint8_t*) "";
+  *len = 0u;
+  while (! iot_data_cbor_break (reader))
+  {
+    uint32_t chunk_major;
+    if (! iot_data_cbor_read_head (reader, &chunk_major, &info, &arg) || (chunk_major != major) || (info == IOT_DATA_CBOR_INDEFINITE) || (arg > (uint64_t) (reader->end - reader->ptr)))
+    {
+      free (*buff);
+      return false;
+    }
+    *buff = realloc (*buff, *len + arg + 1u);
+    memcpy (*buff + *len, reader->ptr, arg);
+    *len += arg;
+    *str = *buff;
+    reader->ptr += arg;
+  }
+  return true;
 }
 
-iot_data_type_t iot_data_map_key_type (const iot_data_t * map)
-{
-  assert (map);
-  return ((iot_data_map_t*) map)->key_type;
-}
+// Integer of the given type, failing if out of range for the type
 
-extern bool iot_data_map_key_is_of_type (const iot_data_t * map, iot_data_type_t type)
+static iot_data_t * iot_data_cbor_integer (uint32_t major, uint64_t arg, iot_data_type_t type)
 {
-  return (map && (map->type == IOT_DATA_MAP) && (((iot_data_array_t*) map)->type == type));
+  if (major == IOT_DATA_CBOR_NINT ? ((type & 1u) || (arg > (uint64_t) -(iot_data_int_mins[type] + 1))) : (arg > iot_data_int_maxs[type])) return NULL;
+  iot_data_union_t val = { .i64 = (major == IOT_DATA_CBOR_NINT) ? -1 - (int64_t) arg : (int64_t) arg };
+  iot_data_value_t * data = iot_data_value_alloc (type, false);
+  iot_data_json_store ((uint8_t*) &data->value, type, &val, false);
+  return (iot_data_t*) data;
 }
 
-void iot_data_vector_add (iot_data_t * vector, uint32_t index, iot_data_t * val)
+static float iot_data_cbor_half (uint32_t half)
 {
-  iot_data_vector_t * arr = (iot_data_vector_t*) vector;
-  assert (val && vector && (vector->type == IOT_DATA_VECTOR));
-  assert (index < arr->size);
-  iot_data_t * element = arr->values[index];
-  iot_data_free (element);
-  arr->values[index] = val;
+  uint32_t exp = (half >> 10u) & 0x1fu;
+  uint32_t mant = half & 0x3ffu;
+  uint32_t bits = (half & 0x8000u) << 16u;
+  float val;
+  if (exp == 0x1fu)
+  {
+    bits |= 0x7f800000u | (mant << 13u);
+  }
+  else if (exp)
+  {
+    bits |= ((exp + 112u) << 23u) | (mant << 13u);
+  }
+  else if (mant) // Subnormal, normalized as float
+  {
+    for (exp = 113u; ! (mant & 0x400u); exp--) mant <<= 1u;
+    bits |= (exp << 23u) | ((mant & 0x3ffu) << 13u);
+  }
+  memcpy (&val, &bits, sizeof (val));
+  return val;
 }
 
-const iot_data_t * iot_data_vector_get (const iot_data_t * vector, uint32_t index)
-{
-  iot_data_vector_t * arr = (iot_data_vector_t*) vector;
-  assert (vector && (vector->type == IOT_DATA_VECTOR));
-  assert (index < arr->size);
-  return arr->values[index];
-}
+static iot_data_t * iot_data_cbor_decode (iot_data_cbor_reader_t * reader);
 
-void iot_data_vector_resize (iot_data_t * vector, uint32_t size)
+// Reverse the byte order of each element of an array
+
+static void iot_data_swap_bytes (uint8_t * data, size_t len, uint32_t size)
 {
-  iot_data_vector_t * vec = (iot_data_vector_t*) vector;
-  assert (vector && (vector->type == IOT_DATA_VECTOR));
-  if (size < vec->size)
+  for (size_t i = 0; i < len; i += size)
   {
-    for (uint32_t i = size; i < vec->size; i++)
+    for (uint32_t j = 0; j < size / 2u; j++)
     {
-      iot_data_free (vec->values[i]);
+      uint8_t b = data[i + j];
+      data[i + j] = data[i + size - 1u - j];
+      data[i + size - 1u - j] = b;
     }
   }
-  else if (size > vec->size)
-  {
-    vec->values = realloc (vec->values, size * sizeof (iot_data_t*));
-    memset (&vec->values[vec->size], 0, (size - vec->size) * sizeof (iot_data_t*));
-  }
-  vec->size = size;
 }
 
-uint32_t iot_data_vector_size (const iot_data_t * vector)
-{
-  assert (vector && (vector->type == IOT_DATA_VECTOR));
-  return ((iot_data_vector_t*) vector)->size;
-}
+// Decode a byte string as an array of the given type, swapping element byte order if swap is set
 
-void iot_data_map_iter (const iot_data_t * map, iot_data_map_iter_t * iter)
+static iot_data_t * iot_data_cbor_array (iot_data_cbor_reader_t * reader, uint32_t info, uint64_t arg, iot_data_type_t type, bool swap)
 {
-  assert (iter && map && map->type == IOT_DATA_MAP);
-  iter->pair = NULL;
-  iter->map = (iot_data_map_t*) map;
+  const uint8_t * str;
+  size_t len;
+  uint8_t * buff;
+  iot_data_t * array = NULL;
+  if (iot_data_cbor_read_string (reader, IOT_DATA_CBOR_BYTES, info, arg, &str, &len, &buff))
+  {
+    uint32_t size = iot_data_type_size[type];
+    if ((len % size) == 0u)
+    {
+      array = iot_data_alloc_array ((void*) str, (uint32_t) (len / size), type, IOT_DATA_COPY);
+      if (swap) iot_data_swap_bytes (((iot_data_array_t*) array)->data, len, size);
+    }
+    free (buff);
+  }
+  return array;
 }
 
-bool iot_data_map_iter_next (iot_data_map_iter_t * iter)
+static iot_data_t * iot_data_cbor_vector (iot_data_cbor_reader_t * reader, uint32_t info, uint64_t count)
 {
-  assert (iter);
-  iter->pair = iter->pair ? (iot_data_pair_t*) iter->pair->base.next : iter->map->head;
-  return (iter->pair != NULL);
+  bool indefinite = (info == IOT_DATA_CBOR_INDEFINITE);
+  if (! indefinite && count > (uint64_t) (reader->end - reader->ptr)) return NULL; // Each item at least one byte
+  iot_data_t * vector = iot_data_alloc_vector (indefinite ? 0u : (uint32_t) count);
+  for (uint32_t i = 0; indefinite || i < count; i++)
+  {
+    if (indefinite && iot_data_cbor_break (reader)) break;
+    iot_data_t * val = iot_data_cbor_decode (reader);
+    if (! val)
+    {
+      iot_data_free (vector);
+      return NULL;
+    }
+    if (indefinite) iot_data_vector_resize (vector, i + 1u);
+    iot_data_vector_add (vector, i, val);
+  }
+  return vector;
 }
 
-const iot_data_t * iot_data_map_iter_key (const iot_data_map_iter_t * iter)
+// Decode a map. If keyed, keys are of the given type (integers encoded without type tags), otherwise of the type of the first key
+
+static iot_data_t * iot_data_cbor_map (iot_data_cbor_reader_t * reader, uint32_t info, uint64_t count, bool keyed, iot_data_type_t key_type)
 {
-  assert (iter);
-  return (iter->pair) ? iter->pair->key : NULL;
+  bool indefinite = (info == IOT_DATA_CBOR_INDEFINITE);
+  iot_data_t * map = NULL;
+  if (! indefinite && count > (uint64_t) (reader->end - reader->ptr) / 2u) return NULL;
+  for (uint64_t i = 0; indefinite || i < count; i++)
+  {
+    if (indefinite && iot_data_cbor_break (reader)) break;
+    iot_data_t * key = NULL;
+    iot_data_t * val = NULL;
+    if (keyed && key_type < IOT_DATA_FLOAT32 && reader->ptr < reader->end && (*reader->ptr >> 5u) <= IOT_DATA_CBOR_NINT)
+    {
+      uint32_t major;
+      uint32_t key_info;
+      uint64_t arg;
+      if (iot_data_cbor_read_head (reader, &major, &key_info, &arg)) key = iot_data_cbor_integer (major, arg, key_type);
+    }
+    else
+    {
+      key = iot_data_cbor_decode (reader);
+    }
+    if (key && ! map)
+    {
+      if (! keyed) key_type = key->type;
+      if (key_type < IOT_DATA_MAP) map = iot_data_alloc_map (key_type);
+    }
+    if (map && key && key->type == key_type) val = iot_data_cbor_decode (reader);
+    if (! val)
+    {
+      iot_data_free (key);
+      iot_data_free (map);
+      return NULL;
+    }
+    iot_data_map_add (map, key, val);
+  }
+  return map ? map : iot_data_alloc_map (key_type);
 }
 
-const iot_data_t * iot_data_map_iter_value (const iot_data_map_iter_t * iter)
+static iot_data_t * iot_data_cbor_tagged (iot_data_cbor_reader_t * reader, uint64_t tag)
 {
-  assert (iter);
-  return (iter->pair) ? iter->pair->value : NULL;
+  uint32_t major;
+  uint32_t info;
+  uint64_t arg;
+  if (tag >= IOT_DATA_CBOR_TAG_ARRAY_MIN && tag <= IOT_DATA_CBOR_TAG_ARRAY_MAX)
+  {
+    uint32_t ll = tag & 3u;
+    bool le = (tag & 4u) != 0u;
+    iot_data_type_t type;
+    if (tag & 16u) // Float, only 32 and 64 bit supported
+    {
+      if (ll != 1u && ll != 2u) return NULL;
+      type = (ll == 1u) ? IOT_DATA_FLOAT32 : IOT_DATA_FLOAT64;
+    }
+    else // Integer, uint8 clamped treated as uint8
+    {
+      if (ll == 0u && le && (tag & 8u)) return NULL;
+      type = (iot_data_type_t) (ll * 2u + ((tag & 8u) ? 0u : 1u));
+    }
+    bool ok = iot_data_cbor_read_head (reader, &major, &info, &arg) && (major == IOT_DATA_CBOR_BYTES);
+    return ok ? iot_data_cbor_array (reader, info, arg, type, ll && (le != (IOT_DATA_CBOR_LE != 0u))) : NULL;
+  }
+  if (tag == IOT_DATA_CBOR_TAG_TYPE + IOT_DATA_BOOL)
+  {
+    bool ok = iot_data_cbor_read_head (reader, &major, &info, &arg) && (major == IOT_DATA_CBOR_BYTES);
+    return ok ? iot_data_cbor_array (reader, info, arg, IOT_DATA_BOOL, false) : NULL;
+  }
+  if (tag >= IOT_DATA_CBOR_TAG_TYPE && tag <= IOT_DATA_CBOR_TAG_TYPE + IOT_DATA_UINT64)
+  {
+    bool ok = iot_data_cbor_read_head (reader, &major, &info, &arg) && (major <= IOT_DATA_CBOR_NINT);
+    return ok ? iot_data_cbor_integer (major, arg, (iot_data_type_t) (tag - IOT_DATA_CBOR_TAG_TYPE)) : NULL;
+  }
+  if (tag >= IOT_DATA_CBOR_TAG_MAP && tag < IOT_DATA_CBOR_TAG_MAP + IOT_DATA_MAP)
+  {
+    bool ok = iot_data_cbor_read_head (reader, &major, &info, &arg) && (major == IOT_DATA_CBOR_MAP);
+    return ok ? iot_data_cbor_map (reader, info, arg, true, (iot_data_type_t) (tag - IOT_DATA_CBOR_TAG_MAP)) : NULL;
+  }
+  if (tag == IOT_DATA_CBOR_TAG_METADATA)
+  {
+    iot_data_t * data = NULL;
+    if (iot_data_cbor_read_head (reader, &major, &info, &arg) && (major == IOT_DATA_CBOR_ARRAY) && (arg == 2u))
+    {
+      iot_data_t * metadata = iot_data_cbor_decode (reader);
+      data = metadata ? iot_data_cbor_decode (reader) : NULL;
+      if (data) iot_data_set_metadata (data, metadata);
+      iot_data_free (metadata);
+    }
+    return data;
+  }
+  return iot_data_cbor_decode (reader); // Other tags ignored
 }
 
-iot_data_t * iot_data_map_iter_replace_value (iot_data_map_iter_t * iter, iot_data_t *value)
+static iot_data_t * iot_data_cbor_decode_item (iot_data_cbor_reader_t * reader)
 {
-  assert (iter);
-  iot_data_t *res = (iter->pair) ? iter->pair->value : NULL;
-  if (res)
+  uint32_t major;
+  uint32_t info;
+  uint64_t arg;
+  if (! iot_data_cbor_read_head (reader, &major, &info, &arg)) return NULL;
+  switch (major)
   {
-    iter->pair->value = value;
+    case IOT_DATA_CBOR_UINT: return iot_data_cbor_integer (major, arg, (arg > INT64_MAX) ? IOT_DATA_UINT64 : IOT_DATA_INT64);
+    case IOT_DATA_CBOR_NINT: return iot_data_cbor_integer (major, arg, IOT_DATA_INT64);
+    case IOT_DATA_CBOR_BYTES: return iot_data_cbor_array (reader, info, arg, IOT_DATA_UINT8, false);
+    case IOT_DATA_CBOR_TEXT:
+    {
+      const uint8_t * str;
+      size_t len;
+      uint8_t * buff;
+      if (! iot_data_cbor_read_string (reader, major, info, arg, &str, &len, &buff)) return NULL;
+      iot_data_t * data = iot_data_json_string ((const char*) str, len);
+      free (buff);
+      return data;
+    }
+    case IOT_DATA_CBOR_ARRAY: return iot_data_cbor_vector (reader, info, arg);
+    case IOT_DATA_CBOR_MAP: return iot_data_cbor_map (reader, info, arg, false, IOT_DATA_STRING);
+    case IOT_DATA_CBOR_TAG: return iot_data_cbor_tagged (reader, arg);
+    default: break;
+  }
+  switch (info)
+  {
+    case 20u: case 21u: return iot_data_alloc_bool (info == 21u);
+    case 22u: case 23u: return iot_data_alloc_string ("null", IOT_DATA_REF); // Null or undefined, as from json
+    case 25u: return iot_data_alloc_f32 (iot_data_cbor_half ((uint32_t) arg));
+    case 26u:
+    {
+      uint32_t bits = (uint32_t) arg;
+      float val;
+      memcpy (&val, &bits, sizeof (val));
+      return iot_data_alloc_f32 (val);
+    }
+    case 27u:
+    {
+      double val;
+      memcpy (&val, &arg, sizeof (val));
+      return iot_data_alloc_f64 (val);
+    }
+    default: return NULL;
   }
-  return res;
 }
 
-const char * iot_data_map_iter_string_key (const iot_data_map_iter_t * iter)
+static iot_data_t * iot_data_cbor_decode (iot_data_cbor_reader_t * reader)
 {
-  assert (iter);
-  return (iter->pair) ? iot_data_string (iot_data_map_iter_key (iter)) : NULL;
+  if (reader->depth >= IOT_DATA_CBOR_MAX_DEPTH) return NULL;
+  reader->depth++;
+  iot_data_t * data = iot_data_cbor_decode_item (reader);
+  reader->depth--;
+  return data;
 }
 
-const char * iot_data_map_iter_string_value (const iot_data_map_iter_t * iter)
+iot_data_t * iot_data_from_cbor (const uint8_t * cbor, uint32_t size)
 {
-  assert (iter);
-  return (iter->pair) ? iot_data_string (iot_data_map_iter_value (iter)) : NULL;
+  assert (cbor);
+  iot_data_cbor_reader_t reader = { .ptr = cbor, .end = cbor + size };
+  iot_data_t * data = iot_data_cbor_decode (&reader);
+  if (data && reader.ptr != reader.end)
+  {
+    iot_data_free (data);
+    data = NULL;
+  }
+  return data;
 }
 
-void iot_data_array_iter (const iot_data_t * array, iot_data_array_iter_t * iter)
+// Schema encoding, with the data shape given by a typecode held by both ends so only values are encoded. Integers
+// are LEB128 varints (zigzag encoded if signed), floats and array elements little endian and strings, arrays,
+// vectors and maps prefixed by their varint length. String map keys found in the schema key list are encoded as
+// their varint list index plus one, others as zero followed by the key string. Elements of any type are CBOR.
+// The typecode is compiled into a plan of nodes, the first for the top level value, each referencing its element node.
+
+#define IOT_DATA_PLAN_ANY UINT32_MAX
+#define IOT_DATA_SCHEMA_BUFF_SIZE 128u
+#define IOT_DATA_VARINT_MAX 10u
+
+typedef struct iot_data_plan_t
 {
-  assert (iter && array && array->type == IOT_DATA_ARRAY);
-  iter->array = (iot_data_array_t*) array;
-  iter->index = 0;
-}
+  iot_data_type_t type;               // Data type
+  iot_data_type_t key_type;           // Map key type or array element type
+  uint32_t element;                   // Map or vector element node, IOT_DATA_PLAN_ANY if any type
+} iot_data_plan_t;
 
-bool iot_data_array_iter_next (iot_data_array_iter_t * iter)
+struct iot_data_schema_t
 {
-  assert (iter);
-  iter->index = (iter->index <= iter->array->length) ? iter->index + 1 : 1;
-  return (iter->index <= iter->array->length);
-}
+  iot_data_plan_t * plan;             // Plan nodes
+  uint32_t count;                     // Number of plan nodes
+  iot_data_t * keys;                  // Known string map keys, NULL if none
+  iot_data_t * index;                 // Map of known key to list index
+};
 
-uint32_t iot_data_array_iter_index (const iot_data_array_iter_t * iter)
+static uint32_t iot_data_schema_plan (iot_data_schema_t * schema, const iot_typecode_t * typecode)
 {
-  assert (iter);
-  return (iter->index - 1);
+  uint32_t node = schema->count++;
+  schema->plan = realloc (schema->plan, schema->count * sizeof (*schema->plan));
+  schema->plan[node].type = typecode->type;
+  schema->plan[node].key_type = (typecode->type == IOT_DATA_ARRAY) ? typecode->element_type->type : typecode->key_type;
+  schema->plan[node].element = IOT_DATA_PLAN_ANY;
+  if (typecode->type > IOT_DATA_ARRAY && typecode->element_type)
+  {
+    assert (typecode->type == IOT_DATA_VECTOR || typecode->key_type < IOT_DATA_ARRAY);
+    uint32_t element = iot_data_schema_plan (schema, typecode->element_type);
+    schema->plan[node].element = element;
+  }
+  return node;
 }
 
-const void * iot_data_array_iter_value (const iot_data_array_iter_t * iter)
+iot_data_schema_t * iot_data_schema_alloc (const iot_typecode_t * typecode, const iot_data_t * keys)
 {
-  assert (iter);
-  return (iter->index <= iter->array->length) ? ((char*) (iter->array->data) + (iter->index - 1) * iot_data_type_size[iter->array->type]) : NULL;
+  assert (typecode && (keys == NULL || keys->type == IOT_DATA_VECTOR));
+  iot_data_schema_t * schema = calloc (1, sizeof (*schema));
+  iot_data_schema_plan (schema, typecode);
+  if (keys && iot_data_vector_size (keys))
+  {
+    schema->keys = iot_data_copy (keys);
+    schema->index = iot_data_alloc_map (IOT_DATA_STRING);
+    for (uint32_t i = 0; i < iot_data_vector_size (keys); i++)
+    {
+      const iot_data_t * key = iot_data_vector_get (keys, i);
+      assert (key && key->type == IOT_DATA_STRING);
+      iot_data_string_map_add (schema->index, iot_data_string (key), iot_data_alloc_ui32 (i));
+    }
+  }
+  return schema;
 }
 
-void iot_data_vector_iter (const iot_data_t * vector, iot_data_vector_iter_t * iter)
+void iot_data_schema_free (iot_data_schema_t * schema)
 {
-  assert (iter && vector && vector->type == IOT_DATA_VECTOR);
-  iter->vector = (iot_data_vector_t*) vector;
-  iter->index = 0;
+  if (schema)
+  {
+    iot_data_free (schema->keys);
+    iot_data_free (schema->index);
+    free (schema->plan);
+    free (schema);
+  }
 }
 
-bool iot_data_vector_iter_next (iot_data_vector_iter_t * iter)
+static inline void iot_data_varint_write (iot_string_holder_t * holder, uint64_t val)
 {
-  assert (iter);
-  iter->index = (iter->index <= iter->vector->size) ? iter->index + 1 : 1;
-  return (iter->index <= iter->vector->size);
+  iot_data_holder_reserve (holder, IOT_DATA_VARINT_MAX);
+  uint8_t * buff = (uint8_t*) holder->str + holder->len;
+  while (val >= 0x80u)
+  {
+    *buff++ = (uint8_t) (val | 0x80u);
+    val >>= 7u;
+  }
+  *buff++ = (uint8_t) val;
+  holder->len = (size_t) ((char*) buff - holder->str);
 }
 
-uint32_t iot_data_vector_iter_index (const iot_data_vector_iter_t * iter)
+static inline void iot_data_zigzag_write (iot_string_holder_t * holder, int64_t val)
 {
-  assert (iter);
-  return (iter->index - 1);
+  iot_data_varint_write (holder, ((uint64_t) val << 1u) ^ (uint64_t) (val >> 63));
 }
 
-const iot_data_t * iot_data_vector_iter_value (const iot_data_vector_iter_t * iter)
+static void iot_data_schema_write_le (iot_string_holder_t * holder, const void * data, size_t len, uint32_t size)
 {
-  assert (iter);
-  return (iter->index <= iter->vector->size) ? iter->vector->values[iter->index - 1] : NULL;
+  iot_data_holder_write (holder, data, len);
+  if (IOT_DATA_BIG_ENDIAN) iot_data_swap_bytes ((uint8_t*) holder->str + holder->len - len, len, size);
 }
 
-iot_data_t * iot_data_vector_iter_replace_value (iot_data_vector_iter_t * iter, iot_data_t *value)
+// Write a basic type value, returning false if the data is not of the type
+
+static bool iot_data_schema_write_value (iot_string_holder_t * holder, const iot_data_t * data, iot_data_type_t type)
 {
-  assert (iter);
-  iot_data_t *res = NULL;
-  if (iter->index <= iter->vector->size)
+  const iot_data_value_t * val = (const iot_data_value_t*) data;
+  if (data->type != type) return false;
+  switch (type)
   {
-    res = iter->vector->values[iter->index - 1];
-    iter->vector->values[iter->index - 1] = value;
+    case IOT_DATA_INT8: iot_data_zigzag_write (holder, val->value.i8); break;
+    case IOT_DATA_UINT8: iot_data_varint_write (holder, val->value.ui8); break;
+    case IOT_DATA_INT16: iot_data_zigzag_write (holder, val->value.i16); break;
+    case IOT_DATA_UINT16: iot_data_varint_write (holder, val->value.ui16); break;
+    case IOT_DATA_INT32: iot_data_zigzag_write (holder, val->value.i32); break;
+    case IOT_DATA_UINT32: iot_data_varint_write (holder, val->value.ui32); break;
+    case IOT_DATA_INT64: iot_data_zigzag_write (holder, val->value.i64); break;
+    case IOT_DATA_UINT64: iot_data_varint_write (holder, val->value.ui64); break;
+    case IOT_DATA_FLOAT32: iot_data_schema_write_le (holder, &val->value.f32, sizeof (float), sizeof (float)); break;
+    case IOT_DATA_FLOAT64: iot_data_schema_write_le (holder, &val->value.f64, sizeof (double), sizeof (double)); break;
+    case IOT_DATA_BOOL: iot_data_holder_putc (holder, val->value.bl ? 1 : 0); break;
+    default:
+    {
+      size_t len = strlen (val->value.str);
+      iot_data_varint_write (holder, len);
+      iot_data_holder_write (holder, val->value.str, len);
+      break;
+    }
   }
-  return res;
-}
-
-const char * iot_data_vector_iter_string (const iot_data_vector_iter_t * iter)
-{
-  assert (iter);
-  return (iter->index <= iter->vector->size) ? iot_data_string (iter->vector->values[iter->index - 1]) : NULL;
+  return true;
 }
 
-const iot_data_t * iot_data_vector_find (const iot_data_t * vector, iot_data_cmp_fn cmp, const void * arg)
+static bool iot_data_schema_write (const iot_data_schema_t * schema, iot_string_holder_t * holder, uint32_t node, const iot_data_t * data)
 {
-  const iot_data_t * result = NULL;
-  iot_data_vector_iter_t iter;
-  iot_data_vector_iter (vector, &iter);
-  while (iot_data_vector_iter_next (&iter))
+  if (node == IOT_DATA_PLAN_ANY)
   {
-    const iot_data_t * val = iot_data_vector_iter_value (&iter);
-    if (cmp (val, arg))
+    iot_data_cbor_encode (holder, data, false);
+    return true;
+  }
+  const iot_data_plan_t * plan = &schema->plan[node];
+  if (plan->type < IOT_DATA_ARRAY) return iot_data_schema_write_value (holder, data, plan->type);
+  if (data->type != plan->type) return false;
+  iot_data_lazy_check (data);
+  switch (plan->type)
+  {
+    case IOT_DATA_ARRAY:
     {
-      result = val;
-      break;
+      const iot_data_array_t * array = (const iot_data_array_t*) data;
+      if (array->type != plan->key_type) return false;
+      iot_data_varint_write (holder, array->length);
+      iot_data_schema_write_le (holder, array->data, IOT_DATA_ARRAY_SIZE (array), iot_data_type_size[array->type]);
+      return true;
+    }
+    case IOT_DATA_MAP:
+    {
+      const iot_data_map_t * map = (const iot_data_map_t*) data;
+      if (map->key_type != plan->key_type) return false;
+      iot_data_varint_write (holder, map->size);
+      for (const iot_data_pair_t * pair = map->head; pair; pair = (const iot_data_pair_t*) pair->base.next)
+      {
+        if (schema->index && map->key_type == IOT_DATA_STRING)
+        {
+          const iot_data_t * index = iot_data_map_get (schema->index, pair->key);
+          iot_data_varint_write (holder, index ? ((const iot_data_value_t*) index)->value.ui32 + 1u : 0u);
+          if (! index) iot_data_schema_write_value (holder, pair->key, IOT_DATA_STRING);
+        }
+        else
+        {
+          iot_data_schema_write_value (holder, pair->key, map->key_type);
+        }
+        if (! iot_data_schema_write (schema, holder, plan->element, pair->value)) return false;
+      }
+      return true;
     }
+    default:
+    {
+      const iot_data_vector_t * vector = (const iot_data_vector_t*) data;
+      iot_data_varint_write (holder, vector->size);
+      for (uint32_t i = 0; i < vector->size; i++)
+      {
+        if (! iot_data_schema_write (schema, holder, plan->element, vector->values[i])) return false;
+      }
+      return true;
+    }
+  }
+}
+
+uint8_t * iot_data_schema_encode (const iot_data_schema_t * schema, const iot_data_t * data, uint32_t * size)
+{
+  iot_string_holder_t holder;
+  assert (schema && data && size);
+  iot_data_holder_init (&holder, IOT_DATA_SCHEMA_BUFF_SIZE, NULL, NULL);
+  if (! iot_data_schema_write (schema, &holder, 0u, data))
+  {
+    free (holder.str);
+    holder.str = NULL;
+    holder.len = 0u;
   }
-  return result;
+  *size = (uint32_t) holder.len;
+  return (uint8_t*) holder.str;
 }
 
-static size_t iot_data_repr_size (char c)
+static bool iot_data_varint_read (iot_data_cbor_reader_t * reader, uint64_t * val)
 {
-  return (strchr ("\"\\\b\f\n\r\t", c)) ? 2 : ((c >= '\x00' && c <=  '\x1f') ? 6 : 1);
+  *val = 0u;
+  for (uint32_t shift = 0u; shift < 64u && reader->ptr < reader->end; shift += 7u)
+  {
+    uint8_t b = *reader->ptr++;
+    *val |= (uint64_t) (b & 0x7fu) << shift;
+    if (! (b & 0x80u)) return true;
+  }
+  return false;
 }
 
-static void iot_data_holder_realloc (iot_string_holder_t * holder, size_t required)
+static bool iot_data_schema_read_le (iot_data_cbor_reader_t * reader, void * data, size_t len, uint32_t size)
 {
-  size_t inc = holder->size > IOT_JSON_BUFF_DOUBLING_LIMIT ? IOT_JSON_BUFF_INCREMENT : holder->size;
-  if (inc < required) inc = required;
-  holder->size += inc;
-  holder->free += inc;
-  holder->str = realloc (holder->str, holder->size);
+  if (len > (size_t) (reader->end - reader->ptr)) return false;
+  memcpy (data, reader->ptr, len);
+  if (IOT_DATA_BIG_ENDIAN) iot_data_swap_bytes (data, len, size);
+  reader->ptr += len;
+  return true;
 }
 
-static void iot_data_strcat_escape (iot_string_holder_t * holder, const char * add, bool escape)
+// Read a basic type value, failing if truncated or out of range for the type
+
+static iot_data_t * iot_data_schema_read_value (iot_data_cbor_reader_t * reader, iot_data_type_t type)
 {
-  size_t len = strlen (add);
-  size_t adj_len = len;
-  size_t i;
-  if (escape)
+  iot_data_union_t val = { .ui64 = 0u };
+  uint64_t n;
+  if (type < IOT_DATA_FLOAT32)
   {
-    adj_len = 0;
-    for (i = 0; i < len; i++)
+    if (! iot_data_varint_read (reader, &n)) return NULL;
+    if (type & 1u) // Unsigned
     {
-      adj_len += iot_data_repr_size (add[i]);
+      if (n > iot_data_int_maxs[type]) return NULL;
+      val.ui64 = n;
     }
+    else
+    {
+      val.i64 = (int64_t) (n >> 1u) ^ -(int64_t) (n & 1u);
+      if (val.i64 < iot_data_int_mins[type] || val.i64 > (int64_t) iot_data_int_maxs[type]) return NULL;
+    }
+    iot_data_value_t * data = iot_data_value_alloc (type, false);
+    iot_data_json_store ((uint8_t*) &data->value, type, &val, false);
+    return (iot_data_t*) data;
   }
-  if (holder->free < adj_len)
-  {
-    iot_data_holder_realloc (holder, adj_len);
-  }
-  if (len == adj_len)
+  switch (type)
   {
-    strcat (holder->str, add);
+    case IOT_DATA_FLOAT32: return iot_data_schema_read_le (reader, &val.f32, sizeof (float), sizeof (float)) ? iot_data_alloc_f32 (val.f32) : NULL;
+    case IOT_DATA_FLOAT64: return iot_data_schema_read_le (reader, &val.f64, sizeof (double), sizeof (double)) ? iot_data_alloc_f64 (val.f64) : NULL;
+    case IOT_DATA_BOOL: return (reader->ptr < reader->end && *reader->ptr <= 1u) ? iot_data_alloc_bool (*reader->ptr++ == 1u) : NULL;
+    default:
+    {
+      if (! iot_data_varint_read (reader, &n) || n > (uint64_t) (reader->end - reader->ptr)) return NULL;
+      iot_data_t * data = iot_data_json_string ((const char*) reader->ptr, (size_t) n);
+      reader->ptr += n;
+      return data;
+    }
   }
-  else
+}
+
+static iot_data_t * iot_data_schema_read (const iot_data_schema_t * schema, iot_data_cbor_reader_t * reader, uint32_t node)
+{
+  if (node == IOT_DATA_PLAN_ANY) return iot_data_cbor_decode (reader);
+  const iot_data_plan_t * plan = &schema->plan[node];
+  uint64_t count;
+  if (plan->type < IOT_DATA_ARRAY) return iot_data_schema_read_value (reader, plan->type);
+  if (! iot_data_varint_read (reader, &count) || count > (uint64_t) (reader->end - reader->ptr)) return NULL; // Each element at least one byte
+  switch (plan->type)
   {
-    static const char * hex = "0123456789abcdef";
-    assert (strlen (holder->str) == (holder->size - holder->free - 1));
-    uint8_t * ptr = (uint8_t*) holder->str + holder->size - holder->free - 1;
-    for (i = 0; i < len; i++)
+    case IOT_DATA_ARRAY:
+    {
+      uint32_t size = iot_data_type_size[plan->key_type];
+      if (count * size > (uint64_t) (reader->end - reader->ptr)) return NULL;
+      iot_data_t * array = iot_data_alloc_array ((void*) reader->ptr, (uint32_t) count, plan->key_type, IOT_DATA_COPY);
+      if (IOT_DATA_BIG_ENDIAN) iot_data_swap_bytes (((iot_data_array_t*) array)->data, count * size, size);
+      reader->ptr += count * size;
+      return array;
+    }
+    case IOT_DATA_MAP:
     {
-      uint8_t c = add[i];
-      switch (iot_data_repr_size (c))
+      iot_data_t * map = iot_data_alloc_map (plan->key_type);
+      for (uint64_t i = 0; i < count; i++)
       {
-        case 1:
+        iot_data_t * key = NULL;
+        iot_data_t * val = NULL;
+        uint64_t index = 0u;
+        if (schema->index && plan->key_type == IOT_DATA_STRING && (! iot_data_varint_read (reader, &index) || index > iot_data_vector_size (schema->keys)))
         {
-          *ptr++ = c;
-          break;
+          index = UINT64_MAX;
         }
-        case 2:
+        if (index == 0u)
         {
-          *ptr++ = '\\';
-          switch (c)
-          {
-            case '\"': *ptr++ = '\"'; break;
-            case '\\': *ptr++ = '\\'; break;
-            case '\b': *ptr++ = 'b'; break;
-            case '\f': *ptr++ = 'f'; break;
-            case '\n': *ptr++ = 'n'; break;
-            case '\r': *ptr++ = 'r'; break;
-            case '\t': *ptr++ = 't'; break;
-          }
-          break;
+          key = iot_data_schema_read_value (reader, plan->key_type);
         }
-        case 6:
+        else if (index != UINT64_MAX)
         {
-          *ptr++ = '\\';
-          *ptr++ = 'u';
-          *ptr++ = '0';
-          *ptr++ = '0';
-          *ptr++ = (c & 0x10u) ? '1' : '0';
-          *ptr++ = hex[c & 0x0fu];
-          break;
+          key = (iot_data_t*) iot_data_vector_get (schema->keys, (uint32_t) (index - 1u));
+          iot_data_add_ref (key);
+        }
+        if (key) val = iot_data_schema_read (schema, reader, plan->element);
+        if (! val)
+        {
+          iot_data_free (key);
+          iot_data_free (map);
+          return NULL;
+        }
+        iot_data_map_add (map, key, val);
+      }
+      return map;
+    }
+    default:
+    {
+      iot_data_t * vector = iot_data_alloc_vector ((uint32_t) count);
+      for (uint32_t i = 0; i < count; i++)
+      {
+        iot_data_t * val = iot_data_schema_read (schema, reader, plan->element);
+        if (! val)
+        {
+          iot_data_free (vector);
+          return NULL;
         }
+        iot_data_vector_add (vector, i, val);
       }
+      return vector;
     }
-    *ptr = '\0';
   }
-  holder->free -= adj_len;
 }
 
-static inline void iot_data_strcat (iot_string_holder_t * holder, const char * add)
+iot_data_t * iot_data_schema_decode (const iot_data_schema_t * schema, const uint8_t * buff, uint32_t size)
 {
-  iot_data_strcat_escape (holder, add, true);
+  assert (schema && buff);
+  iot_data_cbor_reader_t reader = { .ptr = buff, .end = buff + size };
+  iot_data_t * data = iot_data_schema_read (schema, &reader, 0u);
+  if (data && reader.ptr != reader.end)
+  {
+    iot_data_free (data);
+    data = NULL;
+  }
+  return data;
 }
 
-static inline void iot_data_add_quote (iot_string_holder_t * holder)
+// Snapshots, flat position independent images of data that can be accessed in place, for example when memory
+// mapped. Nodes are 8 byte aligned and written depth first, so a container follows its elements, which are
+// referenced by their offset back from the container. Map pairs are in insertion order, with an open addressing
+// hash index of pairs following them. Metadata is not included.
+
+#define IOT_DATA_SNAPSHOT_MAGIC "IOTS"
+#define IOT_DATA_SNAPSHOT_VERSION 1u
+#define IOT_DATA_SNAPSHOT_ORDER 0x0102u
+#define IOT_DATA_SNAPSHOT_BUFF_SIZE 4096u
+
+struct iot_data_snapshot_t
 {
-  iot_data_strcat_escape (holder, "\"", false);
-}
+  uint8_t type;                       // Data type
+  uint8_t sub_type;                   // Array element type or map key type
+  uint16_t reserved;
+  uint32_t size;                      // String or array length, number of vector elements or map pairs
+  uint64_t data [];                   // Value, string, array data, vector element offsets or map index
+};
 
-static void iot_data_base64_encode (iot_string_holder_t * holder, const iot_data_t * array)
+typedef struct iot_data_snapshot_header_t
 {
-  uint32_t inLen = iot_data_array_size (array);
-  const uint8_t * data = iot_data_address (array);
-  assert (strlen (holder->str) == (holder->size - holder->free - 1));
-  size_t len = iot_b64_encodesize (inLen) - 1; /* Allow for string terminator */
-  char * out;
+  char magic [4];
+  uint16_t version;
+  uint16_t order;                     // Detects image written with other byte order
+  uint32_t size;                      // Image size
+  uint32_t root;                      // Root node offset
+} iot_data_snapshot_header_t;
 
-  if (holder->free < len)
-  {
-    iot_data_holder_realloc (holder, len);
-  }
+typedef struct iot_data_snapshot_map_t
+{
+  uint32_t mask;                      // Index size less one
+  uint32_t reserved;
+  uint32_t pairs [];                  // Key and value offset of each pair, followed by index slots
+} iot_data_snapshot_map_t;
+
+typedef struct iot_data_snapshot_slot_t
+{
+  uint32_t hash;                      // Key hash
+  uint32_t pair;                      // Pair number plus one, zero if empty
+} iot_data_snapshot_slot_t;
+
+#define IOT_DATA_SNAPSHOT_REF(n,off) ((const iot_data_snapshot_t*) ((const uint8_t*) (n) - (off)))
 
-  out = holder->str + holder->size - holder->free - 1;
-  iot_b64_encode (data, inLen, out, holder->free + 1);
-  holder->free -= len;
-  assert (strlen (holder->str) == (holder->size - holder->free - 1));
+static inline const iot_data_snapshot_map_t * iot_data_snapshot_map (const iot_data_snapshot_t * node)
+{
+  return (const void*) node->data;
 }
 
-static void iot_data_dump_raw (iot_string_holder_t * holder, const iot_data_t * data)
+static inline const iot_data_snapshot_slot_t * iot_data_snapshot_slots (const iot_data_snapshot_map_t * map, uint32_t size)
 {
-  char buff [IOT_VAL_BUFF_SIZE];
+  return (const iot_data_snapshot_slot_t*) &map->pairs[2u * size];
+}
 
-  switch (data->type)
-  {
-    case IOT_DATA_INT8: sprintf (buff, "%" PRId8 , iot_data_i8 (data)); break;
-    case IOT_DATA_UINT8: sprintf (buff, "%" PRIu8, iot_data_ui8 (data)); break;
-    case IOT_DATA_INT16: sprintf (buff, "%" PRId16, iot_data_i16 (data)); break;
-    case IOT_DATA_UINT16: sprintf (buff, "%" PRIu16, iot_data_ui16 (data)); break;
-    case IOT_DATA_INT32: sprintf (buff, "%" PRId32, iot_data_i32 (data)); break;
-    case IOT_DATA_UINT32: sprintf (buff, "%" PRIu32, iot_data_ui32 (data)); break;
-    case IOT_DATA_INT64: sprintf (buff, "%" PRId64, iot_data_i64 (data)); break;
-    case IOT_DATA_UINT64: sprintf (buff, "%" PRIu64, iot_data_ui64 (data)); break;
-    case IOT_DATA_FLOAT32: snprintf (buff, IOT_VAL_BUFF_SIZE, "%.8e", iot_data_f32 (data)); break;
-    case IOT_DATA_FLOAT64: snprintf (buff, IOT_VAL_BUFF_SIZE, "%.16e", iot_data_f64 (data)); break;
-    default: strcpy (buff, iot_data_bool (data) ? "true" : "false"); break;
-  }
-  iot_data_strcat_escape (holder, buff, false);
+static iot_data_snapshot_t * iot_data_snapshot_node (iot_string_holder_t * holder, const iot_data_t * data, size_t payload, uint32_t * offset)
+{
+  size_t pad = (8u - (holder->len & 7u)) & 7u;
+  size_t len = pad + sizeof (iot_data_snapshot_t) + payload;
+  iot_data_holder_reserve (holder, len);
+  memset (holder->str + holder->len, 0, len);
+  *offset = (uint32_t) (holder->len + pad);
+  holder->len += len;
+  iot_data_snapshot_t * node = (iot_data_snapshot_t*) (holder->str + *offset);
+  node->type = (uint8_t) data->type;
+  return node;
 }
 
-static void iot_data_dump (iot_string_holder_t * holder, const iot_data_t * data)
+static uint32_t iot_data_snapshot_write (iot_string_holder_t * holder, const iot_data_t * data)
 {
+  uint32_t offset;
+  iot_data_snapshot_t * node;
+  iot_data_lazy_check (data);
   switch (data->type)
   {
     case IOT_DATA_STRING:
     {
-      iot_data_add_quote (holder);
-      iot_data_strcat (holder, iot_data_string (data));
-      iot_data_add_quote (holder);
+      const char * str = iot_data_string (data);
+      size_t len = strlen (str);
+      node = iot_data_snapshot_node (holder, data, len + 1u, &offset);
+      memcpy (node->data, str, len);
+      node->size = (uint32_t) len;
       break;
     }
     case IOT_DATA_ARRAY:
     {
-      iot_data_add_quote (holder);
-      iot_data_base64_encode (holder, data);
-      iot_data_add_quote (holder);
+      const iot_data_array_t * array = (const iot_data_array_t*) data;
+      node = iot_data_snapshot_node (holder, data, IOT_DATA_ARRAY_SIZE (array), &offset);
+      memcpy (node->data, array->data, IOT_DATA_ARRAY_SIZE (array));
+      node->sub_type = (uint8_t) array->type;
+      node->size = array->length;
+      break;
+    }
+    case IOT_DATA_VECTOR:
+    {
+      const iot_data_vector_t * vector = (const iot_data_vector_t*) data;
+      uint32_t * elements = malloc (vector->size * sizeof (uint32_t) + 1u);
+      for (uint32_t i = 0; i < vector->size; i++) elements[i] = iot_data_snapshot_write (holder, vector->values[i]);
+      node = iot_data_snapshot_node (holder, data, vector->size * sizeof (uint32_t), &offset);
+      uint32_t * refs = (uint32_t*) node->data;
+      for (uint32_t i = 0; i < vector->size; i++) refs[i] = offset - elements[i];
+      node->size = vector->size;
+      free (elements);
       break;
     }
     case IOT_DATA_MAP:
     {
-      iot_data_map_iter_t iter;
-      iot_data_map_iter (data, &iter);
-      iot_data_strcat (holder, "{");
-      while (iot_data_map_iter_next (&iter))
+      const iot_data_map_t * map = (const iot_data_map_t*) data;
+      uint32_t * pairs = malloc (map->size * 2u * sizeof (uint32_t) + 1u);
+      uint32_t mask = 0u;
+      uint32_t n = 0u;
+      for (const iot_data_pair_t * pair = map->head; pair; pair = (const iot_data_pair_t*) pair->base.next)
       {
-        const iot_data_t * key = iot_data_map_iter_key (&iter);
-        const iot_data_t * value = iot_data_map_iter_value (&iter);
-        if (iot_data_type (key) != IOT_DATA_STRING) iot_data_add_quote (holder);
-        iot_data_dump (holder, key);
-        if (iot_data_type (key) != IOT_DATA_STRING) iot_data_add_quote (holder);
-        iot_data_strcat (holder, ":");
-        iot_data_dump (holder, value);
-        if (iter.pair->base.next)
-        {
-          iot_data_strcat (holder, ",");
-        }
+        pairs[n++] = iot_data_snapshot_write (holder, pair->key);
+        pairs[n++] = iot_data_snapshot_write (holder, pair->value);
+      }
+      if (map->size) while (mask + 1u < map->size * 2u) mask = mask * 2u + 1u; // Keep load factor no more than 0.5
+      size_t len = sizeof (iot_data_snapshot_map_t) + 2u * map->size * sizeof (uint32_t);
+      node = iot_data_snapshot_node (holder, data, len + (map->size ? (mask + 1u) * sizeof (iot_data_snapshot_slot_t) : 0u), &offset);
+      iot_data_snapshot_map_t * smap = (iot_data_snapshot_map_t*) node->data;
+      iot_data_snapshot_slot_t * slots = (iot_data_snapshot_slot_t*) iot_data_snapshot_slots (smap, map->size);
+      smap->mask = mask;
+      n = 0u;
+      for (const iot_data_pair_t * pair = map->head; pair; pair = (const iot_data_pair_t*) pair->base.next, n++)
+      {
+        smap->pairs[2u * n] = offset - pairs[2u * n];
+        smap->pairs[2u * n + 1u] = offset - pairs[2u * n + 1u];
+        uint32_t hash = iot_data_hash (pair->key);
+        uint32_t i = hash & mask;
+        while (slots[i].pair) i = (i + 1u) & mask;
+        slots[i].hash = hash;
+        slots[i].pair = n + 1u;
       }
-      iot_data_strcat (holder, "}");
+      node->sub_type = (uint8_t) map->key_type;
+      node->size = map->size;
+      free (pairs);
       break;
     }
-    case IOT_DATA_VECTOR:
+    default:
     {
-      iot_data_vector_iter_t iter;
-      iot_data_vector_iter (data, &iter);
-      iot_data_strcat (holder, "[");
-      while (iot_data_vector_iter_next (&iter))
-      {
-        const iot_data_t * value = iot_data_vector_iter_value (&iter);
-        iot_data_dump (holder, value);
-        if (iter.index < iter.vector->size)
-        {
-          iot_data_strcat (holder, ",");
-        }
-      }
-      iot_data_strcat (holder, "]");
+      node = iot_data_snapshot_node (holder, data, sizeof (uint64_t), &offset);
+      memcpy (node->data, &((const iot_data_value_t*) data)->value, sizeof (uint64_t));
       break;
     }
-    default: iot_data_dump_raw (holder, data);
   }
+  return offset;
 }
 
-char * iot_data_to_json (const iot_data_t * data)
+uint8_t * iot_data_to_snapshot (const iot_data_t * data, uint32_t * size)
 {
-  return iot_data_to_json_with_size (data, IOT_JSON_BUFF_SIZE);
+  iot_string_holder_t holder;
+  assert (data && size);
+  iot_data_holder_init (&holder, IOT_DATA_SNAPSHOT_BUFF_SIZE, NULL, NULL);
+  holder.len = sizeof (iot_data_snapshot_header_t);
+  uint32_t root = iot_data_snapshot_write (&holder, data);
+  iot_data_snapshot_header_t * header = (iot_data_snapshot_header_t*) holder.str;
+  memcpy (header->magic, IOT_DATA_SNAPSHOT_MAGIC, sizeof (header->magic));
+  header->version = IOT_DATA_SNAPSHOT_VERSION;
+  header->order = IOT_DATA_SNAPSHOT_ORDER;
+  header->size = (uint32_t) holder.len;
+  header->root = root;
+  *size = (uint32_t) holder.len;
+  return (uint8_t*) holder.str;
 }
 
-char * iot_data_to_json_with_size (const iot_data_t * data, uint32_t size)
+const iot_data_snapshot_t * iot_data_snapshot_root (const void * image, size_t size)
 {
-  iot_string_holder_t holder;
-  assert (data && size > 0);
-  holder.str = calloc (1, size);
-  holder.size = size;
-  holder.free = size - 1; // Allowing for string terminator
-  iot_data_dump (&holder, data);
-  return holder.str;
+  assert (image);
+  const iot_data_snapshot_header_t * header = (const iot_data_snapshot_header_t*) image;
+  bool valid = (size >= sizeof (*header)) && (memcmp (header->magic, IOT_DATA_SNAPSHOT_MAGIC, sizeof (header->magic)) == 0) &&
+    (header->version == IOT_DATA_SNAPSHOT_VERSION) && (header->order == IOT_DATA_SNAPSHOT_ORDER) && (header->size == size) &&
+    (header->root >= sizeof (*header)) && (header->root + sizeof (iot_data_snapshot_t) <= size) && ((header->root & 7u) == 0u);
+  return valid ? (const iot_data_snapshot_t*) ((const uint8_t*) image + header->root) : NULL;
 }
 
-static char * iot_data_string_from_json_token (const char * json, iot_json_tok_t * token)
+iot_data_type_t iot_data_snapshot_type (const iot_data_snapshot_t * snapshot)
 {
-  size_t len = (size_t) (token->end - token->start);
-  char * str = malloc (len + 1);
-  memcpy (str, json + token->start, len);
-  str[len] = 0;
-  return str;
+  assert (snapshot);
+  return (iot_data_type_t) snapshot->type;
 }
 
-static iot_data_t * iot_data_string_from_json (iot_json_tok_t ** tokens, const char * json)
+uint32_t iot_data_snapshot_size (const iot_data_snapshot_t * snapshot)
 {
-  char * str = iot_data_string_from_json_token (json, *tokens);
-  (*tokens)++;
-  return iot_data_alloc_string (str, IOT_DATA_TAKE);
+  assert (snapshot && snapshot->type >= IOT_DATA_STRING);
+  return snapshot->size;
 }
 
-static iot_data_t * iot_data_primitive_from_json (iot_json_tok_t ** tokens, const char * json)
+const void * iot_data_snapshot_address (const iot_data_snapshot_t * snapshot)
 {
-  iot_data_t * ret;
-  char * str = iot_data_string_from_json_token (json, *tokens);
-  (*tokens)++;
-  switch (str[0])
-  {
-    case 't': case 'f': ret = iot_data_alloc_bool (str[0] == 't'); break; // true/false
-    case 'n': ret = iot_data_alloc_string ("null", IOT_DATA_REF); break; // null
-    default: // Handle all floating point numbers as doubles and integers as uint64_t
-      ret = (strchr (str, '.') || strchr (str, 'e') || strchr (str, 'E')) ?
-        iot_data_alloc_f64 (strtod (str, NULL)) : iot_data_alloc_i64 (strtol (str, NULL, 0));
-      break;
-  }
-  free (str);
-  return ret;
+  assert (snapshot);
+  return (snapshot->type <= IOT_DATA_ARRAY) ? snapshot->data : NULL;
 }
 
-static iot_data_t * iot_data_map_from_json (iot_json_tok_t ** tokens, const char * json)
+const char * iot_data_snapshot_string (const iot_data_snapshot_t * snapshot)
 {
-  uint32_t elements = (*tokens)->size;
-  iot_data_t * map = iot_data_alloc_map (IOT_DATA_STRING);
+  assert (snapshot);
+  return (snapshot->type == IOT_DATA_STRING) ? (const char*) snapshot->data : NULL;
+}
 
-  (*tokens)++;
-  while  (elements--)
-  {
-    iot_data_t * key = iot_data_string_from_json (tokens, json);
-    iot_data_map_add (map, key, iot_data_all_from_json (tokens, json));
-  }
-  return map;
+iot_data_type_t iot_data_snapshot_array_type (const iot_data_snapshot_t * snapshot)
+{
+  assert (snapshot && snapshot->type == IOT_DATA_ARRAY);
+  return (iot_data_type_t) snapshot->sub_type;
 }
 
-static iot_data_t * iot_data_vector_from_json (iot_json_tok_t ** tokens, const char * json)
+iot_data_type_t iot_data_snapshot_map_key_type (const iot_data_snapshot_t * snapshot)
 {
-  uint32_t elements = (*tokens)->size;
-  uint32_t index = 0;
-  iot_data_t * vector = iot_data_alloc_vector (elements);
+  assert (snapshot && snapshot->type == IOT_DATA_MAP);
+  return (iot_data_type_t) snapshot->sub_type;
+}
 
-  (*tokens)++;
-  while (elements--)
-  {
-    iot_data_vector_add (vector, index++, iot_data_all_from_json (tokens, json));
-  }
-  return vector;
+const iot_data_snapshot_t * iot_data_snapshot_vector_get (const iot_data_snapshot_t * vector, uint32_t index)
+{
+  assert (vector && vector->type == IOT_DATA_VECTOR && index < vector->size);
+  return IOT_DATA_SNAPSHOT_REF (vector, ((const uint32_t*) vector->data)[index]);
 }
 
-static iot_data_t * iot_data_all_from_json (iot_json_tok_t ** tokens, const char * json)
+const iot_data_snapshot_t * iot_data_snapshot_map_key (const iot_data_snapshot_t * map, uint32_t index)
 {
-  iot_data_t * data = NULL;
-  switch ((*tokens)->type)
-  {
-    case IOT_JSON_PRIMITIVE: data = iot_data_primitive_from_json (tokens, json); break;
-    case IOT_JSON_OBJECT: data = iot_data_map_from_json (tokens, json); break;
-    case IOT_JSON_ARRAY: data = iot_data_vector_from_json (tokens, json); break;
-    default: data = iot_data_string_from_json (tokens, json); break;
-  }
-  return data;
+  assert (map && map->type == IOT_DATA_MAP && index < map->size);
+  return IOT_DATA_SNAPSHOT_REF (map, iot_data_snapshot_map (map)->pairs[2u * index]);
 }
 
-iot_data_t * iot_data_from_json (const char * json)
+const iot_data_snapshot_t * iot_data_snapshot_map_value (const iot_data_snapshot_t * map, uint32_t index)
 {
-  iot_json_parser parser;
-  iot_data_t * data = NULL;
-  int32_t used;
-  const char * ptr = json;
-  uint32_t count = 1;
+  assert (map && map->type == IOT_DATA_MAP && index < map->size);
+  return IOT_DATA_SNAPSHOT_REF (map, iot_data_snapshot_map (map)->pairs[2u * index + 1u]);
+}
+
+// Find map value by key hash, keys compared as strings if str is set, otherwise with key data
 
-  // Approximate token count
-  while (*ptr != '\0')
+static const iot_data_snapshot_t * iot_data_snapshot_find (const iot_data_snapshot_t * map, uint32_t hash, const char * str, const iot_data_t * key)
+{
+  const iot_data_snapshot_map_t * smap = iot_data_snapshot_map (map);
+  const iot_data_snapshot_slot_t * slots = iot_data_snapshot_slots (smap, map->size);
+  if (map->size == 0u) return NULL;
+  for (uint32_t i = hash & smap->mask; slots[i].pair; i = (i + 1u) & smap->mask)
   {
-    switch (*ptr)
+    if (slots[i].hash != hash) continue;
+    const iot_data_snapshot_t * node = IOT_DATA_SNAPSHOT_REF (map, smap->pairs[2u * (slots[i].pair - 1u)]);
+    bool match;
+    if (str)
     {
-      case ',': case '{': count++; break;
-      case ':': case '[': count += 2; break;
-      default: break;
+      match = (strcmp ((const char*) node->data, str) == 0);
     }
-    ptr++;
+    else if (key->type == IOT_DATA_ARRAY)
+    {
+      const iot_data_array_t * array = (const iot_data_array_t*) key;
+      match = (node->sub_type == array->type) && (node->size == array->length) && (memcmp (node->data, array->data, IOT_DATA_ARRAY_SIZE (array)) == 0);
+    }
+    else
+    {
+      match = (memcmp (node->data, &((const iot_data_value_t*) key)->value, sizeof (uint64_t)) == 0);
+    }
+    if (match) return IOT_DATA_SNAPSHOT_REF (map, smap->pairs[2u * (slots[i].pair - 1u) + 1u]);
   }
-  iot_json_tok_t * tokens = calloc (1, sizeof (*tokens) * count);
-  iot_json_tok_t * tptr = tokens;
+  return NULL;
+}
 
-  iot_json_init (&parser);
-  used = iot_json_parse (&parser, json, strlen (json), tptr, count);
-  if (used)
-  {
-    assert (used <= count);
-    data = iot_data_all_from_json (&tptr, json);
-  }
-  free (tokens);
-  return data;
+const iot_data_snapshot_t * iot_data_snapshot_map_get (const iot_data_snapshot_t * map, const iot_data_t * key)
+{
+  assert (map && map->type == IOT_DATA_MAP && key);
+  if (key->type != map->sub_type) return NULL;
+  if (key->type == IOT_DATA_STRING) return iot_data_snapshot_find (map, iot_data_hash (key), iot_data_string (key), NULL);
+  return iot_data_snapshot_find (map, iot_data_hash (key), NULL, key);
 }
 
-#ifdef IOT_HAS_XML
-static iot_data_t * iot_data_map_from_xml (bool root, yxml_t * x, iot_string_holder_t * holder, const char ** str)
+const iot_data_snapshot_t * iot_data_snapshot_string_map_get (const iot_data_snapshot_t * map, const char * key)
 {
-  iot_data_t * elem = iot_data_alloc_map (IOT_DATA_STRING);
-  iot_data_t * children = NULL;
-  iot_data_t * attrs = iot_data_alloc_map (IOT_DATA_STRING);
-  char * elem_name = x->elem;
-  bool more = true;
-  holder->str[0] = '\0';
-  holder->free = holder->size - 1;
-  iot_data_string_map_add (elem, "name", iot_data_alloc_string (elem_name, IOT_DATA_COPY));
-  iot_data_string_map_add (elem, "attributes", attrs);
-  while (more && **str)
+  assert (map && map->type == IOT_DATA_MAP && key);
+  return (map->sub_type == IOT_DATA_STRING) ? iot_data_snapshot_find (map, iot_hash (key), key, NULL) : NULL;
+}
+
+iot_data_t * iot_data_snapshot_copy (const iot_data_snapshot_t * snapshot)
+{
+  assert (snapshot);
+  iot_data_t * data;
+  switch (snapshot->type)
   {
-    switch (yxml_parse (x, *(*str)++))
+    case IOT_DATA_STRING: data = iot_data_json_string ((const char*) snapshot->data, snapshot->size); break;
+    case IOT_DATA_ARRAY: data = iot_data_alloc_array ((void*) snapshot->data, snapshot->size, (iot_data_type_t) snapshot->sub_type, IOT_DATA_COPY); break;
+    case IOT_DATA_VECTOR:
     {
-      case YXML_ELEMSTART:
-      {
-        iot_data_t * child = iot_data_map_from_xml (false, x, holder, str);
-        if (child)
-        {
-          if (root)
-          {
-            iot_data_free (elem);
-            elem = child;
-            more = false;
-          }
-          else
-          {
-            uint32_t size;
-            if (!children)
-            {
-              children = iot_data_alloc_vector (1);
-              iot_data_string_map_add (elem, "children", children);
-              size = 0;
-            }
-            else
-            {
-              size = iot_data_vector_size (children);
-              iot_data_vector_resize (children, size + 1);
-            }
-            iot_data_vector_add (children, size, child);
-          }
-        }
-        else
-        {
-          iot_data_free (elem);
-          elem = NULL;
-          more = false;
-        }
-        break;
-      }
-      case YXML_ELEMEND:
-      {
-        if (holder->str[0] != '\0')
-        {
-          iot_data_string_map_add (elem, "content", iot_data_alloc_string (holder->str, IOT_DATA_COPY));
-          holder->str[0] = '\0';
-          holder->free = holder->size - 1;
-        }
-        more = false;
-        break;
-      }
-      case YXML_ATTRVAL:
-      case YXML_CONTENT:
-      {
-        iot_data_strcat_escape (holder, x->data, false);
-        break;
-      }
-      case YXML_ATTREND:
-      {
-        iot_data_map_add (attrs, iot_data_alloc_string (x->attr, IOT_DATA_COPY), iot_data_alloc_string (holder->str, IOT_DATA_COPY));
-        holder->str[0] = '\0';
-        holder->free = holder->size - 1;
-        break;
-      }
-      case YXML_EEOF:
-      case YXML_EREF:
-      case YXML_ECLOSE:
-      case YXML_ESTACK:
-      case YXML_ESYN:
+      data = iot_data_alloc_vector (snapshot->size);
+      for (uint32_t i = 0; i < snapshot->size; i++)
       {
-        // Error
-        iot_data_free (elem);
-        elem = NULL;
-        more = false;
-        break;
+        iot_data_vector_add (data, i, iot_data_snapshot_copy (iot_data_snapshot_vector_get (snapshot, i)));
       }
-      default:
+      break;
+    }
+    case IOT_DATA_MAP:
+    {
+      data = iot_data_alloc_map ((iot_data_type_t) snapshot->sub_type);
+      for (uint32_t i = 0; i < snapshot->size; i++)
       {
-        break;
+        iot_data_map_add (data, iot_data_snapshot_copy (iot_data_snapshot_map_key (snapshot, i)), iot_data_snapshot_copy (iot_data_snapshot_map_value (snapshot, i)));
       }
+      break;
+    }
+    default:
+    {
+      iot_data_value_t * val = iot_data_value_alloc ((iot_data_type_t) snapshot->type, false);
+      memcpy (&val->value, snapshot->data, sizeof (uint64_t));
+      data = (iot_data_t*) val;
+      break;
     }
   }
-
-  return elem;
-}
-
-iot_data_t * iot_data_from_xml (const char * xml)
-{
-  iot_data_t * result;
-  yxml_t * x = malloc (sizeof (yxml_t) + YXML_PARSER_BUFF_SIZE);
-  iot_string_holder_t holder;
-  holder.str = calloc (1, YXML_BUFF_SIZE);
-  holder.size = YXML_BUFF_SIZE;
-  holder.free = YXML_BUFF_SIZE - 1; // Allowing for string terminator
-  yxml_init (x, x+1, YXML_PARSER_BUFF_SIZE);
-  result = iot_data_map_from_xml (true, x, &holder, &xml);
-  free (x);
-  free (holder.str);
-  return result;
+  return data;
 }
-#endif
 
 iot_data_t * iot_data_copy (const iot_data_t * src)
 {
@@ -1594,7 +4881,21 @@ iot_data_t * iot_data_copy (const iot_data_t * src)
     case IOT_DATA_STRING:
     {
       iot_data_value_t * val = (iot_data_value_t *) data;
-      ret = iot_data_alloc_string (val->value.str, val->base.release ? IOT_DATA_COPY : IOT_DATA_REF);
+      if (data->interned)
+      {
+        ret = (iot_data_t*) iot_data_value_alloc (IOT_DATA_STRING, IOT_DATA_REF);
+        ((iot_data_value_t*) ret)->value.str = val->value.str;
+        ((iot_data_value_t*) ret)->hash = val->hash;
+        ret->interned = true;
+      }
+      else if (data->view && ! val->owner->arena)
+      {
+        ret = iot_data_string_view (val->owner, val->value.str);
+      }
+      else
+      {
+        ret = iot_data_alloc_string (val->value.str, (val->base.release || data->view) ? IOT_DATA_COPY : IOT_DATA_REF);
+      }
       break;
     }
     case IOT_DATA_ARRAY:
@@ -1606,6 +4907,11 @@ iot_data_t * iot_data_copy (const iot_data_t * src)
     case IOT_DATA_MAP:
     {
       iot_data_map_iter_t iter;
+      if (data->lazy && ! iot_data_arena_current) // Unbuilt map copied as sharing the tokenized json
+      {
+        ret = iot_data_lazy_alloc (iot_data_lazy_of (data)->doc, iot_data_lazy_of (data)->token);
+        break;
+      }
       ret = iot_data_alloc_map (iot_data_map_key_type (src));
 
       iot_data_map_iter (src, &iter);
@@ -1620,6 +4926,11 @@ iot_data_t * iot_data_copy (const iot_data_t * src)
     case IOT_DATA_VECTOR:
     {
       iot_data_vector_iter_t iter;
+      if (data->lazy && ! iot_data_arena_current)
+      {
+        ret = iot_data_lazy_alloc (iot_data_lazy_of (data)->doc, iot_data_lazy_of (data)->token);
+        break;
+      }
       ret = iot_data_alloc_vector (iot_data_vector_size (src));
 
       iot_data_vector_iter (src, &iter);
@@ -1637,7 +4948,16 @@ iot_data_t * iot_data_copy (const iot_data_t * src)
       ret = (iot_data_t*) val;
     }
   }
-  iot_data_set_metadata (ret, data->metadata);
+  if (data->metadata && data->metadata->arena && ! ret->arena) // Arena metadata copied out of arena
+  {
+    iot_data_t * metadata = iot_data_copy (data->metadata);
+    iot_data_set_metadata (ret, metadata);
+    iot_data_free (metadata);
+  }
+  else
+  {
+    iot_data_set_metadata (ret, data->metadata);
+  }
   return ret;
 }
 
@@ -1671,7 +4991,7 @@ extern iot_typecode_t * iot_typecode_alloc_array (iot_data_type_t element_type)
 
 extern iot_typecode_t * iot_typecode_alloc_map (iot_data_type_t key_type, iot_typecode_t * element_type)
 {
-  iot_typecode_t * tc = iot_data_block_alloc ();
+  iot_typecode_t * tc = iot_data_block_alloc (IOT_DATA_BLOCK_SMALL);
   tc->type = IOT_DATA_MAP;
   tc->key_type = key_type;
   tc->element_type = element_type;
@@ -1680,7 +5000,7 @@ extern iot_typecode_t * iot_typecode_alloc_map (iot_data_type_t key_type, iot_ty
 
 extern iot_typecode_t * iot_typecode_alloc_vector (iot_typecode_t * element_type)
 {
-  iot_typecode_t * tc = iot_data_block_alloc ();
+  iot_typecode_t * tc = iot_data_block_alloc (IOT_DATA_BLOCK_SMALL);
   tc->type = IOT_DATA_VECTOR;
   tc->element_type = element_type;
   return tc;
@@ -1690,7 +5010,7 @@ extern void iot_typecode_free (iot_typecode_t * typecode)
 {
   if (typecode && (typecode->type > IOT_DATA_ARRAY))
   {
-    iot_data_block_free ((iot_data_t*) typecode);
+    iot_data_block_free (typecode, IOT_DATA_BLOCK_SMALL);
   }
 }
 
@@ -1750,7 +5070,7 @@ extern iot_typecode_t * iot_data_typecode (const iot_data_t * data)
   }
   else
   {
-    tc = iot_data_block_alloc ();
+    tc = iot_data_block_alloc (IOT_DATA_BLOCK_SMALL);
     tc->type = type;
     if (type == IOT_DATA_MAP)
     {
@@ -6,6 +6,11 @@
  */
 
 #include "iot/iot.h"
+#ifdef IOT_HAS_FILE
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
 #ifdef _AZURESPHERE_
 #include <applibs/log.h>
 #include <applibs/storage.h>
@@ -70,6 +75,29 @@ uint8_t * iot_file_read_binary (const char * path, size_t * len)
   if (len) *len = size;
   return ret;
 }
+
+const uint8_t * iot_file_map (const char * path, size_t * len)
+{
+  void * addr = NULL;
+  struct stat st;
+  int fd = open (path, O_RDONLY);
+  if (fd != -1)
+  {
+    if ((fstat (fd, &st) == 0) && (st.st_size > 0))
+    {
+      addr = mmap (NULL, (size_t) st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+      if (addr == MAP_FAILED) addr = NULL;
+    }
+    close (fd);
+  }
+  if (len) *len = addr ? (size_t) st.st_size : 0u;
+  return addr;
+}
+
+void iot_file_unmap (const uint8_t * addr, size_t len)
+{
+  if (addr) munmap ((void*) addr, len);
+}
 #else
 #ifdef _AZURESPHERE_
 
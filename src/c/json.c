@@ -20,6 +20,7 @@ static iot_json_tok_t * iot_json_alloc_token (iot_json_parser *parser, iot_json_
     tok = &tokens[parser->toknext++];
     tok->start = tok->end = -1;
     tok->size = 0;
+    tok->parent = -1;
   }
   return tok;
 }
@@ -85,6 +86,7 @@ found:
     return IOT_JSON_ERROR_NOMEM;
   }
   iot_json_fill_token (token, IOT_JSON_PRIMITIVE, start, parser->pos);
+  token->parent = parser->toksuper;
   parser->pos--;
   return 0;
 }
@@ -117,6 +119,7 @@ static int iot_json_parse_string (iot_json_parser *parser, const char *js, size_
         return IOT_JSON_ERROR_NOMEM;
       }
       iot_json_fill_token (token, IOT_JSON_STRING, start + 1, parser->pos);
+      token->parent = parser->toksuper;
       return 0;
     }
 
@@ -198,6 +201,7 @@ int iot_json_parse (iot_json_parser *parser, const char * json, size_t len, iot_
         }
         token->type = (c == '{' ? IOT_JSON_OBJECT : IOT_JSON_ARRAY);
         token->start = (int32_t) parser->pos;
+        token->parent = parser->toksuper;
         parser->toksuper = parser->toknext - 1;
         break;
       case '}': case ']':
@@ -207,28 +211,20 @@ int iot_json_parse (iot_json_parser *parser, const char * json, size_t len, iot_
         }
         type = (c == '}' ? IOT_JSON_OBJECT : IOT_JSON_ARRAY);
 
-        for (i = parser->toknext - 1; i >= 0; i--)
+        /* Follow parent links from current superior token to innermost open object or array */
+        for (i = parser->toksuper; i != -1; i = tokens[i].parent)
         {
           token = &tokens[i];
           if (token->start != -1 && token->end == -1)
           {
             if (token->type != type) return IOT_JSON_ERROR_INVAL;
-            parser->toksuper = -1;
             token->end = (int32_t) (parser->pos + 1);
+            parser->toksuper = token->parent;
             break;
           }
         }
         /* Error if unmatched closing bracket */
         if (i == -1) return IOT_JSON_ERROR_INVAL;
-        for (; i >= 0; i--)
-        {
-          token = &tokens[i];
-          if (token->start != -1 && token->end == -1)
-          {
-            parser->toksuper = i;
-            break;
-          }
-        }
         break;
       case '\"':
         r = iot_json_parse_string (parser, json, len, tokens, num_tokens);
@@ -252,17 +248,7 @@ int iot_json_parse (iot_json_parser *parser, const char * json, size_t len, iot_
             tokens[parser->toksuper].type != IOT_JSON_ARRAY &&
             tokens[parser->toksuper].type != IOT_JSON_OBJECT)
         {
-          for (i = parser->toknext - 1; i >= 0; i--)
-          {
-            if (tokens[i].type == IOT_JSON_ARRAY || tokens[i].type == IOT_JSON_OBJECT)
-            {
-              if (tokens[i].start != -1 && tokens[i].end == -1)
-              {
-                parser->toksuper = i;
-                break;
-              }
-            }
-          }
+          parser->toksuper = tokens[parser->toksuper].parent;
         }
         break;
 #ifdef JSON_STRICT
@@ -301,9 +287,9 @@ int iot_json_parse (iot_json_parser *parser, const char * json, size_t len, iot_
 
   if (tokens != NULL)
   {
-    for (i = parser->toknext - 1; i >= 0; i--)
+    /* Unmatched opened object or array */
+    for (i = parser->toksuper; i != -1; i = tokens[i].parent)
     {
-      /* Unmatched opened object or array */
       if (tokens[i].start != -1 && tokens[i].end == -1)
       {
         return IOT_JSON_ERROR_PART;
@@ -325,3 +311,446 @@ void iot_json_init (iot_json_parser *parser)
   parser->toksuper = -1;
 }
 
+
+/*
+ * Event parser. Input is pushed a chunk at a time with lexer and nesting state held in the parser
+ * between chunks, and handler functions are called for each JSON element as it completes. Strings
+ * and primitives wholly within a chunk are passed directly from it (unescaped in the token buffer if
+ * required), only tokens split across chunks are accumulated in the token buffer. Parsing is lenient:
+ * commas are optional and object keys may be unquoted.
+ */
+
+#define IOT_JSON_SAX_BUFF_SIZE 64u
+#define IOT_JSON_SAX_MAX_DEPTH 512u
+
+typedef enum iot_json_lex_t
+{
+  IOT_JSON_LEX_VALUE = 0,          /* Between tokens */
+  IOT_JSON_LEX_STRING = 1,         /* In string */
+  IOT_JSON_LEX_ESCAPE = 2,         /* In string, following backslash */
+  IOT_JSON_LEX_PRIMITIVE = 3       /* In primitive or unquoted key */
+} iot_json_lex_t;
+
+typedef enum iot_json_expect_t
+{
+  IOT_JSON_EXPECT_VALUE = 0,       /* Value, or end of array */
+  IOT_JSON_EXPECT_KEY = 1,         /* Object key, or end of object */
+  IOT_JSON_EXPECT_COLON = 2        /* Colon following object key */
+} iot_json_expect_t;
+
+struct iot_json_sax_t
+{
+  const iot_json_handler_t * handler;      /* Event handler functions */
+  void * arg;                              /* Handler function argument */
+  char * buff;                             /* Token buffer */
+  size_t len;                              /* Token buffer length */
+  size_t size;                             /* Token buffer size */
+  int status;                              /* Zero, or error once parsing has failed */
+  uint32_t depth;                          /* Number of open objects and arrays */
+  iot_json_lex_t lex;                      /* Lexer state */
+  iot_json_expect_t expect;                /* Next expected element */
+  bool escaped;                            /* Whether current string contains escapes */
+  bool object [IOT_JSON_SAX_MAX_DEPTH];        /* Whether each open container is an object */
+};
+
+static inline bool iot_json_delimiter (char c)
+{
+  return (c == '\0' || c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == ',' || c == ':' || c == ']' || c == '}');
+}
+
+static int32_t iot_json_hex4 (const char * str)
+{
+  int32_t val = 0;
+  for (uint32_t i = 0; i < 4u; i++)
+  {
+    char c = str[i];
+    val <<= 4;
+    if (c >= '0' && c <= '9') val |= c - '0';
+    else if (c >= 'a' && c <= 'f') val |= c - 'a' + 10;
+    else if (c >= 'A' && c <= 'F') val |= c - 'A' + 10;
+    else return -1;
+  }
+  return val;
+}
+
+bool iot_json_is_number (const char * str, size_t len)
+{
+  const char * end = str + len;
+  if (str < end && *str == '-') str++;
+  if (end - str > 2 && str[0] == '0' && (str[1] == 'x' || str[1] == 'X')) /* Hexadecimal integer */
+  {
+    for (str += 2; str < end && isxdigit ((unsigned char) *str); str++);
+    return str == end;
+  }
+  if (str == end || ! isdigit ((unsigned char) *str)) return false;
+  if (*str++ != '0') while (str < end && isdigit ((unsigned char) *str)) str++;
+  if (str < end && *str == '.')
+  {
+    if (++str == end || ! isdigit ((unsigned char) *str)) return false;
+    while (str < end && isdigit ((unsigned char) *str)) str++;
+  }
+  if (str < end && (*str == 'e' || *str == 'E'))
+  {
+    if (++str < end && (*str == '+' || *str == '-')) str++;
+    if (str == end || ! isdigit ((unsigned char) *str)) return false;
+    while (str < end && isdigit ((unsigned char) *str)) str++;
+  }
+  return str == end;
+}
+
+/**
+ * Unescapes string in place (decoded form is never longer), returns decoded length or -1 if invalid.
+ */
+static int64_t iot_json_unescape (char * str, size_t len)
+{
+  const char * in = str;
+  const char * end = str + len;
+  int64_t out = 0;
+  while (in < end)
+  {
+    char c = *in++;
+    if (c != '\\')
+    {
+      str[out++] = c;
+      continue;
+    }
+    if (in == end) return -1;
+    switch ((c = *in++))
+    {
+      case '"': case '/': case '\\': break;
+      case 'b': c = '\b'; break;
+      case 'f': c = '\f'; break;
+      case 'n': c = '\n'; break;
+      case 'r': c = '\r'; break;
+      case 't': c = '\t'; break;
+      case 'u':
+      {
+        int32_t cp = (end - in >= 4) ? iot_json_hex4 (in) : -1;
+        if (cp < 0) return -1;
+        in += 4;
+        if (cp >= 0xd800 && cp <= 0xdbff && end - in >= 6 && in[0] == '\\' && in[1] == 'u') /* Surrogate pair */
+        {
+          int32_t low = iot_json_hex4 (in + 2);
+          if (low >= 0xdc00 && low <= 0xdfff)
+          {
+            cp = 0x10000 + ((cp - 0xd800) << 10) + (low - 0xdc00);
+            in += 6;
+          }
+        }
+        if (cp < 0x80)
+        {
+          str[out++] = (char) cp;
+        }
+        else if (cp < 0x800)
+        {
+          str[out++] = (char) (0xc0 | (cp >> 6));
+          str[out++] = (char) (0x80 | (cp & 0x3f));
+        }
+        else if (cp < 0x10000)
+        {
+          str[out++] = (char) (0xe0 | (cp >> 12));
+          str[out++] = (char) (0x80 | ((cp >> 6) & 0x3f));
+          str[out++] = (char) (0x80 | (cp & 0x3f));
+        }
+        else
+        {
+          str[out++] = (char) (0xf0 | (cp >> 18));
+          str[out++] = (char) (0x80 | ((cp >> 12) & 0x3f));
+          str[out++] = (char) (0x80 | ((cp >> 6) & 0x3f));
+          str[out++] = (char) (0x80 | (cp & 0x3f));
+        }
+        continue;
+      }
+      default: return -1;
+    }
+    str[out++] = c;
+  }
+  return out;
+}
+
+static void iot_json_sax_buffer (iot_json_sax_t * sax, const char * str, size_t len)
+{
+  size_t required = sax->len + len + 1u;
+  if (required > sax->size)
+  {
+    if (sax->size == 0u) sax->size = IOT_JSON_SAX_BUFF_SIZE;
+    while (required > sax->size) sax->size *= 2u;
+    sax->buff = realloc (sax->buff, sax->size);
+  }
+  memcpy (sax->buff + sax->len, str, len);
+  sax->len += len;
+  sax->buff[sax->len] = '\0';
+}
+
+static inline void iot_json_sax_event (iot_json_sax_t * sax, bool ok)
+{
+  if (! ok) sax->status = IOT_JSON_ERROR_STOP;
+}
+
+/**
+ * Sets the expected element following a complete value.
+ */
+static inline void iot_json_sax_next (iot_json_sax_t * sax)
+{
+  sax->expect = (sax->depth && sax->object[sax->depth - 1u]) ? IOT_JSON_EXPECT_KEY : IOT_JSON_EXPECT_VALUE;
+}
+
+static void iot_json_sax_open (iot_json_sax_t * sax, bool object)
+{
+  const iot_json_handler_t * handler = sax->handler;
+  if (sax->expect != IOT_JSON_EXPECT_VALUE || sax->depth == IOT_JSON_SAX_MAX_DEPTH)
+  {
+    sax->status = IOT_JSON_ERROR_INVAL;
+    return;
+  }
+  sax->object[sax->depth++] = object;
+  sax->expect = object ? IOT_JSON_EXPECT_KEY : IOT_JSON_EXPECT_VALUE;
+  if (object)
+  {
+    if (handler->object_begin) iot_json_sax_event (sax, handler->object_begin (sax->arg));
+  }
+  else
+  {
+    if (handler->array_begin) iot_json_sax_event (sax, handler->array_begin (sax->arg));
+  }
+}
+
+static void iot_json_sax_close (iot_json_sax_t * sax, bool object)
+{
+  const iot_json_handler_t * handler = sax->handler;
+  if (sax->depth == 0u || sax->object[sax->depth - 1u] != object || sax->expect != (object ? IOT_JSON_EXPECT_KEY : IOT_JSON_EXPECT_VALUE))
+  {
+    sax->status = IOT_JSON_ERROR_INVAL;
+    return;
+  }
+  sax->depth--;
+  iot_json_sax_next (sax);
+  if (object)
+  {
+    if (handler->object_end) iot_json_sax_event (sax, handler->object_end (sax->arg));
+  }
+  else
+  {
+    if (handler->array_end) iot_json_sax_event (sax, handler->array_end (sax->arg));
+  }
+}
+
+static void iot_json_sax_text (iot_json_sax_t * sax, const char * str, size_t len, bool quoted)
+{
+  const iot_json_handler_t * handler = sax->handler;
+  if (sax->expect == IOT_JSON_EXPECT_KEY)
+  {
+    sax->expect = IOT_JSON_EXPECT_COLON;
+    if (handler->key) iot_json_sax_event (sax, handler->key (sax->arg, str, len));
+  }
+  else if (sax->expect == IOT_JSON_EXPECT_COLON)
+  {
+    sax->status = IOT_JSON_ERROR_INVAL;
+  }
+  else if (quoted)
+  {
+    iot_json_sax_next (sax);
+    if (handler->string) iot_json_sax_event (sax, handler->string (sax->arg, str, len));
+  }
+  else
+  {
+    iot_json_sax_next (sax);
+    if ((len == 4u && strncmp (str, "true", 4u) == 0) || (len == 5u && strncmp (str, "false", 5u) == 0))
+    {
+      if (handler->boolean) iot_json_sax_event (sax, handler->boolean (sax->arg, *str == 't'));
+    }
+    else if (len == 4u && strncmp (str, "null", 4u) == 0)
+    {
+      if (handler->null) iot_json_sax_event (sax, handler->null (sax->arg));
+    }
+    else if (iot_json_is_number (str, len))
+    {
+      if (handler->number) iot_json_sax_event (sax, handler->number (sax->arg, str, len));
+    }
+    else
+    {
+      sax->status = IOT_JSON_ERROR_INVAL;
+    }
+  }
+}
+
+static const char * iot_json_sax_string (iot_json_sax_t * sax, const char * ptr, const char * end)
+{
+  const char * start = ptr;
+  bool escape = (sax->lex == IOT_JSON_LEX_ESCAPE);
+  while (ptr < end)
+  {
+    if (escape)
+    {
+      escape = false;
+    }
+    else if (*ptr == '\\')
+    {
+      escape = sax->escaped = true;
+    }
+    else if (*ptr == '"')
+    {
+      break;
+    }
+    ptr++;
+  }
+  if (ptr == end) /* String continues in next chunk */
+  {
+    iot_json_sax_buffer (sax, start, (size_t) (ptr - start));
+    sax->lex = escape ? IOT_JSON_LEX_ESCAPE : IOT_JSON_LEX_STRING;
+    return ptr;
+  }
+  const char * str = start;
+  size_t len = (size_t) (ptr - start);
+  if (sax->len || sax->escaped)
+  {
+    iot_json_sax_buffer (sax, start, len);
+    int64_t decoded = sax->escaped ? iot_json_unescape (sax->buff, sax->len) : (int64_t) sax->len;
+    str = sax->buff;
+    len = (size_t) decoded;
+    if (decoded < 0) sax->status = IOT_JSON_ERROR_INVAL;
+  }
+  if (sax->status == 0) iot_json_sax_text (sax, str, len, true);
+  sax->len = 0u;
+  sax->escaped = false;
+  sax->lex = IOT_JSON_LEX_VALUE;
+  return ptr + 1; /* Skip closing quote */
+}
+
+static const char * iot_json_sax_primitive (iot_json_sax_t * sax, const char * ptr, const char * end)
+{
+  const char * start = ptr;
+  for (; ptr < end && ! iot_json_delimiter (*ptr); ptr++)
+  {
+    if ((uint8_t) *ptr < 32u || (uint8_t) *ptr >= 127u)
+    {
+      sax->status = IOT_JSON_ERROR_INVAL;
+      return ptr;
+    }
+  }
+  if (ptr == end) /* Primitive may continue in next chunk */
+  {
+    iot_json_sax_buffer (sax, start, (size_t) (ptr - start));
+    sax->lex = IOT_JSON_LEX_PRIMITIVE;
+    return ptr;
+  }
+  if (sax->len)
+  {
+    iot_json_sax_buffer (sax, start, (size_t) (ptr - start));
+    iot_json_sax_text (sax, sax->buff, sax->len, false);
+  }
+  else
+  {
+    iot_json_sax_text (sax, start, (size_t) (ptr - start), false);
+  }
+  sax->len = 0u;
+  sax->lex = IOT_JSON_LEX_VALUE;
+  return ptr; /* Delimiter processed as next token */
+}
+
+static const char * iot_json_sax_token (iot_json_sax_t * sax, const char * ptr, const char * end)
+{
+  switch (*ptr)
+  {
+    case ' ': case '\n': case '\r': case '\t': break;
+    case ',': /* Commas are optional, but not within object members */
+    {
+      if (sax->expect == IOT_JSON_EXPECT_COLON || (sax->expect == IOT_JSON_EXPECT_VALUE && sax->depth && sax->object[sax->depth - 1u]))
+      {
+        sax->status = IOT_JSON_ERROR_INVAL;
+      }
+      break;
+    }
+    case ':':
+    {
+      if (sax->expect == IOT_JSON_EXPECT_COLON)
+      {
+        sax->expect = IOT_JSON_EXPECT_VALUE;
+      }
+      else
+      {
+        sax->status = IOT_JSON_ERROR_INVAL;
+      }
+      break;
+    }
+    case '{': case '[': iot_json_sax_open (sax, *ptr == '{'); break;
+    case '}': case ']': iot_json_sax_close (sax, *ptr == '}'); break;
+    case '"': sax->lex = IOT_JSON_LEX_STRING; return iot_json_sax_string (sax, ptr + 1, end);
+    case '\0': sax->status = IOT_JSON_ERROR_INVAL; break;
+    default: return iot_json_sax_primitive (sax, ptr, end);
+  }
+  return ptr + 1;
+}
+
+static void iot_json_sax_init (iot_json_sax_t * sax, const iot_json_handler_t * handler, void * arg)
+{
+  sax->handler = handler;
+  sax->arg = arg;
+  sax->buff = NULL;
+  sax->size = 0u;
+  sax->len = 0u;
+  sax->status = 0;
+  sax->depth = 0u;
+  sax->lex = IOT_JSON_LEX_VALUE;
+  sax->expect = IOT_JSON_EXPECT_VALUE;
+  sax->escaped = false;
+}
+
+iot_json_sax_t * iot_json_sax_alloc (const iot_json_handler_t * handler, void * arg)
+{
+  assert (handler);
+  iot_json_sax_t * sax = malloc (sizeof (*sax));
+  iot_json_sax_init (sax, handler, arg);
+  return sax;
+}
+
+int iot_json_sax_push (iot_json_sax_t * sax, const char * json, size_t len)
+{
+  assert (sax && (json || len == 0u));
+  const char * ptr = json;
+  const char * end = json + len;
+  while (ptr < end && sax->status == 0)
+  {
+    switch (sax->lex)
+    {
+      case IOT_JSON_LEX_STRING: case IOT_JSON_LEX_ESCAPE: ptr = iot_json_sax_string (sax, ptr, end); break;
+      case IOT_JSON_LEX_PRIMITIVE: ptr = iot_json_sax_primitive (sax, ptr, end); break;
+      default: ptr = iot_json_sax_token (sax, ptr, end); break;
+    }
+  }
+  return sax->status;
+}
+
+int iot_json_sax_finish (iot_json_sax_t * sax)
+{
+  assert (sax);
+  int status = iot_json_sax_push (sax, " ", 1u); /* Delimit any trailing top level primitive */
+  if (status == 0 && (sax->depth || sax->lex != IOT_JSON_LEX_VALUE)) status = IOT_JSON_ERROR_PART;
+  sax->len = 0u;
+  sax->status = 0;
+  sax->depth = 0u;
+  sax->lex = IOT_JSON_LEX_VALUE;
+  sax->expect = IOT_JSON_EXPECT_VALUE;
+  sax->escaped = false;
+  return status;
+}
+
+void iot_json_sax_free (iot_json_sax_t * sax)
+{
+  if (sax)
+  {
+    free (sax->buff);
+    free (sax);
+  }
+}
+
+int iot_json_sax_parse (const char * json, size_t len, const iot_json_handler_t * handler, void * arg)
+{
+  iot_json_sax_t sax;
+  assert (handler);
+  iot_json_sax_init (&sax, handler, arg);
+  iot_json_sax_push (&sax, json, len);
+  int status = iot_json_sax_finish (&sax);
+  free (sax.buff);
+  return status;
+}
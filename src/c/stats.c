@@ -0,0 +1,166 @@
+//
+// Copyright (c) 2020 IOTech
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+#include "iot/container.h"
+#include "iot/stats.h"
+#include "iot/thread.h"
+
+#define IOT_STATS_INTERVAL_DEFAULT 60000u
+
+#ifdef IOT_BUILD_COMPONENTS
+#define IOT_STATS_FACTORY iot_stats_factory ()
+#else
+#define IOT_STATS_FACTORY NULL
+#endif
+
+struct iot_stats_t
+{
+  iot_component_t component;      // Component base type
+  iot_scheduler_t * scheduler;    // Optional scheduler for periodic sampling
+  iot_schedule_t * schedule;      // Sampling schedule
+  iot_logger_t * logger;          // Optional logger
+  iot_data_t * data;              // Latest statistics sample
+  bool trim;                      // Whether to trim data block cache when sampling
+};
+
+static iot_data_t * iot_stats_sample (void)
+{
+  iot_data_stats_t stats;
+  iot_data_t * map = iot_data_alloc_map (IOT_DATA_STRING);
+  iot_data_t * live = iot_data_alloc_map (IOT_DATA_STRING);
+  iot_data_t * strings = iot_data_alloc_map (IOT_DATA_STRING);
+
+  iot_data_stats (&stats);
+  iot_data_string_map_add (map, "Chunks", iot_data_alloc_ui64 (stats.chunks));
+  iot_data_string_map_add (map, "BlocksAllocated", iot_data_alloc_ui64 (stats.blocks_allocated));
+  iot_data_string_map_add (map, "BlocksInUse", iot_data_alloc_ui64 (stats.blocks_in_use));
+  iot_data_string_map_add (map, "BlocksCached", iot_data_alloc_ui64 (stats.blocks_cached));
+  iot_data_string_map_add (map, "BlocksPeakSampled", iot_data_alloc_ui64 (stats.blocks_peak_sampled));
+  for (uint32_t type = IOT_DATA_INT8; type <= IOT_DATA_VECTOR; type++)
+  {
+    iot_data_string_map_add (live, iot_data_type_string ((iot_data_type_t) type), iot_data_alloc_ui64 (stats.live[type]));
+  }
+  iot_data_string_map_add (map, "Live", live);
+  iot_data_string_map_add (strings, "Inline", iot_data_alloc_ui64 (stats.strings_inline));
+  iot_data_string_map_add (strings, "Block", iot_data_alloc_ui64 (stats.strings_block));
+  iot_data_string_map_add (strings, "Heap", iot_data_alloc_ui64 (stats.strings_heap));
+  iot_data_string_map_add (map, "Strings", strings);
+  return map;
+}
+
+static void * iot_stats_run (void * arg)
+{
+  iot_stats_t * stats = (iot_stats_t*) arg;
+  if (stats->trim)
+  {
+    uint32_t released = iot_data_cache_trim ();
+    if (released) iot_log_debug (stats->logger, "Data cache trimmed, %" PRIu32 " memory chunks released", released);
+  }
+  iot_data_t * data = iot_stats_sample ();
+  if (stats->logger && stats->logger->level >= IOT_LOG_INFO)
+  {
+    char * json = iot_data_to_json (data);
+    iot_log_info (stats->logger, "Data statistics: %s", json);
+    free (json);
+  }
+  iot_component_lock (&stats->component);
+  iot_data_free (stats->data);
+  stats->data = data;
+  iot_component_unlock (&stats->component);
+  return NULL;
+}
+
+iot_stats_t * iot_stats_alloc (iot_scheduler_t * scheduler, uint64_t interval, bool trim, iot_logger_t * logger)
+{
+  iot_stats_t * stats = (iot_stats_t*) calloc (1, sizeof (*stats));
+  stats->logger = logger;
+  stats->trim = trim;
+  iot_logger_add_ref (logger);
+  iot_log_info (logger, "iot_stats_alloc (interval: %" PRIu64 " trim: %s)", interval, trim ? "true" : "false");
+  if (scheduler && interval)
+  {
+    stats->scheduler = scheduler;
+    iot_scheduler_add_ref (scheduler);
+    stats->schedule = iot_schedule_create (scheduler, iot_stats_run, NULL, stats, interval, 0, 0, NULL, IOT_THREAD_NO_PRIORITY);
+  }
+  iot_component_init (&stats->component, IOT_STATS_FACTORY, (iot_component_start_fn_t) iot_stats_start, (iot_component_stop_fn_t) iot_stats_stop);
+  return stats;
+}
+
+void iot_stats_add_ref (iot_stats_t * stats)
+{
+  if (stats) iot_component_add_ref (&stats->component);
+}
+
+void iot_stats_start (iot_stats_t * stats)
+{
+  assert (stats);
+  iot_log_trace (stats->logger, "iot_stats_start()");
+  if (iot_component_set_running (&stats->component) && stats->schedule)
+  {
+    iot_stats_run (stats);
+    iot_schedule_add (stats->scheduler, stats->schedule);
+  }
+}
+
+void iot_stats_stop (iot_stats_t * stats)
+{
+  assert (stats);
+  iot_log_trace (stats->logger, "iot_stats_stop()");
+  if (iot_component_set_stopped (&stats->component) && stats->schedule)
+  {
+    iot_schedule_remove (stats->scheduler, stats->schedule);
+  }
+}
+
+iot_data_t * iot_stats_data (iot_stats_t * stats)
+{
+  assert (stats);
+  iot_data_t * data = NULL;
+  iot_component_lock (&stats->component);
+  if (stats->data && (stats->component.state == IOT_COMPONENT_RUNNING))
+  {
+    data = stats->data;
+    iot_data_add_ref (data);
+  }
+  iot_component_unlock (&stats->component);
+  return data ? data : iot_stats_sample ();
+}
+
+void iot_stats_free (iot_stats_t * stats)
+{
+  if (stats && iot_component_dec_ref (&stats->component))
+  {
+    iot_log_trace (stats->logger, "iot_stats_free()");
+    iot_stats_stop (stats);
+    iot_component_set_deleted (&stats->component);
+    if (stats->schedule) iot_schedule_delete (stats->scheduler, stats->schedule);
+    iot_scheduler_free (stats->scheduler);
+    iot_logger_free (stats->logger);
+    iot_data_free (stats->data);
+    iot_component_fini (&stats->component);
+    free (stats);
+  }
+}
+
+#ifdef IOT_BUILD_COMPONENTS
+
+static iot_component_t * iot_stats_config (iot_container_t * cont, const iot_data_t * map)
+{
+  iot_logger_t * logger = (iot_logger_t*) iot_container_find_component (cont, iot_data_string_map_get_string (map, "Logger"));
+  iot_scheduler_t * scheduler = (iot_scheduler_t*) iot_container_find_component (cont, iot_data_string_map_get_string (map, "Scheduler"));
+  uint64_t interval = (uint64_t) iot_data_string_map_get_i64 (map, "Interval", IOT_STATS_INTERVAL_DEFAULT);
+  int64_t limit = iot_data_string_map_get_i64 (map, "CacheLimit", -1);
+  if (limit >= 0) iot_data_cache_set_limit ((limit > UINT32_MAX) ? UINT32_MAX : (uint32_t) limit); // Process wide setting
+  return (iot_component_t*) iot_stats_alloc (scheduler, IOT_MS_TO_NS (interval), iot_data_string_map_get_bool (map, "Trim", false), logger);
+}
+
+const iot_component_factory_t * iot_stats_factory (void)
+{
+  static iot_component_factory_t factory = { IOT_STATS_TYPE, iot_stats_config, (iot_component_free_fn_t) iot_stats_free, NULL };
+  return &factory;
+}
+
+#endif
@@ -0,0 +1,55 @@
+#include "iot/iot.h"
+
+// Measures JSON tokenizer time for flat arrays and maps from 1000 up to a maximum number of elements
+// (default 1000000). Time per element should stay constant as the number of elements grows.
+
+#define IOT_JSON_PARSE_PERF_MIN 1000u
+
+static char * iot_json_parse_perf_doc (uint32_t elements, bool map)
+{
+  size_t size = (size_t) elements * 24u + 3u;
+  char * json = malloc (size);
+  assert (json);
+  char * ptr = json;
+  char * end = json + size - 2u; // Space for closing bracket and terminator
+  *ptr++ = map ? '{' : '[';
+  for (uint32_t i = 0; i < elements; i++)
+  {
+    size_t avail = (size_t) (end - ptr);
+    ptr += map ? snprintf (ptr, avail, "%s\"K%" PRIu32 "\":%" PRIu32, i ? "," : "", i, i) : snprintf (ptr, avail, "%s%" PRIu32, i ? "," : "", i);
+  }
+  *ptr++ = map ? '}' : ']';
+  *ptr = '\0';
+  return json;
+}
+
+static uint64_t iot_json_parse_perf_run (const char * json, uint32_t num_tokens)
+{
+  iot_json_parser parser;
+  iot_json_tok_t * tokens = malloc (sizeof (*tokens) * num_tokens);
+  assert (tokens);
+  iot_json_init (&parser);
+  uint64_t start = iot_time_nsecs ();
+  int count = iot_json_parse (&parser, json, strlen (json), tokens, num_tokens);
+  uint64_t ns = iot_time_nsecs () - start;
+  if (count != (int) num_tokens) fprintf (stderr, "Unexpected token count: %d\n", count);
+  free (tokens);
+  return ns;
+}
+
+int main (int argc, char ** argv)
+{
+  uint32_t max = (argc > 1) ? (uint32_t) strtoul (argv[1], NULL, 10) : 1000000u;
+  printf ("%12s %12s %14s %12s %14s\n", "Elements", "Array ms", "Array ns/elem", "Map ms", "Map ns/elem");
+  for (uint32_t elements = IOT_JSON_PARSE_PERF_MIN; elements <= max; elements *= 10u)
+  {
+    char * array = iot_json_parse_perf_doc (elements, false);
+    char * map = iot_json_parse_perf_doc (elements, true);
+    uint64_t array_ns = iot_json_parse_perf_run (array, elements + 1u);
+    uint64_t map_ns = iot_json_parse_perf_run (map, elements * 2u + 1u);
+    printf ("%12" PRIu32 " %12.3f %14.3f %12.3f %14.3f\n", elements, array_ns / 1e6, (double) array_ns / elements, map_ns / 1e6, (double) map_ns / elements);
+    free (array);
+    free (map);
+  }
+  return 0;
+}
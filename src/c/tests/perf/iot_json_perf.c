@@ -0,0 +1,112 @@
+#include "iot/iot.h"
+
+// Measures JSON serialization time for outputs from 1KB up to a maximum size (default 100MB),
+// both to a string and to a sink, and the time to parse the output back, both whole and pushed
+// in chunks to an incremental parser. Time per byte should stay constant as output size grows.
+// The same data is also encoded to and decoded from CBOR for comparison.
+
+#define IOT_JSON_PERF_MIN 1000u
+#define IOT_JSON_PERF_CHUNK 4096u
+
+static bool iot_json_perf_sink (void * arg, const char * buff, size_t len)
+{
+  (void) buff;
+  *((size_t*) arg) += len;
+  return true;
+}
+
+static void iot_json_perf_parsed (void * arg, iot_data_t * data)
+{
+  (void) arg;
+  iot_data_free (data);
+}
+
+static iot_data_t * iot_json_perf_element (void)
+{
+  uint8_t bytes [64];
+  iot_data_t * map = iot_data_alloc_map (IOT_DATA_STRING);
+  for (uint32_t i = 0; i < sizeof (bytes); i++) bytes[i] = (uint8_t) i;
+  iot_data_string_map_add (map, "Name", iot_data_alloc_string ("Temperature \"Sensor\"\tZone 1", IOT_DATA_REF));
+  iot_data_string_map_add (map, "Description", iot_data_alloc_string ("Ambient temperature sensor mounted on the north wall of zone 1, reporting in degrees Celsius at one second intervals", IOT_DATA_REF));
+  iot_data_string_map_add (map, "Value", iot_data_alloc_f64 (21.5));
+  iot_data_string_map_add (map, "Count", iot_data_alloc_ui64 (1234567890u));
+  iot_data_string_map_add (map, "Valid", iot_data_alloc_bool (true));
+  iot_data_string_map_add (map, "Data", iot_data_alloc_array (bytes, sizeof (bytes), IOT_DATA_UINT8, IOT_DATA_COPY));
+  return map;
+}
+
+int main (int argc, char ** argv)
+{
+  uint64_t max = (argc > 1) ? strtoull (argv[1], NULL, 10) : 100000000u;
+  iot_init ();
+  iot_data_t * element = iot_json_perf_element ();
+  char * json = iot_data_to_json (element);
+  size_t element_size = strlen (json) + 1u;
+  free (json);
+
+  iot_data_json_parser_t * parser = iot_data_json_parser_alloc (iot_json_perf_parsed, NULL);
+
+  printf ("%12s %12s %12s %12s %12s %12s %12s %12s %12s %12s %12s %12s %12s\n", "Bytes", "String ms", "String ns/B", "Sink ms", "Sink ns/B", "Parse ms", "Parse ns/B", "Push ms", "Push ns/B", "CBOR Bytes", "Encode ms", "Decode ms", "Forward ms");
+  for (uint64_t target = IOT_JSON_PERF_MIN; target <= max; target *= 10u)
+  {
+    uint32_t count = (uint32_t) (target / element_size) + 1u;
+    iot_data_t * vector = iot_data_alloc_vector (count);
+    for (uint32_t i = 0; i < count; i++)
+    {
+      iot_data_add_ref (element);
+      iot_data_vector_add (vector, i, element);
+    }
+    uint64_t start = iot_time_nsecs ();
+    json = iot_data_to_json (vector);
+    uint64_t string_ns = iot_time_nsecs () - start;
+    size_t len = strlen (json);
+
+    start = iot_time_nsecs ();
+    iot_data_t * parsed = iot_data_from_json (json);
+    uint64_t parse_ns = iot_time_nsecs () - start;
+    iot_data_free (parsed);
+
+    // Lazily parse, inspect the first element and convert back to json, as when forwarding a payload
+
+    start = iot_time_nsecs ();
+    parsed = iot_data_from_json_lazy (json);
+    iot_data_map_size (iot_data_vector_get (parsed, 0u));
+    char * forward = iot_data_to_json (parsed);
+    iot_data_free (parsed);
+    uint64_t forward_ns = iot_time_nsecs () - start;
+    free (forward);
+
+    start = iot_time_nsecs ();
+    for (size_t off = 0; off < len; off += IOT_JSON_PERF_CHUNK)
+    {
+      iot_data_json_parser_push (parser, json + off, (len - off < IOT_JSON_PERF_CHUNK) ? (len - off) : IOT_JSON_PERF_CHUNK);
+    }
+    iot_data_json_parser_finish (parser);
+    uint64_t push_ns = iot_time_nsecs () - start;
+    free (json);
+
+    size_t sunk = 0;
+    start = iot_time_nsecs ();
+    iot_data_to_json_sink (vector, iot_json_perf_sink, &sunk);
+    uint64_t sink_ns = iot_time_nsecs () - start;
+
+    uint32_t cbor_len;
+    start = iot_time_nsecs ();
+    uint8_t * cbor = iot_data_to_cbor (vector, &cbor_len);
+    uint64_t encode_ns = iot_time_nsecs () - start;
+    start = iot_time_nsecs ();
+    parsed = iot_data_from_cbor (cbor, cbor_len);
+    uint64_t decode_ns = iot_time_nsecs () - start;
+    iot_data_free (parsed);
+    free (cbor);
+    iot_data_free (vector);
+
+    printf ("%12zu %12.3f %12.3f %12.3f %12.3f %12.3f %12.3f %12.3f %12.3f %12" PRIu32 " %12.3f %12.3f %12.3f\n", len, string_ns / 1e6, (double) string_ns / len, sink_ns / 1e6, (double) sink_ns / sunk,
+      parse_ns / 1e6, (double) parse_ns / len, push_ns / 1e6, (double) push_ns / len,
+      cbor_len, encode_ns / 1e6, decode_ns / 1e6, forward_ns / 1e6);
+  }
+  iot_data_json_parser_free (parser);
+  iot_data_free (element);
+  iot_fini ();
+  return 0;
+}
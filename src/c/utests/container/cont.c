@@ -115,6 +115,32 @@ static void test_list_containers (void)
   iot_container_free (cont2);
 }
 
+static void test_stats_component (void)
+{
+  iot_container_t * cont = iot_container_alloc ("stats");
+  iot_component_factory_add (iot_logger_factory ());
+  iot_component_factory_add (iot_scheduler_factory ());
+  iot_component_factory_add (iot_stats_factory ());
+  iot_container_add_component (cont, IOT_LOGGER_TYPE, "logger", logger_config);
+  iot_container_add_component (cont, IOT_SCHEDULER_TYPE, "scheduler", "{\"Logger\":\"logger\"}");
+  iot_container_add_component (cont, IOT_STATS_TYPE, "stats", "{\"Logger\":\"logger\",\"Scheduler\":\"scheduler\",\"Interval\":1000,\"Trim\":true,\"CacheLimit\":1024}");
+  iot_stats_t * stats = (iot_stats_t*) iot_container_find_component (cont, "stats");
+  CU_ASSERT (stats != NULL)
+  iot_container_start (cont);
+  iot_data_t * data = iot_stats_data (stats);
+  CU_ASSERT (iot_data_map_size (data) == 7u)
+  CU_ASSERT (iot_data_string_map_get (data, "BlocksInUse") != NULL)
+  CU_ASSERT (iot_data_ui64 (iot_data_string_map_get (iot_data_string_map_get (data, "Live"), "Map")) >= 1u)
+  CU_ASSERT (iot_data_map_size (iot_data_string_map_get (data, "Live")) == IOT_DATA_VECTOR + 1u)
+  CU_ASSERT (iot_data_map_size (iot_data_string_map_get (data, "Strings")) == 3u)
+  iot_data_free (data);
+  iot_container_add_component (cont, IOT_STATS_TYPE, "stats2", "{\"CacheLimit\":\"1024\"}"); // Invalid limit type ignored
+  CU_ASSERT (iot_container_find_component (cont, "stats2") != NULL)
+  iot_container_stop (cont);
+  iot_container_free (cont);
+  iot_data_cache_set_limit (0);
+}
+
 static void test_state_name (void)
 {
   CU_ASSERT (strcmp (iot_component_state_name (IOT_COMPONENT_INITIAL), "Initial") == 0)
@@ -134,4 +160,5 @@ void cunit_cont_test_init (void)
   CU_add_test (suite, "container_add_component", test_add_component);
   CU_add_test (suite, "container_delete_component", test_delete_component);
   CU_add_test (suite, "container_list_containers", test_list_containers);
+  CU_add_test (suite, "container_stats_component", test_stats_component);
 }
@@ -8,6 +8,8 @@
 #include "data.h"
 #include "CUnit.h"
 #include <float.h>
+#include <limits.h>
+#include <math.h>
 
 static int suite_init (void)
 {
@@ -467,6 +469,155 @@ static void test_data_to_json (void)
   free (json);
 }
 
+static bool test_json_value (iot_data_t * data, const char * expected)
+{
+  char * json = iot_data_to_json (data);
+  bool ok = (strcmp (json, expected) == 0);
+  if (! ok) printf ("\nJSON value: %s expected: %s\n", json, expected);
+  free (json);
+  iot_data_free (data);
+  return ok;
+}
+
+static void test_data_to_json_numbers (void)
+{
+  CU_ASSERT (test_json_value (iot_data_alloc_i8 (INT8_MIN), "-128"))
+  CU_ASSERT (test_json_value (iot_data_alloc_ui8 (UINT8_MAX), "255"))
+  CU_ASSERT (test_json_value (iot_data_alloc_i16 (0), "0"))
+  CU_ASSERT (test_json_value (iot_data_alloc_ui16 (9), "9"))
+  CU_ASSERT (test_json_value (iot_data_alloc_i32 (-10), "-10"))
+  CU_ASSERT (test_json_value (iot_data_alloc_ui32 (UINT32_MAX), "4294967295"))
+  CU_ASSERT (test_json_value (iot_data_alloc_i64 (INT64_MIN), "-9223372036854775808"))
+  CU_ASSERT (test_json_value (iot_data_alloc_i64 (INT64_MAX), "9223372036854775807"))
+  CU_ASSERT (test_json_value (iot_data_alloc_ui64 (UINT64_MAX), "18446744073709551615"))
+  CU_ASSERT (test_json_value (iot_data_alloc_f64 (0.0), "0.0"))
+  CU_ASSERT (test_json_value (iot_data_alloc_f64 (-0.0), "-0.0"))
+  CU_ASSERT (test_json_value (iot_data_alloc_f64 (1.0), "1.0"))
+  CU_ASSERT (test_json_value (iot_data_alloc_f64 (-2.5), "-2.5"))
+  CU_ASSERT (test_json_value (iot_data_alloc_f64 (0.1), "0.1"))
+  CU_ASSERT (test_json_value (iot_data_alloc_f64 (123456.789), "123456.789"))
+  CU_ASSERT (test_json_value (iot_data_alloc_f64 (1e20), "100000000000000000000.0"))
+  CU_ASSERT (test_json_value (iot_data_alloc_f64 (1e21), "1e21"))
+  CU_ASSERT (test_json_value (iot_data_alloc_f64 (1.5e300), "1.5e300"))
+  CU_ASSERT (test_json_value (iot_data_alloc_f64 (0.000001), "0.000001"))
+  CU_ASSERT (test_json_value (iot_data_alloc_f64 (1.25e-7), "1.25e-7"))
+  CU_ASSERT (test_json_value (iot_data_alloc_f64 (5e-324), "5e-324"))
+  CU_ASSERT (test_json_value (iot_data_alloc_f64 (DBL_MAX), "1.7976931348623157e308"))
+  CU_ASSERT (test_json_value (iot_data_alloc_f32 (0.1f), "0.1"))
+  CU_ASSERT (test_json_value (iot_data_alloc_f32 (16777216.0f), "16777216.0"))
+  CU_ASSERT (test_json_value (iot_data_alloc_f32 (FLT_MAX), "3.4028235e38"))
+  CU_ASSERT (test_json_value (iot_data_alloc_f32 (-1.5e-45f), "-1e-45"))
+
+  uint64_t seed = 0x9e3779b97f4a7c15u;
+  for (uint32_t i = 0; i < 100000; i++)
+  {
+    double d;
+    float f;
+    seed ^= seed << 13;
+    seed ^= seed >> 7;
+    seed ^= seed << 17;
+    memcpy (&d, &seed, sizeof (d));
+    memcpy (&f, &seed, sizeof (f));
+    if (isfinite (d))
+    {
+      iot_data_t * data = iot_data_alloc_f64 (d);
+      char * json = iot_data_to_json (data);
+      CU_ASSERT (strtod (json, NULL) == d)
+      free (json);
+      iot_data_free (data);
+    }
+    if (isfinite (f))
+    {
+      iot_data_t * data = iot_data_alloc_f32 (f);
+      char * json = iot_data_to_json (data);
+      CU_ASSERT (strtof (json, NULL) == f)
+      free (json);
+      iot_data_free (data);
+    }
+  }
+}
+
+static void test_data_to_json_escape (void)
+{
+  const char specials [] = { '"', '\\', '\n', '\x01', '\x1f', '/', '\x7f' };
+  const char * escaped [] = { "\\\"", "\\\\", "\\n", "\\u0001", "\\u001f", "/", "\x7f" };
+  char str [48];
+  char expected [64];
+
+  for (uint32_t len = 1; len < 40; len++)
+  {
+    for (uint32_t pos = 0; pos < len; pos++)
+    {
+      uint32_t s = (len + pos) % sizeof (specials);
+      memset (str, 'a', len);
+      str[len] = '\0';
+      str[pos] = specials[s];
+      expected[0] = '"';
+      memset (expected + 1, 'a', pos);
+      strcpy (expected + 1 + pos, escaped[s]);
+      memset (expected + 1 + pos + strlen (escaped[s]), 'a', len - pos - 1u);
+      strcpy (expected + pos + strlen (escaped[s]) + len - pos, "\"");
+      CU_ASSERT (test_json_value (iot_data_alloc_string (str, IOT_DATA_REF), expected))
+    }
+  }
+  CU_ASSERT (test_json_value (iot_data_alloc_string ("D\xc3\xa9vice \xe2\x82\xac", IOT_DATA_REF), "\"D\xc3\xa9vice \xe2\x82\xac\""))
+}
+
+typedef struct test_sink_t
+{
+  char * str;
+  size_t len;
+  uint32_t writes;
+  uint32_t fail_after;
+} test_sink_t;
+
+static bool test_sink_write (void * arg, const char * buff, size_t len)
+{
+  test_sink_t * sink = (test_sink_t*) arg;
+  if (sink->fail_after && sink->writes >= sink->fail_after) return false;
+  sink->writes++;
+  sink->str = realloc (sink->str, sink->len + len + 1);
+  memcpy (sink->str + sink->len, buff, len);
+  sink->len += len;
+  sink->str[sink->len] = '\0';
+  return true;
+}
+
+static void test_data_to_json_sink (void)
+{
+  uint8_t bytes [20000];
+  char * str = malloc (10001);
+  iot_data_t * map = iot_data_alloc_map (IOT_DATA_STRING);
+  iot_data_t * vector = iot_data_alloc_vector (500);
+  test_sink_t sink = { NULL, 0, 0, 0 };
+
+  for (uint32_t i = 0; i < sizeof (bytes); i++) bytes[i] = (uint8_t) i;
+  for (uint32_t i = 0; i < 10000; i++) str[i] = (i % 10) ? 'a' : '\n';
+  str[10000] = '\0';
+  for (uint32_t i = 0; i < 500; i++) iot_data_vector_add (vector, i, iot_data_alloc_f64 (i * 0.5));
+  iot_data_string_map_add (map, "String", iot_data_alloc_string (str, IOT_DATA_TAKE));
+  iot_data_string_map_add (map, "Array", iot_data_alloc_array (bytes, sizeof (bytes), IOT_DATA_UINT8, IOT_DATA_COPY));
+  iot_data_string_map_add (map, "Vector", vector);
+  iot_data_string_map_add (map, "Bool", iot_data_alloc_bool (false));
+
+  char * json = iot_data_to_json (map);
+  CU_ASSERT (iot_data_to_json_sink (map, test_sink_write, &sink))
+  CU_ASSERT (sink.writes > 1)
+  CU_ASSERT (sink.str && (strcmp (sink.str, json) == 0))
+  free (sink.str);
+
+  sink.str = NULL;
+  sink.len = 0;
+  sink.writes = 0;
+  sink.fail_after = 1;
+  CU_ASSERT (! iot_data_to_json_sink (map, test_sink_write, &sink))
+  CU_ASSERT (sink.writes == 1)
+  free (sink.str);
+
+  free (json);
+  iot_data_free (map);
+}
+
 static void test_data_from_json (void)
 {
   static const char * config =
@@ -546,6 +697,712 @@ static void test_data_from_json (void)
   iot_data_free (map);
 }
 
+static void test_data_from_json_values (void)
+{
+  iot_data_t * data = iot_data_from_json ("{\"Str\":\"a\\\"b\\\\c\\/d\\n\\u00e9\\ud83d\\ude00\",\"Neg\":-42,\"Big\":123456789012345678901,\"Hex\":0x1f,"
+    "\"Real\":-1.5e3,\"Vec\":[1,[2,3],{}, [] ,\"x\"],\"T\":true,\"F\":false,\"N\":null,bare:7}");
+  CU_ASSERT (data != NULL)
+  if (data)
+  {
+    CU_ASSERT (strcmp (iot_data_string_map_get_string (data, "Str"), "a\"b\\c/d\n\xc3\xa9\xf0\x9f\x98\x80") == 0)
+    CU_ASSERT (iot_data_string_map_get_i64 (data, "Neg", 0) == -42)
+    CU_ASSERT (iot_data_string_map_get_i64 (data, "Big", 0) == LONG_MAX)
+    CU_ASSERT (iot_data_string_map_get_i64 (data, "Hex", 0) == 31)
+    CU_ASSERT (iot_data_string_map_get_f64 (data, "Real", 0.0) == -1500.0)
+    CU_ASSERT (iot_data_string_map_get_bool (data, "T", false))
+    CU_ASSERT (! iot_data_string_map_get_bool (data, "F", true))
+    CU_ASSERT (strcmp (iot_data_string_map_get_string (data, "N"), "null") == 0)
+    CU_ASSERT (iot_data_string_map_get_i64 (data, "bare", 0) == 7)
+    const iot_data_t * vec = iot_data_string_map_get_vector (data, "Vec");
+    CU_ASSERT (vec && iot_data_vector_size (vec) == 5)
+    CU_ASSERT (vec && iot_data_vector_size (iot_data_vector_get (vec, 1)) == 2)
+    CU_ASSERT (vec && iot_data_map_size (iot_data_vector_get (vec, 2)) == 0)
+    CU_ASSERT (vec && iot_data_vector_size (iot_data_vector_get (vec, 3)) == 0)
+
+    char * json = iot_data_to_json (data);
+    iot_data_t * data2 = iot_data_from_json (json);
+    CU_ASSERT (iot_data_equal (data, data2))
+    iot_data_free (data2);
+    free (json);
+  }
+  iot_data_free (data);
+
+  data = iot_data_from_json (" 42 ");
+  CU_ASSERT (data && iot_data_type (data) == IOT_DATA_INT64 && iot_data_i64 (data) == 42)
+  iot_data_free (data);
+  data = iot_data_from_json ("\"Text\"");
+  CU_ASSERT (data && strcmp (iot_data_string (data), "Text") == 0)
+  iot_data_free (data);
+
+  const char * invalid [] = { "", "  ", "{", "[1,2", "{\"a\" 1}", "{\"a\":}", "\"abc", "\"\\q\"", "\"\\u12g4\"", "]", "{\"a\":[1,}" };
+  for (uint32_t i = 0; i < sizeof (invalid) / sizeof (invalid[0]); i++)
+  {
+    data = iot_data_from_json (invalid[i]);
+    CU_ASSERT (data == NULL)
+    iot_data_free (data);
+  }
+
+  char * deep = malloc (2001);
+  memset (deep, '[', 1000);
+  memset (deep + 1000, ']', 1000);
+  deep[2000] = '\0';
+  data = iot_data_from_json (deep);
+  CU_ASSERT (data == NULL)
+  free (deep);
+}
+
+static void test_data_from_json_typecode (void)
+{
+  iot_typecode_t * u16_map = iot_typecode_alloc_map (IOT_DATA_STRING, iot_typecode_alloc_basic (IOT_DATA_UINT16));
+  iot_typecode_t * f32_array = iot_typecode_alloc_array (IOT_DATA_FLOAT32);
+  iot_typecode_t * i32_array = iot_typecode_alloc_array (IOT_DATA_INT32);
+  iot_typecode_t * bool_map = iot_typecode_alloc_map (IOT_DATA_INT32, iot_typecode_alloc_basic (IOT_DATA_BOOL));
+  iot_typecode_t * map_vector = iot_typecode_alloc_vector (bool_map);
+  iot_typecode_t * any_map = iot_typecode_alloc_map (IOT_DATA_STRING, NULL);
+  iot_typecode_t * u64 = iot_typecode_alloc_basic (IOT_DATA_UINT64);
+
+  iot_data_t * data = iot_data_from_json_with_typecode ("{\"a\":1, \"b\":65535, \"c\":0x10}", u16_map);
+  CU_ASSERT (data && iot_data_matches (data, u16_map))
+  CU_ASSERT (data && iot_data_ui16 (iot_data_string_map_get (data, "b")) == 65535u)
+  CU_ASSERT (data && iot_data_ui16 (iot_data_string_map_get (data, "c")) == 16u)
+  iot_data_free (data);
+
+  data = iot_data_from_json_with_typecode ("[1.5, 2, -3e2]", f32_array);
+  CU_ASSERT (data && iot_data_matches (data, f32_array) && iot_data_array_length (data) == 3u)
+  if (data)
+  {
+    const float * floats = (const float*) iot_data_address (data);
+    CU_ASSERT (floats[0] == 1.5f && floats[1] == 2.0f && floats[2] == -300.0f)
+  }
+  iot_data_free (data);
+
+  data = iot_data_from_json_with_typecode (" [ ] ", f32_array);
+  CU_ASSERT (data && iot_data_matches (data, f32_array) && iot_data_array_length (data) == 0u)
+  iot_data_free (data);
+
+  char * json = malloc (12 * 1000 + 3);
+  char * ptr = json;
+  *ptr++ = '[';
+  for (int32_t i = 0; i < 1000; i++) ptr += sprintf (ptr, "%s%d", i ? "," : "", i * -1000);
+  strcpy (ptr, "]");
+  data = iot_data_from_json_with_typecode (json, i32_array);
+  CU_ASSERT (data && iot_data_matches (data, i32_array) && iot_data_array_length (data) == 1000u)
+  CU_ASSERT (data && ((const int32_t*) iot_data_address (data))[999] == -999000)
+  iot_data_free (data);
+  free (json);
+
+  data = iot_data_from_json_with_typecode ("[{\"1\": true, \"-2\": false}, {}]", map_vector);
+  CU_ASSERT (data && iot_data_vector_size (data) == 2u)
+  if (data)
+  {
+    iot_data_t * key = iot_data_alloc_i32 (-2);
+    const iot_data_t * val = iot_data_map_get (iot_data_vector_get (data, 0), key);
+    CU_ASSERT (val && iot_data_type (val) == IOT_DATA_BOOL && ! iot_data_bool (val))
+    iot_data_free (key);
+  }
+  iot_data_free (data);
+
+  data = iot_data_from_json_with_typecode ("{\"a\":1, \"b\":[\"x\",{}]}", any_map);
+  CU_ASSERT (data && iot_data_string_map_get_i64 (data, "a", 0) == 1)
+  CU_ASSERT (data && iot_data_vector_size (iot_data_string_map_get_vector (data, "b")) == 2u)
+  iot_data_free (data);
+
+  data = iot_data_from_json_with_typecode ("18446744073709551615", u64);
+  CU_ASSERT (data && iot_data_ui64 (data) == UINT64_MAX)
+  iot_data_free (data);
+
+  // Values not matching typecode
+
+  const struct { const char * json; const iot_typecode_t * tc; } invalid [] =
+  {
+    { "{\"a\":65536}", u16_map }, { "{\"a\":-1}", u16_map }, { "{\"a\":1.5}", u16_map }, { "{\"a\":\"1\"}", u16_map },
+    { "{\"a\":[1]}", u16_map }, { "[1]", u16_map }, { "[\"x\"]", f32_array }, { "[[1]]", f32_array },
+    { "[1e39]", f32_array }, { "[2147483648]", i32_array }, { "[{\"x\": true}]", map_vector }, { "[{\"1\": 1}]", map_vector },
+    { "[1]", map_vector }, { "-1", u64 }, { "18446744073709551616", u64 }, { "true", u64 }, { "{\"a\":1", u16_map }
+  };
+  for (uint32_t i = 0; i < sizeof (invalid) / sizeof (invalid[0]); i++)
+  {
+    data = iot_data_from_json_with_typecode (invalid[i].json, invalid[i].tc);
+    CU_ASSERT (data == NULL)
+    iot_data_free (data);
+  }
+
+  iot_typecode_free (u64);
+  iot_typecode_free (any_map);
+  iot_typecode_free (map_vector);
+  iot_typecode_free (bool_map);
+  iot_typecode_free (i32_array);
+  iot_typecode_free (f32_array);
+  iot_typecode_free (u16_map);
+}
+
+static void test_json_array (const iot_data_json_options_t * options, const char * json, iot_data_type_t type, uint32_t length)
+{
+  iot_data_t * data = iot_data_from_json_with_options (json, options);
+  CU_ASSERT (data && iot_data_type (data) == IOT_DATA_ARRAY)
+  CU_ASSERT (data && iot_data_type (data) == IOT_DATA_ARRAY && iot_data_array_type (data) == type && iot_data_array_length (data) == length)
+  iot_data_free (data);
+}
+
+static void test_data_from_json_arrays (void)
+{
+  iot_data_json_options_t options = { .arrays = true };
+  test_json_array (&options, "[1,2,255]", IOT_DATA_UINT8, 3u);
+  test_json_array (&options, "[-1,100]", IOT_DATA_INT8, 2u);
+  test_json_array (&options, "[0,65535]", IOT_DATA_UINT16, 2u);
+  test_json_array (&options, "[-32768]", IOT_DATA_INT16, 1u);
+  test_json_array (&options, "[70000]", IOT_DATA_UINT32, 1u);
+  test_json_array (&options, "[-40000,1]", IOT_DATA_INT32, 2u);
+  test_json_array (&options, "[5000000000,-1]", IOT_DATA_INT64, 2u);
+  test_json_array (&options, "[1.5,2,-0.25]", IOT_DATA_FLOAT32, 3u);
+  test_json_array (&options, "[1,2,1.2,3.4]", IOT_DATA_FLOAT64, 4u);
+
+  iot_data_t * data = iot_data_from_json_with_options ("[1,2,1.2,3.4]", &options);
+  if (data)
+  {
+    const double * vals = (const double*) iot_data_address (data);
+    CU_ASSERT (vals[0] == 1.0 && vals[1] == 2.0 && vals[2] == 1.2 && vals[3] == 3.4)
+  }
+  iot_data_free (data);
+  data = iot_data_from_json_with_options ("[-1,100]", &options);
+  CU_ASSERT (data && ((const int8_t*) iot_data_address (data))[0] == -1 && ((const int8_t*) iot_data_address (data))[1] == 100)
+  iot_data_free (data);
+
+  // Arrays with values other than numbers, and empty arrays, remain vectors
+
+  data = iot_data_from_json_with_options ("{\"a\":[1,\"x\",2.5],\"b\":[],\"c\":[[1,2],[0.5]],\"d\":[1,[2]],\"e\":[true]}", &options);
+  CU_ASSERT (data != NULL)
+  if (data)
+  {
+    const iot_data_t * vec = iot_data_string_map_get (data, "a");
+    CU_ASSERT (iot_data_type (vec) == IOT_DATA_VECTOR && iot_data_vector_size (vec) == 3u)
+    CU_ASSERT (iot_data_i64 (iot_data_vector_get (vec, 0)) == 1 && iot_data_f64 (iot_data_vector_get (vec, 2)) == 2.5)
+    CU_ASSERT (iot_data_type (iot_data_string_map_get (data, "b")) == IOT_DATA_VECTOR)
+    vec = iot_data_string_map_get (data, "c");
+    CU_ASSERT (iot_data_type (vec) == IOT_DATA_VECTOR && iot_data_vector_size (vec) == 2u)
+    CU_ASSERT (iot_data_array_type (iot_data_vector_get (vec, 0)) == IOT_DATA_UINT8)
+    CU_ASSERT (iot_data_array_type (iot_data_vector_get (vec, 1)) == IOT_DATA_FLOAT32)
+    vec = iot_data_string_map_get (data, "d");
+    CU_ASSERT (iot_data_type (iot_data_vector_get (vec, 0)) == IOT_DATA_INT64 && iot_data_type (iot_data_vector_get (vec, 1)) == IOT_DATA_ARRAY)
+    CU_ASSERT (iot_data_type (iot_data_string_map_get (data, "e")) == IOT_DATA_VECTOR)
+  }
+  iot_data_free (data);
+
+  // Large array
+
+  char * json = malloc (100000 * 8 + 3);
+  char * ptr = json;
+  *ptr++ = '[';
+  for (uint32_t i = 0; i < 100000; i++) ptr += sprintf (ptr, "%s%u.5", i ? "," : "", i % 1000u);
+  strcpy (ptr, "]");
+  test_json_array (&options, json, IOT_DATA_FLOAT32, 100000u);
+  free (json);
+
+  // Array type given
+
+  options.array_type = iot_typecode_alloc_array (IOT_DATA_FLOAT64);
+  test_json_array (&options, "[1,2]", IOT_DATA_FLOAT64, 2u);
+  options.array_type = iot_typecode_alloc_array (IOT_DATA_UINT8);
+  test_json_array (&options, "[1,2]", IOT_DATA_UINT8, 2u);
+  test_json_array (&options, "[]", IOT_DATA_UINT8, 0u); // Empty array of given type, as when decoded with typecode
+  data = iot_data_from_json_with_typecode ("[]", options.array_type);
+  CU_ASSERT (data && iot_data_array_is_of_type (data, IOT_DATA_UINT8) && iot_data_array_length (data) == 0u)
+  iot_data_free (data);
+  data = iot_data_from_json_with_options ("[1,300]", &options);
+  CU_ASSERT (data && iot_data_type (data) == IOT_DATA_VECTOR && iot_data_vector_size (data) == 2u)
+  iot_data_free (data);
+  data = iot_data_from_json_with_options ("[1,0.5]", &options);
+  CU_ASSERT (data && iot_data_type (data) == IOT_DATA_VECTOR && iot_data_f64 (iot_data_vector_get (data, 1)) == 0.5)
+  iot_data_free (data);
+}
+
+static iot_data_t * test_cbor_round_trip (const iot_data_t * data)
+{
+  uint32_t size = 0;
+  uint8_t * cbor = iot_data_to_cbor (data, &size);
+  iot_data_t * decoded = iot_data_from_cbor (cbor, size);
+  CU_ASSERT (decoded && iot_data_equal (data, decoded))
+  free (cbor);
+  return decoded;
+}
+
+static void test_cbor_encoding (const iot_data_t * data, const uint8_t * expected, uint32_t len)
+{
+  uint32_t size = 0;
+  uint8_t * cbor = iot_data_to_cbor (data, &size);
+  CU_ASSERT (size == len && memcmp (cbor, expected, len) == 0)
+  free (cbor);
+}
+
+static void test_data_cbor (void)
+{
+  static const uint8_t i64_cbor [] = { 0x38, 0x63 };
+  static const uint8_t u8_cbor [] = { 0xd9, 0xe0, 0x01, 0x18, 0xc8 };
+  static const uint8_t f64_cbor [] = { 0xfb, 0x3f, 0xf8, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 };
+  static const uint8_t map_cbor [] = { 0xa1, 0x61, 0x61, 0x82, 0xf5, 0x01 };
+  static const uint8_t bytes_cbor [] = { 0x43, 0x01, 0x02, 0x03 };
+  static const uint8_t empty_bytes_cbor [] = { 0x40 };
+  uint8_t bytes [] = { 1u, 2u, 3u };
+  int16_t shorts [] = { -1, 1000, INT16_MIN };
+  uint64_t longs [] = { 1u, UINT64_MAX };
+  double doubles [] = { 0.5, -1.0e300 };
+  bool bools [] = { true, false, true };
+
+  // Standard CBOR encoding of values with CBOR equivalents
+
+  iot_data_t * data = iot_data_alloc_i64 (-100);
+  test_cbor_encoding (data, i64_cbor, sizeof (i64_cbor));
+  iot_data_free (data);
+  data = iot_data_alloc_ui8 (200u);
+  test_cbor_encoding (data, u8_cbor, sizeof (u8_cbor));
+  iot_data_free (data);
+  data = iot_data_alloc_f64 (1.5);
+  test_cbor_encoding (data, f64_cbor, sizeof (f64_cbor));
+  iot_data_free (data);
+  data = iot_data_from_json ("{\"a\":[true,1]}");
+  test_cbor_encoding (data, map_cbor, sizeof (map_cbor));
+  iot_data_free (data);
+  data = iot_data_alloc_array (bytes, 3u, IOT_DATA_UINT8, IOT_DATA_REF);
+  test_cbor_encoding (data, bytes_cbor, sizeof (bytes_cbor));
+  iot_data_free (data);
+
+  // Empty byte string, arrays, map and vector
+
+  data = iot_data_from_cbor (empty_bytes_cbor, sizeof (empty_bytes_cbor));
+  CU_ASSERT (data && iot_data_array_is_of_type (data, IOT_DATA_UINT8) && iot_data_array_length (data) == 0u)
+  iot_data_free (data);
+  const iot_data_type_t empty_types [] = { IOT_DATA_UINT8, IOT_DATA_UINT16, IOT_DATA_FLOAT64, IOT_DATA_BOOL };
+  for (uint32_t i = 0; i < sizeof (empty_types) / sizeof (empty_types[0]); i++)
+  {
+    data = iot_data_alloc_array (NULL, 0u, empty_types[i], IOT_DATA_REF);
+    iot_data_free (test_cbor_round_trip (data));
+    iot_data_free (data);
+  }
+  data = iot_data_alloc_map (IOT_DATA_STRING);
+  iot_data_free (test_cbor_round_trip (data));
+  iot_data_free (data);
+  data = iot_data_alloc_vector (0u);
+  iot_data_free (test_cbor_round_trip (data));
+  iot_data_free (data);
+
+  // Round trip of all types, arrays, key types and metadata
+
+  iot_data_t * map = iot_data_alloc_map (IOT_DATA_STRING);
+  iot_data_string_map_add (map, "i8", iot_data_alloc_i8 (-128));
+  iot_data_string_map_add (map, "u8", iot_data_alloc_ui8 (255u));
+  iot_data_string_map_add (map, "i16", iot_data_alloc_i16 (-300));
+  iot_data_string_map_add (map, "u16", iot_data_alloc_ui16 (65535u));
+  iot_data_string_map_add (map, "i32", iot_data_alloc_i32 (INT32_MIN));
+  iot_data_string_map_add (map, "u32", iot_data_alloc_ui32 (UINT32_MAX));
+  iot_data_string_map_add (map, "i64", iot_data_alloc_i64 (INT64_MIN));
+  iot_data_string_map_add (map, "u64", iot_data_alloc_ui64 (5u));
+  iot_data_string_map_add (map, "u64max", iot_data_alloc_ui64 (UINT64_MAX));
+  iot_data_string_map_add (map, "f32", iot_data_alloc_f32 (0.1f));
+  iot_data_string_map_add (map, "f64", iot_data_alloc_f64 (0.1));
+  iot_data_string_map_add (map, "bool", iot_data_alloc_bool (false));
+  iot_data_string_map_add (map, "str", iot_data_alloc_string ("a string long enough to not be held inline in the string data", IOT_DATA_REF));
+  iot_data_string_map_add (map, "shorts", iot_data_alloc_array (shorts, 3u, IOT_DATA_INT16, IOT_DATA_REF));
+  iot_data_string_map_add (map, "longs", iot_data_alloc_array (longs, 2u, IOT_DATA_UINT64, IOT_DATA_REF));
+  iot_data_string_map_add (map, "doubles", iot_data_alloc_array (doubles, 2u, IOT_DATA_FLOAT64, IOT_DATA_REF));
+  iot_data_string_map_add (map, "bools", iot_data_alloc_array (bools, 3u, IOT_DATA_BOOL, IOT_DATA_REF));
+  iot_data_string_map_add (map, "empty", iot_data_alloc_map (IOT_DATA_UINT16));
+  iot_data_t * keyed = iot_data_alloc_map (IOT_DATA_INT8);
+  iot_data_map_add (keyed, iot_data_alloc_i8 (-1), iot_data_alloc_string ("minus one", IOT_DATA_REF));
+  iot_data_map_add (keyed, iot_data_alloc_i8 (100), iot_data_alloc_vector (0u));
+  iot_data_string_map_add (map, "keyed", keyed);
+  iot_data_t * vector = iot_data_alloc_vector (3u);
+  iot_data_vector_add (vector, 0u, iot_data_alloc_ui32 (7u));
+  iot_data_vector_add (vector, 1u, iot_data_alloc_string ("", IOT_DATA_REF));
+  iot_data_vector_add (vector, 2u, iot_data_from_json ("{\"nested\":{\"x\":[1.5,2]}}"));
+  iot_data_string_map_add (map, "vector", vector);
+  iot_data_t * meta = iot_data_alloc_map (IOT_DATA_STRING);
+  iot_data_string_map_add (meta, "units", iot_data_alloc_string ("mV", IOT_DATA_REF));
+  iot_data_set_metadata (vector, meta);
+  iot_data_free (meta);
+  data = test_cbor_round_trip (map);
+  const iot_data_t * decoded = iot_data_string_map_get (data, "vector");
+  CU_ASSERT (decoded && iot_data_get_metadata (decoded) && iot_data_equal (iot_data_get_metadata (decoded), iot_data_get_metadata (vector)))
+  CU_ASSERT (iot_data_map_key_type (iot_data_string_map_get (data, "empty")) == IOT_DATA_UINT16)
+
+  // Sink
+
+  test_sink_t sink = { 0 };
+  uint32_t size;
+  uint8_t * cbor = iot_data_to_cbor (map, &size);
+  CU_ASSERT (iot_data_to_cbor_sink (map, test_sink_write, &sink))
+  CU_ASSERT (sink.len == size && memcmp (sink.str, cbor, size) == 0)
+  free (sink.str);
+
+  // Truncated or trailing input is invalid
+
+  CU_ASSERT (iot_data_from_cbor (cbor, size - 1u) == NULL)
+  cbor = realloc (cbor, size + 1u);
+  cbor[size] = 0u;
+  CU_ASSERT (iot_data_from_cbor (cbor, size + 1u) == NULL)
+  free (cbor);
+  iot_data_free (data);
+  iot_data_free (map);
+
+  // Standard CBOR from other encoders
+
+  static const uint8_t indefinite [] = { 0x9f, 0x01, 0x7f, 0x61, 0x61, 0x61, 0x62, 0xff, 0xbf, 0x01, 0xf9, 0x3c, 0x00, 0xff, 0xff };
+  data = iot_data_from_cbor (indefinite, sizeof (indefinite));
+  CU_ASSERT (data && iot_data_vector_size (data) == 3u)
+  CU_ASSERT (data && strcmp (iot_data_string (iot_data_vector_get (data, 1u)), "ab") == 0)
+  const iot_data_t * int_map = data ? iot_data_vector_get (data, 2u) : NULL;
+  CU_ASSERT (int_map && iot_data_map_key_type (int_map) == IOT_DATA_INT64 && iot_data_map_size (int_map) == 1u)
+  iot_data_free (data);
+  static const uint8_t big_endian [] = { 0xc1, 0xd8, 0x41, 0x44, 0x00, 0x01, 0x01, 0x02 };
+  data = iot_data_from_cbor (big_endian, sizeof (big_endian));
+  CU_ASSERT (data && iot_data_array_type (data) == IOT_DATA_UINT16 && iot_data_array_length (data) == 2u)
+  CU_ASSERT (data && ((const uint16_t*) iot_data_address (data))[1] == 0x0102u)
+  iot_data_free (data);
+  static const uint8_t out_of_range [] = { 0xd9, 0xe0, 0x01, 0x19, 0x01, 0x00 };
+  CU_ASSERT (iot_data_from_cbor (out_of_range, sizeof (out_of_range)) == NULL)
+}
+
+static void test_data_schema (void)
+{
+  iot_typecode_t * f32 = iot_typecode_alloc_basic (IOT_DATA_FLOAT32);
+  iot_typecode_t * readings = iot_typecode_alloc_map (IOT_DATA_STRING, f32);
+  iot_data_t * keys = iot_data_from_json ("[\"Temperature\",\"Humidity\"]");
+  iot_data_schema_t * schema = iot_data_schema_alloc (readings, keys);
+  uint32_t size = 0;
+
+  // Known keys encoded as indexes, values with no type information
+
+  iot_data_t * data = iot_data_alloc_map (IOT_DATA_STRING);
+  iot_data_string_map_add (data, "Temperature", iot_data_alloc_f32 (21.5f));
+  iot_data_string_map_add (data, "Humidity", iot_data_alloc_f32 (40.0f));
+  uint8_t * buff = iot_data_schema_encode (schema, data, &size);
+  CU_ASSERT (buff && size == 11u && buff[0] == 2u && buff[1] == 1u && buff[6] == 2u)
+  iot_data_t * decoded = iot_data_schema_decode (schema, buff, size);
+  CU_ASSERT (decoded && iot_data_equal (data, decoded))
+  CU_ASSERT (iot_data_schema_decode (schema, buff, size - 1u) == NULL)
+  iot_data_free (decoded);
+  free (buff);
+
+  // Unknown keys encoded as strings
+
+  iot_data_string_map_add (data, "Pressure", iot_data_alloc_f32 (1013.25f));
+  buff = iot_data_schema_encode (schema, data, &size);
+  CU_ASSERT (buff && size == 25u)
+  decoded = iot_data_schema_decode (schema, buff, size);
+  CU_ASSERT (decoded && iot_data_equal (data, decoded))
+  iot_data_free (decoded);
+  free (buff);
+
+  // Data not matching the typecode
+
+  iot_data_string_map_add (data, "Status", iot_data_alloc_string ("OK", IOT_DATA_REF));
+  CU_ASSERT (iot_data_schema_encode (schema, data, &size) == NULL && size == 0u)
+  iot_data_free (data);
+  iot_data_schema_free (schema);
+
+  // Nested vectors, maps, arrays and elements of any type
+
+  iot_typecode_t * i16 = iot_typecode_alloc_basic (IOT_DATA_INT16);
+  iot_typecode_t * i16_vector = iot_typecode_alloc_vector (i16);
+  iot_typecode_t * any_vector = iot_typecode_alloc_vector (NULL);
+  iot_typecode_t * u8_map = iot_typecode_alloc_map (IOT_DATA_UINT8, any_vector);
+  iot_typecode_t * outer = iot_typecode_alloc_vector (u8_map);
+  schema = iot_data_schema_alloc (i16_vector, NULL);
+  data = iot_data_from_json_with_typecode ("[0,-1,1,-300,32767,-32768]", i16_vector);
+  buff = iot_data_schema_encode (schema, data, &size);
+  CU_ASSERT (buff && size == 12u && buff[0] == 6u && buff[1] == 0u && buff[2] == 1u && buff[3] == 2u)
+  decoded = iot_data_schema_decode (schema, buff, size);
+  CU_ASSERT (decoded && iot_data_equal (data, decoded))
+  iot_data_free (decoded);
+  free (buff);
+  iot_data_free (data);
+  static const uint8_t out_of_range [] = { 1u, 0x80u, 0x80u, 0x04u };
+  CU_ASSERT (iot_data_schema_decode (schema, out_of_range, sizeof (out_of_range)) == NULL)
+  iot_data_schema_free (schema);
+
+  float floats [] = { 1.5f, -2.0f };
+  schema = iot_data_schema_alloc (outer, NULL);
+  iot_data_t * any = iot_data_alloc_vector (4u);
+  iot_data_vector_add (any, 0u, iot_data_alloc_ui16 (7u));
+  iot_data_vector_add (any, 1u, iot_data_alloc_string ("any", IOT_DATA_REF));
+  iot_data_vector_add (any, 2u, iot_data_alloc_array (floats, 2u, IOT_DATA_FLOAT32, IOT_DATA_REF));
+  iot_data_vector_add (any, 3u, iot_data_alloc_bool (true));
+  iot_data_t * map = iot_data_alloc_map (IOT_DATA_UINT8);
+  iot_data_map_add (map, iot_data_alloc_ui8 (200u), any);
+  iot_data_map_add (map, iot_data_alloc_ui8 (1u), iot_data_alloc_vector (0u));
+  data = iot_data_alloc_vector (2u);
+  iot_data_vector_add (data, 0u, map);
+  iot_data_vector_add (data, 1u, iot_data_alloc_map (IOT_DATA_UINT8));
+  buff = iot_data_schema_encode (schema, data, &size);
+  decoded = buff ? iot_data_schema_decode (schema, buff, size) : NULL;
+  CU_ASSERT (decoded && iot_data_equal (data, decoded))
+  iot_data_free (decoded);
+  free (buff);
+  iot_data_free (data);
+  iot_data_schema_free (schema);
+
+  iot_data_free (keys);
+  iot_typecode_free (outer);
+  iot_typecode_free (u8_map);
+  iot_typecode_free (any_vector);
+  iot_typecode_free (i16_vector);
+  iot_typecode_free (readings);
+}
+
+static void test_data_snapshot (void)
+{
+  int16_t shorts [] = { -1, 2, 300 };
+  const char * path = "/tmp/iot_data_snapshot_test.bin";
+  iot_data_t * data = iot_data_from_json ("{\"Name\":\"Catalogue\",\"Version\":3,\"Scale\":0.5,\"Enabled\":true,\"Profiles\":[{\"Id\":1},{\"Id\":2,\"Tags\":[\"a\",\"b\"]}],\"Empty\":{}}");
+  iot_data_t * table = iot_data_alloc_map (IOT_DATA_UINT16);
+  for (uint16_t i = 0; i < 100u; i++) iot_data_map_add (table, iot_data_alloc_ui16 (i * 7u), iot_data_alloc_ui32 (i));
+  iot_data_string_map_add (data, "Table", table);
+  iot_data_string_map_add (data, "Shorts", iot_data_alloc_array (shorts, 3u, IOT_DATA_INT16, IOT_DATA_REF));
+
+  uint32_t size = 0;
+  uint8_t * image = iot_data_to_snapshot (data, &size);
+  CU_ASSERT (iot_data_snapshot_root (image, size - 1u) == NULL)
+  const iot_data_snapshot_t * root = iot_data_snapshot_root (image, size);
+  CU_ASSERT_FATAL (root != NULL)
+  CU_ASSERT (iot_data_snapshot_type (root) == IOT_DATA_MAP && iot_data_snapshot_size (root) == 8u)
+  CU_ASSERT (iot_data_snapshot_map_key_type (root) == IOT_DATA_STRING)
+  CU_ASSERT (strcmp (iot_data_snapshot_string (iot_data_snapshot_string_map_get (root, "Name")), "Catalogue") == 0)
+  CU_ASSERT (*(const int64_t*) iot_data_snapshot_address (iot_data_snapshot_string_map_get (root, "Version")) == 3)
+  CU_ASSERT (*(const double*) iot_data_snapshot_address (iot_data_snapshot_string_map_get (root, "Scale")) == 0.5)
+  CU_ASSERT (iot_data_snapshot_string_map_get (root, "Missing") == NULL)
+  const iot_data_snapshot_t * profiles = iot_data_snapshot_string_map_get (root, "Profiles");
+  CU_ASSERT (iot_data_snapshot_type (profiles) == IOT_DATA_VECTOR && iot_data_snapshot_size (profiles) == 2u)
+  const iot_data_snapshot_t * tags = iot_data_snapshot_string_map_get (iot_data_snapshot_vector_get (profiles, 1u), "Tags");
+  CU_ASSERT (strcmp (iot_data_snapshot_string (iot_data_snapshot_vector_get (tags, 1u)), "b") == 0)
+  CU_ASSERT (iot_data_snapshot_size (iot_data_snapshot_string_map_get (root, "Empty")) == 0u)
+  CU_ASSERT (iot_data_snapshot_string_map_get (iot_data_snapshot_string_map_get (root, "Empty"), "Id") == NULL)
+  const iot_data_snapshot_t * stable = iot_data_snapshot_string_map_get (root, "Table");
+  bool found = true;
+  for (uint16_t i = 0; i < 100u; i++)
+  {
+    iot_data_t * key = iot_data_alloc_ui16 (i * 7u);
+    const iot_data_snapshot_t * val = iot_data_snapshot_map_get (stable, key);
+    found = found && val && *(const uint32_t*) iot_data_snapshot_address (val) == i;
+    iot_data_free (key);
+  }
+  CU_ASSERT (found)
+  CU_ASSERT (strcmp (iot_data_snapshot_string (iot_data_snapshot_map_key (root, 1u)), "Version") == 0)
+  const iot_data_snapshot_t * sarray = iot_data_snapshot_string_map_get (root, "Shorts");
+  CU_ASSERT (iot_data_snapshot_array_type (sarray) == IOT_DATA_INT16 && iot_data_snapshot_size (sarray) == 3u)
+  CU_ASSERT (((const int16_t*) iot_data_snapshot_address (sarray))[2] == 300)
+  iot_data_t * copy = iot_data_snapshot_copy (root);
+  CU_ASSERT (iot_data_equal (data, copy))
+  iot_data_free (copy);
+
+  // Memory mapped from file
+
+  FILE * fd = fopen (path, "wb");
+  CU_ASSERT_FATAL (fd != NULL)
+  CU_ASSERT (fwrite (image, size, 1u, fd) == 1u)
+  fclose (fd);
+  size_t len = 0;
+  const uint8_t * mapped = iot_file_map (path, &len);
+  CU_ASSERT (mapped && len == size)
+  root = mapped ? iot_data_snapshot_root (mapped, len) : NULL;
+  copy = root ? iot_data_snapshot_copy (root) : NULL;
+  CU_ASSERT (copy && iot_data_equal (data, copy))
+  iot_data_free (copy);
+  iot_file_unmap (mapped, len);
+  remove (path);
+  CU_ASSERT (iot_file_map (path, &len) == NULL && len == 0u)
+  free (image);
+  iot_data_free (data);
+}
+
+static void test_data_from_json_strings (void)
+{
+  const iot_data_json_options_t options = { .string_views = true };
+  const char * json = "{\"short\":\"abc\",\"a long key name that is not held inline\":\"a long string value that is not held inline\","
+    "\"escaped\":\"a long string value that is escaped \\\"quoted\\\" so copied\",\"list\":[\"x\",\"another long string value in a vector\"]}";
+  iot_data_t * data = iot_data_from_json_with_options (json, &options);
+  iot_data_t * copied = iot_data_from_json (json);
+  CU_ASSERT (data && iot_data_equal (data, copied))
+  CU_ASSERT (iot_data_string_map_get_string (data, "short") && strcmp (iot_data_string_map_get_string (data, "short"), "abc") == 0)
+  const char * str = iot_data_string_map_get_string (data, "a long key name that is not held inline");
+  CU_ASSERT (str && strcmp (str, "a long string value that is not held inline") == 0)
+  str = iot_data_string_map_get_string (data, "escaped");
+  CU_ASSERT (str && strcmp (str, "a long string value that is escaped \"quoted\" so copied") == 0)
+  const iot_data_t * list = iot_data_string_map_get (data, "list");
+  CU_ASSERT (list && iot_data_vector_size (list) == 2u)
+
+  // Strings remain valid after the rest of the tree is freed
+
+  iot_data_t * kept = (iot_data_t*) iot_data_vector_get (list, 1u);
+  iot_data_add_ref (kept);
+  iot_data_t * copy = iot_data_copy (iot_data_string_map_get (data, "a long key name that is not held inline"));
+  char * out = iot_data_to_json (data);
+  iot_data_free (data);
+  CU_ASSERT (strcmp (iot_data_string (kept), "another long string value in a vector") == 0)
+  CU_ASSERT (strcmp (iot_data_string (copy), "a long string value that is not held inline") == 0)
+  data = iot_data_from_json (out);
+  CU_ASSERT (iot_data_equal (data, copied))
+  iot_data_free (kept);
+  iot_data_free (copy);
+  iot_data_free (copied);
+  iot_data_free (data);
+  free (out);
+
+  // Escaped NUL rejected rather than truncating the string
+
+  const char * nuls [] = { "\"\\u0000x\"", "[\"a\\u0000\"]", "{\"\\u0000\":1}", "{\"k\":\"x\\u0000\"}" };
+  for (uint32_t i = 0; i < sizeof (nuls) / sizeof (nuls[0]); i++)
+  {
+    CU_ASSERT (iot_data_from_json (nuls[i]) == NULL)
+    CU_ASSERT (iot_data_from_json_with_options (nuls[i], &options) == NULL)
+    CU_ASSERT (iot_data_from_json_lazy (nuls[i]) == NULL)
+  }
+  data = iot_data_from_json ("[\"\\\\u0000\"]"); // Escaped backslash, not an escaped NUL
+  CU_ASSERT (data && strcmp (iot_data_string (iot_data_vector_get (data, 0u)), "\\u0000") == 0)
+  iot_data_free (data);
+}
+
+static void test_data_from_json_lazy (void)
+{
+  const char * json = "{\"Name\":\"sensor\",\"Esc\":\"a\\\"b\\u00e9\",\"Values\":[1, 2.50 ,-3],\"Config\":{\"Rate\":10,\"On\":true,\"Tags\":[\"x\",null]},\"Empty\":{}}";
+  iot_data_t * eager = iot_data_from_json (json);
+  iot_data_t * data = iot_data_from_json_lazy (json);
+  CU_ASSERT (data && iot_data_type (data) == IOT_DATA_MAP)
+  CU_ASSERT (iot_data_map_key_type (data) == IOT_DATA_STRING)
+
+  // Unaccessed maps and vectors converted back to json as the original text
+
+  char * out = iot_data_to_json (data);
+  CU_ASSERT (strncmp (out, json, strlen (json) - 22u) == 0 && strcmp (out + strlen (json) - 22u, "\"x\",\"null\"]},\"Empty\":{}}") == 0)
+  free (out);
+  const iot_data_t * config = iot_data_string_map_get (data, "Config");
+  CU_ASSERT (config && iot_data_type (config) == IOT_DATA_MAP)
+  CU_ASSERT (strcmp (iot_data_string_map_get_string (data, "Esc"), "a\"b\xc3\xa9") == 0)
+  out = iot_data_to_json (data);
+  CU_ASSERT (strstr (out, "\"Values\":[1, 2.50 ,-3]") != NULL)
+  free (out);
+  iot_data_t * copy = iot_data_copy (config);
+  CU_ASSERT (iot_data_string_map_get_i64 (config, "Rate", 0) == 10)
+  const iot_data_t * tags = iot_data_string_map_get_vector (config, "Tags");
+  CU_ASSERT (tags && iot_data_vector_size (tags) == 2u)
+  CU_ASSERT (strcmp (iot_data_string (iot_data_vector_get (tags, 1u)), "null") == 0)
+  iot_data_vector_iter_t iter;
+  iot_data_vector_iter (iot_data_string_map_get (data, "Values"), &iter);
+  CU_ASSERT (iot_data_vector_iter_next (&iter) && iot_data_i64 (iot_data_vector_iter_value (&iter)) == 1)
+  CU_ASSERT (iot_data_vector_iter_next (&iter) && iot_data_f64 (iot_data_vector_iter_value (&iter)) == 2.5)
+  CU_ASSERT (iot_data_equal (data, eager))
+  CU_ASSERT (iot_data_equal (copy, config))
+  iot_data_free (data);
+  CU_ASSERT (iot_data_string_map_get_bool (copy, "On", false))
+  iot_data_free (copy);
+
+  // Freed without access, json not a strict object or array converted as by iot_data_from_json
+
+  iot_data_free (iot_data_from_json_lazy (json));
+  data = iot_data_from_json_lazy ("[1,{\"a\":2 \"b\":3}]");
+  CU_ASSERT (data && iot_data_vector_size (data) == 2u)
+  iot_data_free (data);
+  data = iot_data_from_json_lazy ("\"str\"");
+  CU_ASSERT (data && iot_data_type (data) == IOT_DATA_STRING)
+  iot_data_free (data);
+  CU_ASSERT (iot_data_from_json_lazy ("{\"a\":[1,2}") == NULL)
+  iot_data_free (eager);
+
+  // Json written before access matches json written once built
+
+  const char * built [] = { "[null,{\"n\":null}]", "{\"a\":1,\"a\":2}", "[{\"a\":[1],\"b\":{},\"a\":true}]", "{\"a\\u0062\":1,\"ab\":2}", "[true,false,-0.5,1e3]" };
+  for (uint32_t i = 0; i < sizeof (built) / sizeof (built[0]); i++)
+  {
+    data = iot_data_from_json_lazy (built[i]);
+    eager = iot_data_from_json (built[i]);
+    out = iot_data_to_json (data);
+    char * expected = iot_data_to_json (eager);
+    CU_ASSERT (iot_data_equal (data, eager))
+    char * accessed = iot_data_to_json (data);
+    CU_ASSERT (strcmp (accessed, expected) == 0)
+    CU_ASSERT (strcmp (out, (i == 4u) ? built[i] : accessed) == 0) // Number formatting retained until built
+    free (accessed);
+    free (expected);
+    free (out);
+    iot_data_free (eager);
+    iot_data_free (data);
+  }
+  CU_ASSERT (iot_data_from_json_lazy ("[tru, nul]") == NULL)
+  CU_ASSERT (iot_data_from_json_lazy ("{\"a\":abc}") == NULL)
+}
+
+static void test_json_parsed (void * arg, iot_data_t * data)
+{
+  iot_data_t * vec = (iot_data_t*) arg;
+  uint32_t size = iot_data_vector_size (vec);
+  iot_data_vector_resize (vec, size + 1u);
+  iot_data_vector_add (vec, size, data);
+}
+
+static void test_data_json_parser (void)
+{
+  const char * json = "{\"Str\":\"a\\\"b\\\\c\\n\\u00e9\\ud83d\\ude00\",\"Neg\":-42,\"Real\":-1.5e3,\"Vec\":[1,[2,3],{}, [] ,\"x\"],"
+    "\"T\":true,\"N\":null,bare:7}";
+  size_t len = strlen (json);
+  iot_data_t * expected = iot_data_from_json (json);
+  iot_data_t * results = iot_data_alloc_vector (0);
+  iot_data_json_parser_t * parser = iot_data_json_parser_alloc (test_json_parsed, results);
+
+  // Split input at every position, then push a byte at a time
+
+  for (size_t split = 0; split <= len; split++)
+  {
+    CU_ASSERT (iot_data_json_parser_push (parser, json, split))
+    CU_ASSERT (iot_data_json_parser_push (parser, json + split, len - split))
+    CU_ASSERT (iot_data_json_parser_finish (parser))
+  }
+  for (size_t i = 0; i < len; i++) CU_ASSERT (iot_data_json_parser_push (parser, json + i, 1u))
+  CU_ASSERT (iot_data_json_parser_finish (parser))
+  CU_ASSERT (iot_data_vector_size (results) == len + 2u)
+  for (uint32_t i = 0; i < iot_data_vector_size (results); i++) CU_ASSERT (iot_data_equal (iot_data_vector_get (results, i), expected))
+  iot_data_vector_resize (results, 0);
+
+  // Concatenated and newline delimited documents, trailing number completed on finish
+
+  const char * stream = "{\"a\":1}\n[2]\"three\" 4 {\"b\":{}}\n5";
+  for (size_t i = 0; stream[i]; i++) CU_ASSERT (iot_data_json_parser_push (parser, stream + i, 1u))
+  CU_ASSERT (iot_data_vector_size (results) == 5u)
+  CU_ASSERT (iot_data_json_parser_finish (parser))
+  CU_ASSERT (iot_data_vector_size (results) == 6u)
+  if (iot_data_vector_size (results) == 6u)
+  {
+    CU_ASSERT (iot_data_string_map_get_i64 (iot_data_vector_get (results, 0), "a", 0) == 1)
+    CU_ASSERT (iot_data_type (iot_data_vector_get (results, 1)) == IOT_DATA_VECTOR)
+    CU_ASSERT (strcmp (iot_data_string (iot_data_vector_get (results, 2)), "three") == 0)
+    CU_ASSERT (iot_data_i64 (iot_data_vector_get (results, 3)) == 4)
+    CU_ASSERT (iot_data_type (iot_data_vector_get (results, 4)) == IOT_DATA_MAP)
+    CU_ASSERT (iot_data_i64 (iot_data_vector_get (results, 5)) == 5)
+  }
+  iot_data_vector_resize (results, 0);
+
+  // Invalid and incomplete input
+
+  const char * invalid [] = { "{\"a\" 1}", "{\"a\":}", "\"\\q\"", "\"\\u12g4\"", "]", "{\"a\":[1,}", "{\"a\":1]", ":", "{[1]:2}" };
+  for (uint32_t i = 0; i < sizeof (invalid) / sizeof (invalid[0]); i++)
+  {
+    CU_ASSERT (! iot_data_json_parser_push (parser, invalid[i], strlen (invalid[i])))
+    CU_ASSERT (! iot_data_json_parser_finish (parser))
+  }
+  const char * incomplete [] = { "{", "[1,2", "\"abc", "{\"a\":[1,2]" };
+  for (uint32_t i = 0; i < sizeof (incomplete) / sizeof (incomplete[0]); i++)
+  {
+    CU_ASSERT (iot_data_json_parser_push (parser, incomplete[i], strlen (incomplete[i])))
+    CU_ASSERT (! iot_data_json_parser_finish (parser))
+  }
+  CU_ASSERT (iot_data_vector_size (results) == 0u)
+
+  // Parser reusable after error, incomplete value freed with parser
+
+  CU_ASSERT (iot_data_json_parser_push (parser, "[true]{\"x\":[", 12u))
+  CU_ASSERT (iot_data_vector_size (results) == 1u)
+  iot_data_json_parser_free (parser);
+  iot_data_free (results);
+  iot_data_free (expected);
+}
+
 #ifdef IOT_HAS_XML
 static void test_data_from_xml (void)
 {
@@ -1401,6 +2258,37 @@ static void test_data_vector_resize (void)
   iot_data_free (vector);
 }
 
+static void test_data_vector_grow_shrink (void)
+{
+  iot_data_t * vector = iot_data_alloc_vector (0);
+  for (uint32_t i = 0; i < 200; i++)
+  {
+    iot_data_vector_resize (vector, i + 1u);
+    CU_ASSERT (iot_data_vector_get (vector, i) == NULL)
+    iot_data_vector_add (vector, i, iot_data_alloc_ui32 (i));
+  }
+  CU_ASSERT (iot_data_vector_size (vector) == 200)
+  for (uint32_t i = 0; i < 200; i++)
+  {
+    CU_ASSERT (iot_data_ui32 (iot_data_vector_get (vector, i)) == i)
+  }
+  iot_data_vector_resize (vector, 10);
+  CU_ASSERT (iot_data_vector_size (vector) == 10)
+  CU_ASSERT (iot_data_ui32 (iot_data_vector_get (vector, 9)) == 9u)
+  iot_data_vector_resize (vector, 3);
+  iot_data_vector_resize (vector, 40);
+  CU_ASSERT (iot_data_ui32 (iot_data_vector_get (vector, 2)) == 2u)
+  for (uint32_t i = 3; i < 40; i++)
+  {
+    CU_ASSERT (iot_data_vector_get (vector, i) == NULL)
+  }
+  iot_data_vector_resize (vector, 0);
+  CU_ASSERT (iot_data_vector_size (vector) == 0)
+  iot_data_vector_resize (vector, 1);
+  CU_ASSERT (iot_data_vector_get (vector, 0) == NULL)
+  iot_data_free (vector);
+}
+
 static void test_data_vector_find (void)
 {
   iot_data_t * vector = iot_data_alloc_vector (3);
@@ -2287,6 +3175,34 @@ static void test_data_alloc_array_bool (void)
   iot_data_free (array2);
 }
 
+static void test_data_alloc_array_copy_sizes (void)
+{
+  uint16_t data [1024];
+  const uint32_t lengths [] = { 1u, 3u, 8u, 9u, 32u, 100u, 128u, 129u, 1024u };
+
+  for (uint32_t i = 0; i < sizeof (data) / sizeof (data[0]); i++) data[i] = (uint16_t) (i * 7u);
+  for (uint32_t i = 0; i < sizeof (lengths) / sizeof (lengths[0]); i++)
+  {
+    iot_data_t * array1 = iot_data_alloc_array (data, lengths[i], IOT_DATA_UINT16, IOT_DATA_COPY);
+    iot_data_t * array2 = iot_data_alloc_array (data, lengths[i], IOT_DATA_UINT16, IOT_DATA_REF);
+    const uint16_t * copied = iot_data_address (array1);
+
+    CU_ASSERT (copied != data)
+    CU_ASSERT (iot_data_array_length (array1) == lengths[i])
+    CU_ASSERT (iot_data_array_size (array1) == lengths[i] * sizeof (uint16_t))
+    CU_ASSERT (memcmp (copied, data, lengths[i] * sizeof (uint16_t)) == 0)
+    CU_ASSERT (iot_data_equal (array1, array2))
+
+    iot_data_t * array3 = iot_data_copy (array1);
+    CU_ASSERT (iot_data_address (array3) != copied)
+    CU_ASSERT (iot_data_equal (array1, array3))
+
+    iot_data_free (array1);
+    iot_data_free (array2);
+    iot_data_free (array3);
+  }
+}
+
 static void test_data_zerolength_vector (void)
 {
   iot_data_t * vector1 = iot_data_alloc_vector (0);
@@ -2526,6 +3442,280 @@ static void test_data_type_typecode (void)
   iot_typecode_free (tc);
 }
 
+#define DATA_THREADS 4
+#define DATA_THREAD_ITERS 2000
+
+static void * data_thread_fn (void * arg)
+{
+  iot_data_t * vector = (iot_data_t*) arg;
+  for (uint32_t i = 0; i < DATA_THREAD_ITERS; i++)
+  {
+    iot_data_t * map = iot_data_alloc_map (IOT_DATA_STRING);
+    iot_data_string_map_add (map, "Name", iot_data_alloc_string ("A string too long for the value buffer", IOT_DATA_COPY));
+    iot_data_string_map_add (map, "Value", iot_data_alloc_ui32 (i));
+    iot_data_free (map);
+  }
+  iot_data_free (vector); // Free blocks allocated by another thread
+  return NULL;
+}
+
+static void test_data_thread_cache (void)
+{
+  pthread_t threads [DATA_THREADS];
+  for (int i = 0; i < DATA_THREADS; i++)
+  {
+    iot_data_t * vector = iot_data_alloc_vector (DATA_THREAD_ITERS);
+    for (uint32_t j = 0; j < DATA_THREAD_ITERS; j++)
+    {
+      iot_data_vector_add (vector, j, iot_data_alloc_i32 ((int32_t) j));
+    }
+    CU_ASSERT (pthread_create (&threads[i], NULL, data_thread_fn, vector) == 0)
+  }
+  for (int i = 0; i < DATA_THREADS; i++)
+  {
+    pthread_join (threads[i], NULL);
+  }
+  iot_data_t * data = iot_data_alloc_string ("Hello", IOT_DATA_COPY);
+  CU_ASSERT (strcmp (iot_data_string (data), "Hello") == 0)
+  iot_data_free (data);
+}
+
+static void test_data_map_index (void)
+{
+  char key [16];
+  iot_data_map_iter_t iter;
+  iot_data_t * map = iot_data_alloc_map (IOT_DATA_STRING);
+  iot_data_t * imap = iot_data_alloc_map (IOT_DATA_UINT32);
+  for (uint32_t i = 0; i < 1000; i++)
+  {
+    sprintf (key, "Key%u", i);
+    iot_data_map_add (map, iot_data_alloc_string (key, IOT_DATA_COPY), iot_data_alloc_ui32 (i));
+    iot_data_map_add (imap, iot_data_alloc_ui32 (i), iot_data_alloc_ui32 (i));
+  }
+  iot_data_string_map_add (map, "Key10", iot_data_alloc_ui32 (10)); // Replace existing value
+  CU_ASSERT (iot_data_map_size (map) == 1000)
+  for (uint32_t i = 0; i < 1000; i++)
+  {
+    sprintf (key, "Key%u", i);
+    const iot_data_t * val = iot_data_string_map_get (map, key);
+    CU_ASSERT (val && iot_data_ui32 (val) == i)
+    iot_data_t * ikey = iot_data_alloc_ui32 (i);
+    val = iot_data_map_get (imap, ikey);
+    CU_ASSERT (val && iot_data_ui32 (val) == i)
+    if (i % 2) CU_ASSERT (iot_data_map_remove (imap, ikey))
+    iot_data_free (ikey);
+    if (i % 2) CU_ASSERT (iot_data_string_map_remove (map, key))
+  }
+  CU_ASSERT (iot_data_map_size (map) == 500)
+  CU_ASSERT (iot_data_map_size (imap) == 500)
+  CU_ASSERT (iot_data_string_map_get (map, "Key1") == NULL)
+  CU_ASSERT (iot_data_string_map_get (map, "Key998") != NULL)
+  uint32_t expected = 0;
+  iot_data_map_iter (map, &iter); // Check insertion order retained
+  while (iot_data_map_iter_next (&iter))
+  {
+    CU_ASSERT (iot_data_ui32 (iot_data_map_iter_value (&iter)) == expected)
+    expected += 2;
+  }
+  CU_ASSERT (expected == 1000)
+  iot_data_free (map);
+  iot_data_free (imap);
+}
+
+static void test_data_string_intern (void)
+{
+  char name [8];
+  strcpy (name, "Temp");
+  iot_data_t * s1 = iot_data_alloc_string_intern ("Temp");
+  iot_data_t * s2 = iot_data_alloc_string_intern (name);
+  iot_data_t * s3 = iot_data_alloc_string ("Temp", IOT_DATA_COPY);
+  iot_data_t * s4 = iot_data_alloc_string_intern ("Origin");
+  CU_ASSERT (iot_data_string_is_interned (s1))
+  CU_ASSERT (! iot_data_string_is_interned (s3))
+  CU_ASSERT (iot_data_string (s1) == iot_data_string (s2))
+  CU_ASSERT (iot_data_string (s2) != name)
+  CU_ASSERT (iot_data_equal (s1, s2))
+  CU_ASSERT (iot_data_equal (s1, s3))
+  CU_ASSERT (! iot_data_equal (s1, s4))
+  iot_data_t * copy = iot_data_copy (s1);
+  CU_ASSERT (iot_data_string_is_interned (copy))
+  CU_ASSERT (iot_data_string (copy) == iot_data_string (s1))
+  iot_data_t * map = iot_data_alloc_map (IOT_DATA_STRING);
+  for (uint32_t i = 0; i < 20; i++)
+  {
+    char key [16];
+    sprintf (key, "Key%u", i);
+    iot_data_map_add (map, iot_data_alloc_string_intern (key), iot_data_alloc_ui32 (i));
+  }
+  iot_data_map_add (map, s1, iot_data_alloc_ui32 (100));
+  CU_ASSERT (iot_data_ui32 (iot_data_map_get (map, s2)) == 100)
+  CU_ASSERT (iot_data_ui32 (iot_data_map_get (map, s3)) == 100)
+  CU_ASSERT (iot_data_ui32 (iot_data_string_map_get (map, "Key7")) == 7)
+  CU_ASSERT (iot_data_map_get (map, s4) == NULL)
+  iot_data_free (map);
+  iot_data_free (copy);
+  iot_data_free (s2);
+  iot_data_free (s3);
+  iot_data_free (s4);
+}
+
+static void test_data_string_map_get_with_hash (void)
+{
+  char key [16];
+  iot_data_t * map = iot_data_alloc_map (IOT_DATA_STRING);
+  iot_data_t * imap = iot_data_alloc_map (IOT_DATA_INT32);
+  iot_data_map_add (imap, iot_data_alloc_i32 (1), iot_data_alloc_i32 (1));
+  for (uint32_t i = 0; i < 4; i++)
+  {
+    sprintf (key, "Key%u", i);
+    iot_data_map_add (map, iot_data_alloc_string (key, IOT_DATA_COPY), iot_data_alloc_i64 (i));
+  }
+  CU_ASSERT (iot_data_string_map_get_i64 (map, "Key2", -1) == 2)
+  CU_ASSERT (iot_data_i64 (iot_data_string_map_get_with_hash (map, "Key3", iot_hash ("Key3"))) == 3)
+  for (uint32_t i = 4; i < 40; i++)
+  {
+    sprintf (key, "Key%u", i);
+    iot_data_map_add (map, iot_data_alloc_string (key, IOT_DATA_COPY), iot_data_alloc_i64 (i));
+  }
+  CU_ASSERT (iot_data_string_map_get_i64 (map, "Key2", -1) == 2)
+  CU_ASSERT (iot_data_string_map_get_i64 (map, "Key39", -1) == 39)
+  CU_ASSERT (iot_data_string_map_get_i64 (map, "Key40", -1) == -1)
+  CU_ASSERT (iot_data_i64 (iot_data_string_map_get_with_hash (map, "Key30", iot_hash ("Key30"))) == 30)
+  CU_ASSERT (iot_data_string_map_remove (map, "Key30"))
+  CU_ASSERT (! iot_data_string_map_remove (map, "Key30"))
+  CU_ASSERT (iot_data_string_map_get_with_hash (map, "Key30", iot_hash ("Key30")) == NULL)
+  CU_ASSERT (iot_data_map_size (map) == 39)
+  CU_ASSERT (iot_data_string_map_get (imap, "Key1") == NULL)
+  CU_ASSERT (! iot_data_string_map_remove (imap, "Key1"))
+  iot_data_free (map);
+  iot_data_free (imap);
+}
+
+static void test_data_arena (void)
+{
+  char key [16];
+  char * json;
+  iot_data_t * outside = iot_data_alloc_string ("A heap allocated string held by the arena", IOT_DATA_COPY);
+  iot_data_t * meta = iot_data_alloc_map (IOT_DATA_STRING);
+  iot_data_arena_t * arena = iot_data_arena_alloc ();
+  iot_data_arena_begin (arena);
+  iot_data_t * map = iot_data_alloc_map (IOT_DATA_STRING);
+  iot_data_t * vec = iot_data_alloc_vector (2);
+  iot_data_vector_add (vec, 0, iot_data_alloc_string ("A long string allocated from the arena", IOT_DATA_COPY));
+  iot_data_vector_add (vec, 1, iot_data_alloc_i32 (1));
+  iot_data_vector_resize (vec, 3);
+  iot_data_vector_add (vec, 2, outside);
+  for (uint32_t i = 0; i < 20; i++)
+  {
+    sprintf (key, "Key%u", i);
+    iot_data_map_add (map, iot_data_alloc_string (key, IOT_DATA_COPY), iot_data_alloc_i64 (i));
+  }
+  iot_data_string_map_add (map, "Key0", iot_data_alloc_i64 (100));
+  iot_data_string_map_add (map, "Vector", vec);
+  CU_ASSERT (iot_data_string_map_remove (map, "Key1"))
+  iot_data_set_metadata (map, meta);
+  iot_data_free (meta);
+  iot_data_free (vec);
+  iot_data_arena_end (arena);
+  CU_ASSERT (iot_data_map_size (map) == 20)
+  CU_ASSERT (iot_data_string_map_get_i64 (map, "Key0", 0) == 100)
+  CU_ASSERT (iot_data_string_map_get_i64 (map, "Key19", 0) == 19)
+  iot_data_t * copy = iot_data_copy (map);
+  CU_ASSERT (iot_data_equal (copy, map))
+  json = iot_data_to_json (map);
+  CU_ASSERT (json && strstr (json, "\"Key19\":19"))
+  free (json);
+  iot_data_arena_reset (arena);
+  iot_data_arena_begin (arena);
+  iot_data_t * val = iot_data_alloc_string ("Allocated after reset", IOT_DATA_COPY);
+  iot_data_arena_end (arena);
+  CU_ASSERT (strcmp (iot_data_string (val), "Allocated after reset") == 0)
+  iot_data_arena_free (arena);
+  CU_ASSERT (iot_data_map_size (copy) == 20)
+  CU_ASSERT (iot_data_string_map_get_i64 (copy, "Key0", 0) == 100)
+  CU_ASSERT (strcmp (iot_data_string (iot_data_vector_get (iot_data_string_map_get (copy, "Vector"), 2)), "A heap allocated string held by the arena") == 0)
+  CU_ASSERT (iot_data_get_metadata (copy) != NULL)
+  iot_data_free (copy);
+}
+
+static void test_data_stats (void)
+{
+  iot_data_stats_t before;
+  iot_data_stats_t during;
+  iot_data_stats_t after;
+  iot_data_stats (&before);
+  iot_data_t * map = iot_data_alloc_map (IOT_DATA_STRING);
+  iot_data_string_map_add (map, "Short", iot_data_alloc_string ("Inline", IOT_DATA_COPY));
+  iot_data_string_map_add (map, "Medium", iot_data_alloc_string ("A string too long to be held inline", IOT_DATA_COPY));
+  char * str = calloc (1, 301);
+  memset (str, 'X', 300);
+  iot_data_string_map_add (map, "Long", iot_data_alloc_string (str, IOT_DATA_COPY));
+  free (str);
+  iot_data_stats (&during);
+  CU_ASSERT (during.live[IOT_DATA_MAP] == before.live[IOT_DATA_MAP] + 1u)
+  CU_ASSERT (during.live[IOT_DATA_STRING] == before.live[IOT_DATA_STRING] + 6u)
+  CU_ASSERT (during.strings_inline == before.strings_inline + 1u)
+  CU_ASSERT (during.strings_block == before.strings_block + 1u)
+  CU_ASSERT (during.strings_heap == before.strings_heap + 1u)
+  CU_ASSERT (during.blocks_in_use == before.blocks_in_use + 11u) // Map, 3 pairs, 6 strings and 1 string block
+  CU_ASSERT (during.blocks_peak_sampled >= during.blocks_in_use)
+  CU_ASSERT (during.blocks_allocated == during.blocks_in_use + during.blocks_cached)
+  iot_data_free (map);
+  iot_data_stats (&after);
+  CU_ASSERT (after.live[IOT_DATA_MAP] == before.live[IOT_DATA_MAP])
+  CU_ASSERT (after.live[IOT_DATA_STRING] == before.live[IOT_DATA_STRING])
+  CU_ASSERT (after.blocks_in_use == before.blocks_in_use)
+  CU_ASSERT (after.blocks_peak_sampled >= during.blocks_in_use)
+
+  // String with embedded NUL held in a block sized from its decoded length
+  uint8_t cbor [103] = { 0x78, 101u, 0u };
+  memset (cbor + 3, 'X', 100);
+  iot_data_t * val = iot_data_from_cbor (cbor, sizeof (cbor));
+  iot_data_stats (&during);
+  CU_ASSERT (during.strings_block == after.strings_block + 1u)
+  iot_data_free (val);
+  iot_data_stats (&after);
+  CU_ASSERT (after.blocks_in_use == before.blocks_in_use)
+  CU_ASSERT (after.blocks_allocated == after.blocks_in_use + after.blocks_cached)
+}
+
+static void test_data_cache_trim (void)
+{
+  iot_data_stats_t before;
+  iot_data_stats_t after;
+  iot_data_t * vector = iot_data_alloc_vector (10000);
+  for (uint32_t i = 0; i < 10000; i++)
+  {
+    iot_data_vector_add (vector, i, iot_data_alloc_ui32 (i));
+  }
+  iot_data_free (vector);
+  iot_data_stats (&before);
+  iot_data_cache_set_limit (0);
+  uint32_t released = iot_data_cache_trim ();
+  iot_data_stats (&after);
+  if (before.chunks) // Data block cache enabled
+  {
+    CU_ASSERT (released > 0u)
+    CU_ASSERT (after.chunks == before.chunks - released)
+    CU_ASSERT (after.blocks_cached < before.blocks_cached)
+  }
+  else
+  {
+    CU_ASSERT (released == 0u)
+  }
+  CU_ASSERT (after.blocks_in_use == before.blocks_in_use)
+  vector = iot_data_alloc_vector (1000); // Check cache still usable after trimming
+  for (uint32_t i = 0; i < 1000; i++)
+  {
+    iot_data_vector_add (vector, i, iot_data_alloc_string ("A string too long to be held inline", IOT_DATA_COPY));
+  }
+  CU_ASSERT (strcmp (iot_data_string (iot_data_vector_get (vector, 999)), "A string too long to be held inline") == 0)
+  iot_data_free (vector);
+  iot_data_cache_set_limit (UINT32_MAX);
+  CU_ASSERT (iot_data_cache_trim () == 0u)
+  iot_data_cache_set_limit (0);
+}
+
 void cunit_data_test_init (void)
 {
   CU_pSuite suite = CU_add_suite ("data", suite_init, suite_clean);
@@ -2546,7 +3736,19 @@ void cunit_data_test_init (void)
   CU_add_test (suite, "data_array_iter_bool", test_data_array_iter_bool);
   CU_add_test (suite, "data_string_vector", test_data_string_vector);
   CU_add_test (suite, "data_to_json", test_data_to_json);
+  CU_add_test (suite, "data_to_json_numbers", test_data_to_json_numbers);
+  CU_add_test (suite, "data_to_json_escape", test_data_to_json_escape);
+  CU_add_test (suite, "data_to_json_sink", test_data_to_json_sink);
   CU_add_test (suite, "data_from_json", test_data_from_json);
+  CU_add_test (suite, "data_from_json_values", test_data_from_json_values);
+  CU_add_test (suite, "data_json_parser", test_data_json_parser);
+  CU_add_test (suite, "data_from_json_typecode", test_data_from_json_typecode);
+  CU_add_test (suite, "data_from_json_arrays", test_data_from_json_arrays);
+  CU_add_test (suite, "data_from_json_strings", test_data_from_json_strings);
+  CU_add_test (suite, "data_from_json_lazy", test_data_from_json_lazy);
+  CU_add_test (suite, "data_cbor", test_data_cbor);
+  CU_add_test (suite, "data_schema", test_data_schema);
+  CU_add_test (suite, "data_snapshot", test_data_snapshot);
   CU_add_test (suite, "data_address", test_data_address);
   CU_add_test (suite, "data_name_type", test_data_name_type);
   CU_add_test (suite, "data_from_string", test_data_from_string);
@@ -2558,6 +3760,9 @@ void cunit_data_test_init (void)
   CU_add_test (suite, "data_map_size", test_map_size);
   CU_add_test (suite, "data_map_iter_replace", test_data_map_iter_replace);
   CU_add_test (suite, "data_map_remove", test_data_map_remove);
+  CU_add_test (suite, "data_map_index", test_data_map_index);
+  CU_add_test (suite, "data_string_intern", test_data_string_intern);
+  CU_add_test (suite, "data_string_map_get_with_hash", test_data_string_map_get_with_hash);
   CU_add_test (suite, "data_vector_iter_replace", test_data_vector_iter_replace);
   CU_add_test (suite, "data_check_equal_int8", test_data_equal_int8);
   CU_add_test (suite, "data_check_equal_uint16", test_data_equal_uint16);
@@ -2597,6 +3802,7 @@ void cunit_data_test_init (void)
   CU_add_test (suite, "data_copy_vector_map", test_data_copy_vector_map);
   CU_add_test (suite, "data_vector_iter_next", test_data_vector_iter_next);
   CU_add_test (suite, "data_vector_resize", test_data_vector_resize);
+  CU_add_test (suite, "data_vector_grow_shrink", test_data_vector_grow_shrink);
   CU_add_test (suite, "data_vector_find", test_data_vector_find);
   CU_add_test (suite, "data_copy_map_base64_to_array", test_data_copy_map_base64_to_array);
   CU_add_test (suite, "data_check_equal_nested_vector", test_data_equal_nested_vector);
@@ -2615,12 +3821,17 @@ void cunit_data_test_init (void)
   CU_add_test (suite, "data_alloc_array_float32", test_data_alloc_array_f32);
   CU_add_test (suite, "data_alloc_array_float64", test_data_alloc_array_f64);
   CU_add_test (suite, "data_alloc_array_bool", test_data_alloc_array_bool);
+  CU_add_test (suite, "data_alloc_array_copy_sizes", test_data_alloc_array_copy_sizes);
   CU_add_test (suite, "data_alloc_zerolength_vector", test_data_zerolength_vector);
   CU_add_test (suite, "data_alloc_zerolength_vectormap", test_data_zerolength_vectormap);
   CU_add_test (suite, "data_basic_typecode", test_data_basic_typecode);
   CU_add_test (suite, "data_complex_typecode", test_data_complex_typecode);
   CU_add_test (suite, "data_equal_typecode", test_data_equal_typecode);
   CU_add_test (suite, "data_type_typecode", test_data_type_typecode);
+  CU_add_test (suite, "data_thread_cache", test_data_thread_cache);
+  CU_add_test (suite, "data_arena", test_data_arena);
+  CU_add_test (suite, "data_stats", test_data_stats);
+  CU_add_test (suite, "data_cache_trim", test_data_cache_trim);
 #ifdef IOT_HAS_XML
   CU_add_test (suite, "test_data_from_xml", test_data_from_xml);
 #endif
@@ -7,6 +7,8 @@
 
 #include "iot/typecode.h"
 #include "iot/config.h"
+#include "iot/hash.h"
+#include "iot/iot.h"
 
 #ifndef _CUTIL_UTEST_DATA_H_
 #define _CUTIL_UTEST_DATA_H_
@@ -183,6 +183,139 @@ static void cunit_json_parse_config (void)
   printf (" ");
 }
 
+static void cunit_json_parse_parents (void)
+{
+  iot_json_tok_t tokens[20];
+  iot_json_parser parser;
+  static const char * json = "{\"A\": [1, {\"B\": 2}, [3]], \"C\": 4}";
+  static const int32_t parents[] = { -1, 0, 1, 2, 2, 4, 5, 2, 7, 0, 9 };
+
+  iot_json_init (&parser);
+  int count = iot_json_parse (&parser, json, strlen (json), tokens, 20);
+  CU_ASSERT (count == 11)
+  for (int i = 0; i < count && i < 11; i++)
+  {
+    CU_ASSERT (tokens[i].parent == parents[i])
+  }
+  CU_ASSERT (tokens[0].size == 2)
+  CU_ASSERT (tokens[2].size == 3)
+  CU_ASSERT (tokens[0].end == (int32_t) strlen (json))
+
+  iot_json_init (&parser);
+  CU_ASSERT (iot_json_parse (&parser, "[1, {\"a\": 2]}", 14, tokens, 20) == IOT_JSON_ERROR_INVAL)
+  iot_json_init (&parser);
+  CU_ASSERT (iot_json_parse (&parser, "[1, 2]]", 7, tokens, 20) == IOT_JSON_ERROR_INVAL)
+  iot_json_init (&parser);
+  CU_ASSERT (iot_json_parse (&parser, "{\"a\": [1, 2]", 13, tokens, 20) == IOT_JSON_ERROR_PART)
+}
+
+/* Records JSON events as text, stopping at a given key if set */
+
+typedef struct sax_events_t
+{
+  char text [256];
+  size_t len;
+  const char * stop;
+} sax_events_t;
+
+static bool sax_record (sax_events_t * events, const char * prefix, const char * str, size_t len)
+{
+  int n = snprintf (events->text + events->len, sizeof (events->text) - events->len, "%s%.*s ", prefix, (int) len, str ? str : "");
+  if (n > 0) events->len += (size_t) n;
+  return true;
+}
+
+static bool sax_object_begin (void * arg) { return sax_record (arg, "{", NULL, 0); }
+static bool sax_object_end (void * arg) { return sax_record (arg, "}", NULL, 0); }
+static bool sax_array_begin (void * arg) { return sax_record (arg, "[", NULL, 0); }
+static bool sax_array_end (void * arg) { return sax_record (arg, "]", NULL, 0); }
+static bool sax_string (void * arg, const char * str, size_t len) { return sax_record (arg, "s:", str, len); }
+static bool sax_number (void * arg, const char * str, size_t len) { return sax_record (arg, "n:", str, len); }
+static bool sax_boolean (void * arg, bool val) { return sax_record (arg, val ? "true" : "false", NULL, 0); }
+static bool sax_null (void * arg) { return sax_record (arg, "null", NULL, 0); }
+
+static bool sax_key (void * arg, const char * str, size_t len)
+{
+  sax_events_t * events = (sax_events_t*) arg;
+  sax_record (events, "k:", str, len);
+  return ! (events->stop && strlen (events->stop) == len && strncmp (events->stop, str, len) == 0);
+}
+
+static const iot_json_handler_t sax_handler =
+{
+  sax_object_begin, sax_object_end, sax_array_begin, sax_array_end, sax_key, sax_string, sax_number, sax_boolean, sax_null
+};
+
+static void cunit_json_sax_parse (void)
+{
+  static const char * json = "{\"Key1\":\"A\\\"\\u00e9\", Key2: -1.5e3 \"Key3\": [true, false, null, {}], \"Key4\": { \"SKey1\": 12 }}";
+  static const char * expected = "{ k:Key1 s:A\"\xc3\xa9 k:Key2 n:-1.5e3 k:Key3 [ true false null { } ] k:Key4 { k:SKey1 n:12 } } ";
+  sax_events_t events = { "", 0, NULL };
+  size_t len = strlen (json);
+
+  CU_ASSERT (iot_json_sax_parse (json, len, &sax_handler, &events) == 0)
+  CU_ASSERT (strcmp (events.text, expected) == 0)
+
+  /* Same events with input split at every position */
+
+  iot_json_sax_t * sax = iot_json_sax_alloc (&sax_handler, &events);
+  for (size_t split = 0; split <= len; split++)
+  {
+    events.len = 0;
+    CU_ASSERT (iot_json_sax_push (sax, json, split) == 0)
+    CU_ASSERT (iot_json_sax_push (sax, json + split, len - split) == 0)
+    CU_ASSERT (iot_json_sax_finish (sax) == 0)
+    CU_ASSERT (strcmp (events.text, expected) == 0)
+  }
+
+  /* Top level values, trailing number completed on finish */
+
+  events.len = 0;
+  CU_ASSERT (iot_json_sax_push (sax, "\"a\" [1] 2", 9) == 0)
+  CU_ASSERT (strcmp (events.text, "s:a [ n:1 ] ") == 0)
+  CU_ASSERT (iot_json_sax_finish (sax) == 0)
+  CU_ASSERT (strcmp (events.text, "s:a [ n:1 ] n:2 ") == 0)
+
+  /* Errors and incomplete input */
+
+  CU_ASSERT (iot_json_sax_push (sax, "{\"a\" 1}", 8) == IOT_JSON_ERROR_INVAL)
+  CU_ASSERT (iot_json_sax_finish (sax) == IOT_JSON_ERROR_INVAL)
+  CU_ASSERT (iot_json_sax_parse ("[1, {\"a\": 2]}", 14, &sax_handler, &events) == IOT_JSON_ERROR_INVAL)
+  CU_ASSERT (iot_json_sax_parse ("{\"a\":1,}", 8, &sax_handler, &events) == 0)
+  CU_ASSERT (iot_json_sax_parse ("{\"a\":,1}", 8, &sax_handler, &events) == IOT_JSON_ERROR_INVAL)
+  CU_ASSERT (iot_json_sax_parse ("\"\\u12g4\"", 8, &sax_handler, &events) == IOT_JSON_ERROR_INVAL)
+  CU_ASSERT (iot_json_sax_parse ("{\"a\": [1, 2]", 12, &sax_handler, &events) == IOT_JSON_ERROR_PART)
+  CU_ASSERT (iot_json_sax_parse ("\"abc", 4, &sax_handler, &events) == IOT_JSON_ERROR_PART)
+
+  /* Unquoted values must be literals or numbers */
+
+  static const char * values [] = { "0", "-0", "12", "-1.5", "2e10", "1.5E-3", "0x1F", "-0x10", "true", "false", "null" };
+  static const char * invalid [] = { "tru", "fx", "nonsense", "nul", "truex", "abc", "01", "1.", ".5", "1e", "+1", "-", "0x", "1x" };
+  for (uint32_t i = 0; i < sizeof (values) / sizeof (values[0]); i++)
+  {
+    events.len = 0;
+    CU_ASSERT (iot_json_sax_parse (values[i], strlen (values[i]), &sax_handler, &events) == 0)
+    CU_ASSERT (events.len > 0)
+  }
+  for (uint32_t i = 0; i < sizeof (invalid) / sizeof (invalid[0]); i++)
+  {
+    events.len = 0;
+    CU_ASSERT (iot_json_sax_parse (invalid[i], strlen (invalid[i]), &sax_handler, &events) == IOT_JSON_ERROR_INVAL)
+    CU_ASSERT (events.len == 0)
+  }
+  CU_ASSERT (iot_json_sax_parse ("[1, tru]", 8, &sax_handler, &events) == IOT_JSON_ERROR_INVAL)
+  CU_ASSERT (iot_json_sax_parse ("{\"a\": abc}", 10, &sax_handler, &events) == IOT_JSON_ERROR_INVAL)
+
+  /* Handler stops parsing */
+
+  events.len = 0;
+  events.stop = "Key2";
+  CU_ASSERT (iot_json_sax_push (sax, json, len) == IOT_JSON_ERROR_STOP)
+  CU_ASSERT (iot_json_sax_finish (sax) == IOT_JSON_ERROR_STOP)
+  CU_ASSERT (strcmp (events.text, "{ k:Key1 s:A\"\xc3\xa9 k:Key2 ") == 0)
+  iot_json_sax_free (sax);
+}
+
 void cunit_json_test_init (void)
 {
   CU_pSuite suite = CU_add_suite ("json", suite_init, suite_clean);
@@ -192,4 +325,6 @@ void cunit_json_test_init (void)
   CU_add_test (suite, "json_parse_array", cunit_json_parse_array);
   CU_add_test (suite, "json_parse_nested", cunit_json_parse_nested);
   CU_add_test (suite, "json_parse_config", cunit_json_parse_config);
+  CU_add_test (suite, "json_parse_parents", cunit_json_parse_parents);
+  CU_add_test (suite, "json_sax_parse", cunit_json_sax_parse);
 }